@@ -0,0 +1,142 @@
+#pragma once
+#ifndef _JKSN_BENCH_HPP_INCLUDED
+#define _JKSN_BENCH_HPP_INCLUDED
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "jksn.hpp"
+
+namespace bench {
+
+/* Runs func repeatedly for at least min_seconds and returns seconds per run */
+template<typename Func>
+double measure(Func func, double min_seconds = 0.5) {
+    typedef std::chrono::steady_clock clock;
+    func();
+    size_t runs = 0;
+    clock::time_point start = clock::now();
+    double elapsed;
+    do {
+        func();
+        ++runs;
+        elapsed = std::chrono::duration<double>(clock::now() - start).count();
+    } while(elapsed < min_seconds);
+    return elapsed / double(runs);
+}
+
+inline void report(const char *name, double seconds, size_t bytes) {
+    std::printf("%-32s %10.3f ms %10.1f MB/s\n", name, seconds*1e3, double(bytes)/seconds/1048576.0);
+}
+
+/* Reports millions of values, as counted by countValues, per second */
+inline void reportValues(const char *name, double seconds, size_t values) {
+    std::printf("%-32s %10.3f ms %10.2f M values/s\n", name, seconds*1e3, double(values)/seconds/1e6);
+}
+
+/* Counts every value including containers, as each takes one control byte */
+inline size_t countValues(const JKSN::JKSNValue &value) {
+    size_t result = 1;
+    if(value.isArray())
+        for(const JKSN::JKSNValue &item : value.toVector())
+            result += countValues(item);
+    else if(value.isObject())
+        for(const JKSN::JKSNObject::value_type &item : value.toMap())
+            result += countValues(item.first) + countValues(item.second);
+    return result;
+}
+
+/* A table of records that mixes every common value type */
+inline JKSN::JKSNValue mixedCorpus(size_t rows) {
+    std::vector<JKSN::JKSNValue> result;
+    result.reserve(rows);
+    for(size_t i = 0; i < rows; ++i)
+        result.push_back(JKSN::JKSNValue::fromMap({
+            {"id", JKSN::JKSNValue(i)},
+            {"name", "user" + std::to_string(i % 1000)},
+            {"email", "user" + std::to_string(i) + "@example.com"},
+            {"score", double(i) * 0.25},
+            {"active", i % 3 == 0},
+            {"tags", JKSN::JKSNValue({"alpha", "beta", int(i % 7)})}
+        }));
+    return JKSN::JKSNValue(std::move(result));
+}
+
+/* A table whose column names are too long to be kept inline, as in exported database rows */
+inline JKSN::JKSNValue wideCorpus(size_t rows) {
+    std::vector<JKSN::JKSNValue> result;
+    result.reserve(rows);
+    for(size_t i = 0; i < rows; ++i)
+        result.push_back(JKSN::JKSNValue::fromMap({
+            {"customer_identifier", JKSN::JKSNValue(i)},
+            {"registration_timestamp", JKSN::JKSNValue(1500000000 + i)},
+            {"preferred_language_code", i % 2 == 0 ? "en" : "zh"},
+            {"lifetime_order_total", double(i) * 1.5},
+            {"marketing_emails_allowed", i % 3 == 0}
+        }));
+    return JKSN::JKSNValue(std::move(result));
+}
+
+/* Time series of timestamps and readings, as a metrics exporter dumps them */
+inline JKSN::JKSNValue metricsCorpus(size_t series, size_t points) {
+    std::vector<JKSN::JKSNValue> result;
+    result.reserve(series);
+    for(size_t i = 0; i < series; ++i) {
+        std::vector<JKSN::JKSNValue> timestamps, readings;
+        timestamps.reserve(points);
+        readings.reserve(points);
+        for(size_t j = 0; j < points; ++j) {
+            timestamps.push_back(JKSN::JKSNValue(intmax_t(1500000000 + j*15 + (i*j) % 3)));
+            readings.push_back(JKSN::JKSNValue(double((i*7919 + j*104729) % 10007) / 100.0));
+        }
+        result.push_back(JKSN::JKSNValue::fromMap({
+            {"metric", "host" + std::to_string(i) + ".cpu.load"},
+            {"timestamps", JKSN::JKSNValue(std::move(timestamps))},
+            {"readings", JKSN::JKSNValue(std::move(readings))}
+        }));
+    }
+    return JKSN::JKSNValue(std::move(result));
+}
+
+/* Distinct medium-sized strings and blobs, dominated by payload copies */
+inline JKSN::JKSNValue stringCorpus(size_t count, size_t length = 256) {
+    std::vector<JKSN::JKSNValue> result;
+    result.reserve(count);
+    for(size_t i = 0; i < count; ++i) {
+        std::string item = std::to_string(i);
+        item.resize(length, char('a' + i % 26));
+        result.push_back(JKSN::JKSNValue(std::move(item), i % 2 != 0));
+    }
+    return JKSN::JKSNValue(std::move(result));
+}
+
+/* A slowly varying integer series, encoded mostly as deltas */
+inline JKSN::JKSNValue intCorpus(size_t count) {
+    std::vector<JKSN::JKSNValue> result;
+    result.reserve(count);
+    intmax_t value = 1000000;
+    for(size_t i = 0; i < count; ++i) {
+        value += intmax_t(i * 7919 % 11) - 5;
+        result.push_back(JKSN::JKSNValue(i % 64 == 0 ? value * 1000 : value));
+    }
+    return JKSN::JKSNValue(std::move(result));
+}
+
+/* Unrelated 48-bit identifiers, which are all encoded as varints */
+inline JKSN::JKSNValue varintCorpus(size_t count) {
+    std::vector<JKSN::JKSNValue> result;
+    result.reserve(count);
+    uint64_t value = 0x123456789abULL;
+    for(size_t i = 0; i < count; ++i) {
+        value = (value * 6364136223846793005ULL + 1442695040888963407ULL) & 0xffffffffffffULL;
+        result.push_back(JKSN::JKSNValue(intmax_t(value | 0x800000000000ULL)));
+    }
+    return JKSN::JKSNValue(std::move(result));
+}
+
+}
+
+#endif
@@ -0,0 +1,61 @@
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <string>
+#include "bench.hpp"
+
+/* Every allocation made by this program goes through here to be counted */
+static size_t allocations = 0;
+static size_t allocated = 0;
+
+void *operator new(size_t size) {
+    ++allocations;
+    allocated += size;
+    if(void *result = std::malloc(size ? size : 1))
+        return result;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+template<typename Func>
+static void reportAllocations(const char *name, Func func, size_t values) {
+    size_t before = allocations;
+    size_t bytes_before = allocated;
+    func();
+    size_t count = allocations - before;
+    size_t bytes = allocated - bytes_before;
+    std::printf("%-32s %10zu allocations %8.2f per value %10.1f MB\n", name, count, double(count)/double(values), double(bytes)/1048576.0);
+}
+
+static void benchCorpus(const char *name, const JKSN::JKSNValue &corpus) {
+    const std::string encoded = JKSN::dump(corpus);
+    const size_t values = bench::countValues(corpus);
+    std::printf("%s (%zu bytes, %zu values)\n", name, encoded.size(), values);
+    reportAllocations("  parse(const char *, size_t)", [&]() {
+        size_t consumed;
+        JKSN::parse(encoded.data(), encoded.size(), &consumed);
+    }, values);
+    reportAllocations("  parse(std::istream &)", [&]() {
+        std::istringstream stream(encoded);
+        JKSN::parse(stream);
+    }, values);
+    reportAllocations("  copy", [&]() {
+        JKSN::JKSNValue copy = corpus;
+    }, values);
+}
+
+int main() {
+    benchCorpus("records", bench::mixedCorpus(20000));
+    benchCorpus("wide records", bench::wideCorpus(20000));
+    benchCorpus("strings", bench::stringCorpus(20000));
+    benchCorpus("integers", bench::intCorpus(1000000));
+    benchCorpus("metrics", bench::metricsCorpus(200, 1000));
+    return 0;
+}
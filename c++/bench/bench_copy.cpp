@@ -0,0 +1,40 @@
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "bench.hpp"
+
+/* Hands a copy of the corpus to each of a few threads, which read every row */
+static size_t fanOut(const JKSN::JKSNValue &corpus, unsigned threads) {
+    std::vector<size_t> sums(threads);
+    std::vector<std::thread> workers;
+    for(unsigned t = 0; t < threads; ++t)
+        workers.push_back(std::thread([&sums, t](JKSN::JKSNValue local) {
+            for(const JKSN::JKSNValue &row : static_cast<const JKSN::JKSNValue &>(local).toVector())
+                sums[t] += size_t(row.isObject() ? row.toMap().at("id").toInt() : row.toInt());
+        }, corpus));
+    for(std::thread &worker : workers)
+        worker.join();
+    return sums[0];
+}
+
+static void benchCopy(const char *name, const JKSN::JKSNValue &corpus) {
+    const size_t values = bench::countValues(corpus);
+    std::printf("%s (%zu values)\n", name, values);
+    bench::reportValues("  copy, 100 times", bench::measure([&]() {
+        for(int i = 0; i < 100; ++i)
+            JKSN::JKSNValue copy = corpus;
+    }), values*100);
+    bench::reportValues("  copy, then change one row", bench::measure([&]() {
+        JKSN::JKSNValue copy = corpus;
+        copy.toVector()[0] = -1;
+    }), values);
+    bench::reportValues("  copy to 8 threads and read", bench::measure([&]() {
+        fanOut(corpus, 8);
+    }), values*8);
+}
+
+int main() {
+    benchCopy("records", bench::mixedCorpus(20000));
+    benchCopy("integers", bench::intCorpus(1000000));
+    return 0;
+}
@@ -0,0 +1,44 @@
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+#include "bench.hpp"
+
+/* Arrays and objects nested alternately around a single integer. Each array
+   also holds its level, as arrays of objects alone are tried swapped, too. */
+static JKSN::JKSNValue nested(size_t depth) {
+    JKSN::JKSNValue result(42);
+    for(size_t i = 0; i < depth; ++i)
+        if(i % 2 == 0) {
+            std::vector<JKSN::JKSNValue> items;
+            items.push_back(JKSN::JKSNValue(i));
+            items.push_back(std::move(result));
+            result = JKSN::JKSNValue(std::move(items));
+        } else {
+            JKSN::JKSNObject members;
+            members.emplace("next", std::move(result));
+            result = JKSN::JKSNValue(std::move(members));
+        }
+    return result;
+}
+
+static void benchDepth(size_t depth) {
+    const JKSN::JKSNValue corpus = nested(depth);
+    const std::string encoded = JKSN::dump(corpus);
+    std::printf("depth %zu (%zu bytes)\n", depth, encoded.size());
+    bench::report("  dump", bench::measure([&]() {
+        JKSN::dump(corpus);
+    }, 0.2), encoded.size());
+    bench::report("  parse", bench::measure([&]() {
+        JKSN::parse(encoded);
+    }, 0.2), encoded.size());
+    bench::report("  copy and free", bench::measure([&]() {
+        JKSN::JKSNValue copy = corpus;
+    }, 0.2), encoded.size());
+}
+
+int main() {
+    for(size_t depth : {10, 100, 1000, 10000, 100000})
+        benchDepth(depth);
+    return 0;
+}
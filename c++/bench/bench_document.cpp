@@ -0,0 +1,75 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unistd.h>
+#include "bench.hpp"
+
+/* Returns the peak resident size of this process, in kB */
+static long peakResident() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while(std::getline(status, line))
+        if(line.compare(0, 6, "VmHWM:") == 0)
+            return std::atol(line.c_str() + 6);
+    return 0;
+}
+
+/* Reads the file, parses it the given way, and prints the peak resident size.
+   Run in a fresh process so that pages the heap already holds are not counted as free. */
+static int parseOnce(const char *how, const char *path) {
+    std::ifstream file(path, std::ios::binary);
+    std::string buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if(std::strcmp(how, "parse") == 0)
+        JKSN::parse(buffer);
+    else if(std::strcmp(how, "parseDocument") == 0)
+        JKSN::parseDocument(std::move(buffer));
+    std::printf("%ld\n", peakResident());
+    return 0;
+}
+
+/* Runs parseOnce in a fresh process and returns what it printed, in MB */
+static double peakResident(const char *self, const char *how, const char *path) {
+    std::string command = std::string(self) + " " + how + " " + path;
+    FILE *child = popen(command.c_str(), "r");
+    if(!child)
+        return 0.0;
+    long result = 0;
+    if(std::fscanf(child, "%ld", &result) != 1)
+        result = 0;
+    pclose(child);
+    return double(result) / 1024.0;
+}
+
+static void benchDocument(const char *self, const char *name, const JKSN::JKSNValue &corpus) {
+    const std::string encoded = JKSN::dump(corpus);
+    std::printf("%s (%zu bytes)\n", name, encoded.size());
+    bench::report("  parse, then free", bench::measure([&]() {
+        JKSN::parse(encoded);
+    }), encoded.size());
+    bench::report("  parseDocument, then free", bench::measure([&]() {
+        JKSN::parseDocument(std::string(encoded));
+    }), encoded.size());
+    char path[] = "/tmp/bench_document.XXXXXX";
+    int fd = mkstemp(path);
+    if(fd < 0)
+        return;
+    close(fd);
+    std::ofstream(path, std::ios::binary).write(encoded.data(), std::streamsize(encoded.size()));
+    double baseline = peakResident(self, "read", path);
+    double heap = peakResident(self, "parse", path);
+    double document = peakResident(self, "parseDocument", path);
+    unlink(path);
+    std::printf("  peak resident above the buffer    parse %.1f MB, parseDocument %.1f MB\n", heap - baseline, document - baseline);
+}
+
+int main(int argc, char *argv[]) {
+    if(argc == 3)
+        return parseOnce(argv[1], argv[2]);
+    benchDocument(argv[0], "records", bench::mixedCorpus(200000));
+    benchDocument(argv[0], "integers", bench::intCorpus(4000000));
+    benchDocument(argv[0], "metrics", bench::metricsCorpus(1000, 2000));
+    return 0;
+}
@@ -0,0 +1,20 @@
+#include <string>
+#include "bench.hpp"
+
+static void benchDump(const char *name, const JKSN::JKSNValue &corpus) {
+    const std::string encoded = JKSN::dump(corpus);
+    const size_t values = bench::countValues(corpus);
+    std::printf("%s (%zu bytes, %zu values)\n", name, encoded.size(), values);
+    bench::reportValues("  dump(...)", bench::measure([&]() {
+        JKSN::dump(corpus);
+    }), values);
+}
+
+int main() {
+    benchDump("records", bench::mixedCorpus(20000));
+    benchDump("integers", bench::intCorpus(200000));
+    /* As built, and as decoded, when arrays of numbers of one type are packed */
+    benchDump("metrics", bench::metricsCorpus(200, 1000));
+    benchDump("metrics, decoded", JKSN::parse(JKSN::dump(bench::metricsCorpus(200, 1000))));
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "bench.hpp"
+
+typedef std::map<JKSN::JKSNValue, JKSN::JKSNValue> Map;
+
+/* Members with string keys, as objects are usually written */
+static std::vector<JKSN::JKSNObject::value_type> members(size_t count) {
+    std::vector<JKSN::JKSNObject::value_type> result;
+    result.reserve(count);
+    for(size_t i = 0; i < count; ++i)
+        result.emplace_back(JKSN::JKSNValue("member" + std::to_string(i)), JKSN::JKSNValue(i));
+    return result;
+}
+
+template<typename Object>
+static size_t lookup(const Object &object, const std::vector<JKSN::JKSNValue> &keys) {
+    size_t result = 0;
+    for(const JKSN::JKSNValue &key : keys)
+        result += object.count(key);
+    return result;
+}
+
+template<typename Object>
+static size_t iterate(const Object &object) {
+    size_t result = 0;
+    for(const auto &item : object)
+        result += size_t(item.second.toInt());
+    return result;
+}
+
+static void benchObject(const char *name, size_t count) {
+    const std::vector<JKSN::JKSNObject::value_type> source = members(count);
+    std::vector<JKSN::JKSNValue> keys;
+    for(size_t i = 0; i < count*2; ++i)
+        keys.push_back(JKSN::JKSNValue("member" + std::to_string(i)));
+    const Map map(source.begin(), source.end());
+    const JKSN::JKSNObject object(source.begin(), source.end());
+    /* Built as many times as it takes to run for about a millisecond */
+    size_t repeat = 100000 / count + 1;
+    std::printf("%s (%zu members, %zu rounds)\n", name, count, repeat);
+    bench::reportValues("  build std::map", bench::measure([&]() {
+        for(size_t i = 0; i < repeat; ++i) {
+            Map result;
+            for(const JKSN::JKSNObject::value_type &item : source)
+                result[item.first] = item.second;
+        }
+    }), count*repeat);
+    bench::reportValues("  build JKSNObject", bench::measure([&]() {
+        for(size_t i = 0; i < repeat; ++i) {
+            JKSN::JKSNObject::container_type copy(source.begin(), source.end());
+            JKSN::JKSNObject result(std::move(copy));
+        }
+    }), count*repeat);
+    size_t found = 0;
+    bench::reportValues("  lookup std::map", bench::measure([&]() {
+        for(size_t i = 0; i < repeat; ++i)
+            found += lookup(map, keys);
+    }), keys.size()*repeat);
+    bench::reportValues("  lookup JKSNObject", bench::measure([&]() {
+        for(size_t i = 0; i < repeat; ++i)
+            found += lookup(object, keys);
+    }), keys.size()*repeat);
+    bench::reportValues("  iterate std::map", bench::measure([&]() {
+        for(size_t i = 0; i < repeat; ++i)
+            found += iterate(map);
+    }), count*repeat);
+    bench::reportValues("  iterate JKSNObject", bench::measure([&]() {
+        for(size_t i = 0; i < repeat; ++i)
+            found += iterate(object);
+    }), count*repeat);
+    if(found == 0)
+        std::printf("  nothing found\n");
+}
+
+/* Fields read from every row of a decoded table, whose rows share their keys */
+static void benchRows(const char *name, const JKSN::JKSNValue &corpus) {
+    const JKSN::JKSNValue table = JKSN::parse(JKSN::dump(corpus));
+    const JKSN::JKSNArray &rows = table.toVector();
+    std::vector<JKSN::JKSNValue> keys;
+    for(const JKSN::JKSNObject::value_type &item : rows[0].toMap())
+        keys.push_back(item.first);
+    std::printf("%s (%zu rows)\n", name, rows.size());
+    size_t found = 0;
+    bench::reportValues("  lookup every field", bench::measure([&]() {
+        for(const JKSN::JKSNValue &row : rows)
+            found += lookup(row.toMap(), keys);
+    }), keys.size()*rows.size());
+    bench::reportValues("  iterate every row", bench::measure([&]() {
+        for(const JKSN::JKSNValue &row : rows)
+            for(const auto &item : row.toMap())
+                found += item.second.isNull() ? 0 : 1;
+    }), keys.size()*rows.size());
+    if(found == 0)
+        std::printf("  nothing found\n");
+}
+
+int main() {
+    benchObject("small object", 6);
+    benchObject("large object", 1000);
+    benchRows("decoded records", bench::mixedCorpus(20000));
+    benchRows("decoded wide records", bench::wideCorpus(20000));
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include "bench.hpp"
+
+static void benchCorpus(const char *name, const JKSN::JKSNValue &corpus) {
+    const std::string encoded = JKSN::dump(corpus);
+    std::printf("%s (%zu bytes)\n", name, encoded.size());
+    bench::report("  parse(std::istream &)", bench::measure([&]() {
+        std::istringstream stream(encoded);
+        JKSN::parse(stream);
+    }), encoded.size());
+    bench::report("  parse(const char *, size_t)", bench::measure([&]() {
+        size_t consumed;
+        JKSN::parse(encoded.data(), encoded.size(), &consumed);
+    }), encoded.size());
+    bench::report("  parseParallel(...)", bench::measure([&]() {
+        size_t consumed;
+        JKSN::parseParallel(encoded.data(), encoded.size(), &consumed);
+    }), encoded.size());
+    bench::report("  JKSNPushDecoder, 1 KiB pieces", bench::measure([&]() {
+        JKSN::JKSNPushDecoder decoder;
+        for(size_t i = 0; i < encoded.size(); i += 1024)
+            decoder.feed(encoded.data()+i, std::min(encoded.size()-i, size_t(1024)));
+        decoder.pop();
+    }), encoded.size());
+    /* Includes copying the buffer into the document */
+    bench::report("  parseDocument(std::string &&)", bench::measure([&]() {
+        JKSN::parseDocument(std::string(encoded));
+    }), encoded.size());
+}
+
+/* Dominated by dispatching on the control byte of small values */
+static void benchValues(const char *name, const JKSN::JKSNValue &corpus) {
+    const std::string encoded = JKSN::dump(corpus);
+    const size_t values = bench::countValues(corpus);
+    std::printf("%s (%zu bytes, %zu values)\n", name, encoded.size(), values);
+    bench::reportValues("  parse(const char *, size_t)", bench::measure([&]() {
+        size_t consumed;
+        JKSN::parse(encoded.data(), encoded.size(), &consumed);
+    }), values);
+    bench::reportValues("  parse(std::istream &)", bench::measure([&]() {
+        std::istringstream stream(encoded);
+        JKSN::parse(stream);
+    }), values);
+}
+
+static void benchProjection(const char *name, const JKSN::JKSNValue &corpus, const JKSN::JKSNProjection &projection) {
+    const std::string encoded = JKSN::dump(corpus);
+    std::printf("%s (%zu bytes)\n", name, encoded.size());
+    bench::report("  parse(const char *, size_t)", bench::measure([&]() {
+        size_t consumed;
+        JKSN::parse(encoded.data(), encoded.size(), &consumed);
+    }), encoded.size());
+    bench::report("  parse(..., projection)", bench::measure([&]() {
+        size_t consumed;
+        JKSN::parse(encoded.data(), encoded.size(), &consumed, projection);
+    }), encoded.size());
+}
+
+int main() {
+    benchCorpus("records", bench::mixedCorpus(20000));
+    benchProjection("records, projected to /*/id", bench::mixedCorpus(20000), JKSN::JKSNProjection({"/*/id"}));
+    benchCorpus("wide records", bench::wideCorpus(20000));
+    benchCorpus("strings", bench::stringCorpus(20000));
+    benchCorpus("integers", bench::intCorpus(200000));
+    benchCorpus("varints", bench::varintCorpus(200000));
+    benchCorpus("metrics", bench::metricsCorpus(200, 1000));
+    benchValues("records, decoded values", bench::mixedCorpus(20000));
+    return 0;
+}
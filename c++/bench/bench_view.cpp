@@ -0,0 +1,46 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "bench.hpp"
+
+/* Looks up a spread of records by position and one member of each by key */
+template<typename Document>
+static size_t query(const Document &document, size_t rows) {
+    size_t result = 0;
+    for(size_t i = 0; i < rows; i += 97)
+        result += document.at(i).at("email").toString().size();
+    return result;
+}
+
+static void benchQueries(const char *name, const JKSN::JKSNValue &corpus, size_t rows) {
+    const std::string encoded = JKSN::dump(corpus);
+    std::printf("%s (%zu bytes)\n", name, encoded.size());
+    bench::report("  parse, then query", bench::measure([&]() {
+        query(JKSN::parse(encoded), rows);
+    }), encoded.size());
+    bench::report("  lazy view, then query", bench::measure([&]() {
+        query(JKSN::JKSNView(encoded.data(), encoded.size()), rows);
+    }), encoded.size());
+    JKSN::JKSNView view(encoded.data(), encoded.size());
+    bench::report("  buildTape", bench::measure([&]() {
+        JKSN::JKSNView(encoded.data(), encoded.size()).buildTape();
+    }), encoded.size());
+    view.saveTape("bench_view.tape");
+    std::ifstream file("bench_view.tape", std::ios::binary);
+    std::string saved((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::remove("bench_view.tape");
+    std::vector<uint64_t> tape((saved.size()+7)/8);
+    std::memcpy(tape.data(), saved.data(), saved.size());
+    bench::report("  saved tape, then query", bench::measure([&]() {
+        query(JKSN::JKSNView(encoded.data(), encoded.size(), reinterpret_cast<const char *>(tape.data()), saved.size()), rows);
+    }), encoded.size());
+}
+
+int main() {
+    benchQueries("records", bench::mixedCorpus(20000), 20000);
+    return 0;
+}
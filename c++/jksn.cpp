@@ -18,21 +18,54 @@
 */
 
 #include "jksn.hpp"
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <cerrno>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <deque>
+#include <fstream>
 #include <list>
 #include <map>
 #include <memory>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#define JKSN_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__) || defined(__FreeBSD__)
+/* Space for a file written through a mapping is allocated before it is mapped */
+#define JKSN_HAVE_FALLOCATE 1
+#endif
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+/* Varints of up to eight bytes are decoded from one 64-bit load */
+#define JKSN_HAVE_FAST_VARINT 1
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+#endif
+#if defined(__SSE2__)
+/* Runs of one-byte integers are found sixteen control bytes at a time */
+#define JKSN_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+#ifndef JKSN_PARALLEL_GRAIN
+/* Subtrees of fewer nodes are never split between threads */
+#define JKSN_PARALLEL_GRAIN 4096
+#endif
 
 namespace JKSN {
 
@@ -68,38 +101,80 @@ public:
         data(std::move(data)),
         buf(buf) {
     }
+    JKSNProxy(JKSNProxy &&that) = default;
+    JKSNProxy &operator=(JKSNProxy &&that) noexcept {
+        if(this != &that) {
+            this->releaseChildren();
+            this->origin = that.origin;
+            this->control = that.control;
+            this->data = std::move(that.data);
+            this->buf = std::move(that.buf);
+            this->children = std::move(that.children);
+            this->hash = that.hash;
+            this->number = that.number;
+            this->numbers = std::move(that.numbers);
+        }
+        return *this;
+    }
+    ~JKSNProxy() {
+        this->releaseChildren();
+    }
+    /* Visits this proxy and its descendants in stream order, down to depth levels
+       unless it is 0, until visit returns false */
+    template<typename Visit> bool walk(Visit visit, size_t depth = 0) const {
+        if(!visit(*this))
+            return false;
+        if(depth == 1)
+            return true;
+        std::vector<std::pair<std::list<JKSNProxy>::const_iterator, std::list<JKSNProxy>::const_iterator> > stack;
+        stack.emplace_back(this->children.cbegin(), this->children.cend());
+        while(!stack.empty()) {
+            if(stack.back().first == stack.back().second) {
+                stack.pop_back();
+                continue;
+            }
+            const JKSNProxy &item = *stack.back().first++;
+            if(!visit(item))
+                return false;
+            if(!item.children.empty() && (depth == 0 || stack.size()+1 < depth))
+                stack.emplace_back(item.children.cbegin(), item.children.cend());
+        }
+        return true;
+    }
     std::ostream &output(std::ostream &stream, bool recursive = true) const {
-        if(!stream.put(char(this->control)))
-            return stream;
-        if(!(stream << this->data))
-            return stream;
-        if(!(stream << this->buf))
-            return stream;
-        if(recursive)
-            for(const JKSNProxy &i : this->children)
-                if(!i.output(stream))
-                    return stream;
+        this->walk([&stream](const JKSNProxy &item) {
+            return stream.put(char(item.control)) && stream << item.data && stream << item.buf;
+        }, recursive ? 0 : 1);
         return stream;
     }
+    char *output(char *buf, bool recursive = true) const {
+        this->walk([&buf](const JKSNProxy &item) {
+            *buf++ = char(item.control);
+            std::memcpy(buf, item.data.data(), item.data.size());
+            buf += item.data.size();
+            std::memcpy(buf, item.buf.data(), item.buf.size());
+            buf += item.buf.size();
+            return true;
+        }, recursive ? 0 : 1);
+        return buf;
+    }
     std::string toString(bool recursive = true) const {
         std::string result;
-        result.reserve(1 + this->data.size() + this->buf.size());
-        result += char(this->control);
-        result += this->data;
-        result += this->buf;
-        if(recursive)
-            for(const JKSNProxy &i : this->children)
-                result += i.toString();
+        result.reserve(this->size(recursive ? 0 : 1));
+        this->walk([&result](const JKSNProxy &item) {
+            result += char(item.control);
+            result += item.data;
+            result += item.buf;
+            return true;
+        }, recursive ? 0 : 1);
         return result;
     }
     size_t size(size_t depth = 0) const {
-        size_t result = 1 + this->data.size() + this->buf.size();
-        if(depth == 0)
-            for(const JKSNProxy &i : this->children)
-                result += i.size();
-        else if(depth != 1)
-            for(const JKSNProxy &i : this->children)
-                result += i.size(depth-1);
+        size_t result = 0;
+        this->walk([&result](const JKSNProxy &item) {
+            result += 1 + item.data.size() + item.buf.size();
+            return true;
+        }, depth);
         return result;
     }
     const JKSNValue *origin = nullptr; /* weak reference */
@@ -108,14 +183,168 @@ public:
     std::string buf;
     std::list<JKSNProxy> children;
     uint8_t hash = 0;
+    /* The value of an integer, which optimize may write again as a delta */
+    intmax_t number = 0;
+    /* The integers of an array whose elements are written into buf at once,
+       kept until optimize writes them again with deltas */
+    JKSNValue numbers;
+private:
+    void releaseChildren() {
+        /* Grandchildren are spliced out before each child is freed, so that
+           freeing a deeply nested tree does not recurse */
+        std::list<JKSNProxy> pending;
+        pending.splice(pending.end(), this->children);
+        while(!pending.empty()) {
+            pending.splice(pending.end(), pending.front().children);
+            pending.pop_front();
+        }
+    }
+};
+
+class JKSNCacheEntry {
+    /* Note: A slot either keeps its own copy, whose capacity is reused by later
+       strings, or refers into a buffer kept alive by owner */
+public:
+    explicit operator bool() const {
+        return this->present;
+    }
+    const char *data() const {
+        return this->owner ? this->ref : this->owned.data();
+    }
+    size_t size() const {
+        return this->owner ? this->refsize : this->owned.size();
+    }
+    bool isBorrowedFrom(const std::shared_ptr<const void> &owner) const {
+        return owner && this->owner == owner;
+    }
+    bool equals(const std::string &str) const {
+        return this->present && this->size() == str.size() && !std::memcmp(this->data(), str.data(), str.size());
+    }
+    std::string toString() const {
+        return std::string(this->data(), this->size());
+    }
+    void assign(const char *str, size_t size) {
+        this->owned.assign(str, size);
+        this->owner = nullptr;
+        this->present = true;
+    }
+    void assign(std::string &&str) {
+        this->owned.swap(str);
+        this->owner = nullptr;
+        this->present = true;
+    }
+    void borrow(const std::shared_ptr<const void> &owner, const char *str, size_t size) {
+        this->owner = owner;
+        this->ref = str;
+        this->refsize = size;
+        this->present = true;
+    }
+    void clear() {
+        this->owner = nullptr;
+        this->present = false;
+    }
+private:
+    std::string owned;
+    std::shared_ptr<const void> owner;
+    const char *ref = nullptr;
+    size_t refsize = 0;
+    bool present = false;
 };
 
 class JKSNCache {
 public:
     bool haslastint = false;
     intmax_t lastint;
-    std::array<std::shared_ptr<std::string>, 256> texthash {{nullptr}};
-    std::array<std::shared_ptr<std::string>, 256> blobhash {{nullptr}};
+    std::array<JKSNCacheEntry, 256> texthash;
+    std::array<JKSNCacheEntry, 256> blobhash;
+    void clearStrings() {
+        for(JKSNCacheEntry &entry : this->texthash)
+            entry.clear();
+        for(JKSNCacheEntry &entry : this->blobhash)
+            entry.clear();
+    }
+};
+
+class JKSNKeyTable {
+    /* Note: Object keys too long to be kept inline are interned here, so that the
+       same key in every row of a table shares one buffer. The table holds a
+       reference to each key, and starts over when it fills up, so that a stream
+       of distinct keys does not pile up in it. */
+public:
+    /* Replaces a key on the heap with its interned copy */
+    void intern(JKSNValue &key);
+    void clear() {
+        this->slots.clear();
+        this->count = 0;
+    }
+private:
+    static const size_t max_keys = 4096;
+    static const size_t max_key_size = 256;
+    /* Open addressing table of interned keys, at most half full */
+    std::vector<JKSNValue> slots;
+    size_t count = 0;
+    void grow();
+};
+
+class JKSNShapeTable {
+    /* Note: The shapes of the objects a decoder has built, so that objects with the
+       same keys in the same order share one. It holds a reference to each shape on
+       the heap, and starts over when it fills up. Shapes in the arena of a document
+       are only kept while it is decoded. A copy of the table starts out empty. */
+public:
+    JKSNShapeTable() = default;
+    JKSNShapeTable(const JKSNShapeTable &) {
+    }
+    JKSNShapeTable &operator=(const JKSNShapeTable &) {
+        this->clear();
+        return *this;
+    }
+    ~JKSNShapeTable() {
+        this->clear();
+    }
+    /* Returns the shape with these keys, with a reference for the caller, or
+       nullptr if a key repeats */
+    JKSNObject::SharedShape *share(const JKSNArray &keys, const JKSNAllocator<JKSNValue> &allocator);
+    void clear();
+private:
+    static const size_t max_shapes = 1024;
+    static const size_t max_shape_size = 256;
+    struct Slot {
+        size_t hash;
+        JKSNObject::SharedShape *shape;
+    };
+    /* Open addressing table of shapes, at most half full */
+    std::vector<Slot> slots;
+    size_t count = 0;
+    /* Where the shapes in the table are */
+    JKSNArena *arena = nullptr;
+    void grow();
+};
+
+class JKSNMappedFile {
+    /* Note: Maps a whole file into memory, or reads it in where mmap is unavailable */
+public:
+    JKSNMappedFile(const std::string &path);
+    JKSNMappedFile(const std::string &path, size_t size);
+    JKSNMappedFile(const JKSNMappedFile &that) = delete;
+    JKSNMappedFile &operator=(const JKSNMappedFile &that) = delete;
+    ~JKSNMappedFile();
+    char *data() const {
+        return this->buf;
+    }
+    size_t size() const {
+        return this->buf_size;
+    }
+private:
+    char *buf = nullptr;
+    size_t buf_size = 0;
+#ifdef JKSN_HAVE_MMAP
+    int fd = -1;
+#else
+    std::string path;
+    std::string fallback;
+    bool writable = false;
+#endif
 };
 
 class JKSNEncoderPrivate {
@@ -123,7 +352,30 @@ public:
     JKSNProxy dumpToProxy(const JKSNValue &obj);
 private:
     JKSNCache cache;
+    struct DumpFrame {
+        enum Kind {
+            ARRAY,
+            SWAPPED,
+            OBJECT
+        } kind;
+        /* The container, whose children are appended as they are finished */
+        JKSNProxy proxy;
+        /* Elements of an array, or rows of a swapped array */
+        std::vector<const JKSNValue *> items;
+        /* Column names of a swapped array, which point into the rows */
+        std::vector<const JKSNValue *> columns;
+        JKSNObject::const_iterator member;
+        /* Index of the next child, and the number of children */
+        size_t next;
+        size_t count;
+        /* The straight encoding of an array, kept while the swapped one is tried */
+        std::unique_ptr<JKSNProxy> straight;
+    };
     static JKSNProxy dumpValue(const JKSNValue &obj);
+    static JKSNProxy dumpScalar(const JKSNValue &obj);
+    static void openValue(const JKSNValue &obj, std::vector<DumpFrame> &stack);
+    static void openArray(std::vector<const JKSNValue *> &&obj, const JKSNValue *origin, std::vector<DumpFrame> &stack);
+    static JKSNProxy encodeContainer(uint8_t control, size_t length, const JKSNValue *origin);
     static JKSNProxy dumpUndefined(const JKSNValue &obj);
     static JKSNProxy dumpNull(const JKSNValue &obj);
     static JKSNProxy dumpBool(const JKSNValue &obj);
@@ -131,34 +383,494 @@ private:
     static std::string encodeInt(uintmax_t number, size_t size);
     static JKSNProxy dumpFloat(const JKSNValue &obj);
     static JKSNProxy dumpDouble(const JKSNValue &obj);
+    /* The longest encodings of one number, with the control byte */
+    static const size_t max_integer_size = 1 + (sizeof (intmax_t)*8+6)/7;
+    static const size_t max_float_size = 1 + sizeof (float);
+    static const size_t max_double_size = 1 + sizeof (double);
+    static size_t integerSize(intmax_t number);
+    static char *writeLongInteger(char *buf, uint8_t control, intmax_t number);
+    static char *writeInteger(char *buf, intmax_t number, JKSNCache *cache);
+    static char *writeFloat(char *buf, float number);
+    static char *writeDouble(char *buf, double number);
+    static JKSNValue gatherNumbers(const std::vector<const JKSNValue *> &obj);
+    static void openNumbers(JKSNValue &&numbers, const JKSNValue *origin, std::vector<DumpFrame> &stack);
+    static const size_t integer_chunk = 256;
+    static void encodeIntegers(const std::vector<intmax_t> &numbers, std::string &buf, JKSNCache *cache);
+    static char *writeIntegers(char *buf, const intmax_t *numbers, size_t count, JKSNCache *cache);
+    static void encodeFloats(const std::vector<float> &numbers, std::string &buf);
+    static void encodeDoubles(const std::vector<double> &numbers, std::string &buf);
     static JKSNProxy dumpLongDouble(const JKSNValue &obj);
     static JKSNProxy dumpString(const JKSNValue &obj);
     static JKSNProxy dumpBlob(const JKSNValue &obj);
-    static JKSNProxy dumpArray(const JKSNValue &obj);
-    static JKSNProxy dumpArray(const std::vector<const JKSNValue *> &obj, const JKSNValue *origin = nullptr);
     static bool testSwapAvailability(const std::vector<const JKSNValue *> &obj);
-    static JKSNProxy encodeStraightArray(const std::vector<const JKSNValue *> &obj, const JKSNValue *origin = nullptr);
-    static JKSNProxy encodeSwappedArray(const std::vector<const JKSNValue *> &obj, const JKSNValue *origin = nullptr);
-    static JKSNProxy dumpObject(const JKSNValue &obj);
+    static void encodeSwappedArray(DumpFrame &frame);
     static JKSNProxy dumpUnspecified(const JKSNValue &obj);
     JKSNProxy &optimize(JKSNProxy &obj);
 };
 
-class JKSNDecoderPrivate {
+class JKSNStreamInput {
+public:
+    static const bool contiguous = false;
+    JKSNStreamInput(std::istream &fp) :
+        fp(fp) {
+    }
+    uint8_t getByte() {
+        char result;
+        if(!this->fp.get(result))
+            throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
+        return uint8_t(result);
+    }
+    const char *read(size_t size, std::string &buf) {
+        /* The buffer grows with what is actually read, so that a corrupted
+           length fails at the end of the stream instead of allocating it all */
+        buf.clear();
+        while(buf.size() < size) {
+            size_t offset = buf.size();
+            size_t chunk = std::min(size-offset, size_t(chunk_size));
+            buf.resize(offset+chunk);
+            if(!this->fp.read(&buf[offset], std::streamsize(chunk)))
+                throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
+        }
+        return buf.data();
+    }
+    std::string readString(size_t size) {
+        std::string result;
+        this->read(size, result);
+        return result;
+    }
+    void skip(size_t size) {
+        if(!this->fp.ignore(std::streamsize(size)) || size_t(this->fp.gcount()) != size)
+            throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
+    }
+    /* Nothing can be looked at before it is read */
+    const char *peek(size_t &size) const {
+        size = 0;
+        return nullptr;
+    }
+    /* How many of count items, each at least one byte, are worth reserving for */
+    size_t reservable(size_t count) const {
+        return std::min(count, size_t(chunk_size));
+    }
+private:
+    static const size_t chunk_size = 65536;
+    std::istream &fp;
+};
+
+class JKSNBufferInput {
 public:
-    JKSNValue parseValue(std::istream &fp);
+    /* Pointers returned by read stay valid as long as the buffer */
+    static const bool contiguous = true;
+    JKSNBufferInput(const char *begin, const char *end) :
+        begin(begin),
+        ptr(begin),
+        end(end) {
+    }
+    uint8_t getByte() {
+        if(this->ptr == this->end)
+            throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
+        return uint8_t(*this->ptr++);
+    }
+    const char *read(size_t size) {
+        if(size_t(this->end - this->ptr) < size)
+            throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
+        const char *result = this->ptr;
+        this->ptr += size;
+        return result;
+    }
+    const char *read(size_t size, std::string &) {
+        return this->read(size);
+    }
+    std::string readString(size_t size) {
+        const char *result = this->read(size);
+        return std::string(result, size);
+    }
+    void skip(size_t size) {
+        this->read(size);
+    }
+    size_t tell() const {
+        return size_t(this->ptr - this->begin);
+    }
+    /* The bytes not read yet, which skip consumes after a look ahead */
+    const char *peek(size_t &size) const {
+        size = size_t(this->end - this->ptr);
+        return this->ptr;
+    }
+    size_t reservable(size_t count) const {
+        return std::min(count, size_t(this->end - this->ptr));
+    }
 private:
+    const char *begin;
+    const char *ptr;
+    const char *end;
+};
+
+enum JKSNTokenKind : uint8_t {
+    TOKEN_INVALID,
+    TOKEN_UNDEFINED,
+    TOKEN_NULL,
+    TOKEN_FALSE,
+    TOKEN_TRUE,
+    TOKEN_JSON_LITERAL,
+    TOKEN_INT,
+    TOKEN_NAN,
+    TOKEN_FLOAT,
+    TOKEN_DOUBLE,
+    TOKEN_LONG_DOUBLE,
+    TOKEN_NEG_INFINITY,
+    TOKEN_POS_INFINITY,
+    TOKEN_UTF16,
+    TOKEN_UTF16_HASH,
+    TOKEN_UTF8,
+    TOKEN_BLOB,
+    TOKEN_BLOB_HASH,
+    TOKEN_CLEAR,
+    TOKEN_REFRESH,
+    TOKEN_ARRAY,
+    TOKEN_OBJECT,
+    TOKEN_UNSPECIFIED,
+    TOKEN_SWAPPED,
+    TOKEN_LENGTHLESS,
+    TOKEN_DELTA,
+    TOKEN_CHECKSUM,
+    TOKEN_TRAILER,
+    TOKEN_PRAGMA
+};
+
+/* Everything the decoder needs to know about a control byte, looked up once
+   instead of being worked out again by nested switches */
+struct JKSNToken {
+    JKSNTokenKind kind;
+    /* Size of the big-endian number that follows: 1, 2 or 4 bytes, 0 for a
+       varint, or token_inline if the number is held in the control byte */
+    uint8_t width;
+    /* The number held in the control byte, or the size of a checksum */
+    int8_t value;
+    /* The varints of 0x1e and 0xde are negated */
+    bool negative;
+};
+
+static constexpr uint8_t token_inline = 0xff;
+
+static constexpr JKSNToken makeToken(JKSNTokenKind kind, uint8_t width = token_inline, int8_t value = 0, bool negative = false) {
+    return JKSNToken{kind, width, value, negative};
+}
+
+/* 0x?0-0x?c hold the length, 0x?d-0x?f are followed by it */
+static constexpr JKSNToken makeLengthToken(JKSNTokenKind kind, uint8_t control) {
+    return (control & 0xf) == 0xd ? makeToken(kind, 2) :
+           (control & 0xf) == 0xe ? makeToken(kind, 1) :
+           (control & 0xf) == 0xf ? makeToken(kind, 0) :
+           makeToken(kind, token_inline, int8_t(control & 0xf));
+}
+
+/* 0x?0-0x?a hold the integer, 0x?b-0x?f are followed by it */
+static constexpr JKSNToken makeIntegerToken(JKSNTokenKind kind, uint8_t control) {
+    return (control & 0xf) == 0xb ? makeToken(kind, 4) :
+           (control & 0xf) == 0xc ? makeToken(kind, 2) :
+           (control & 0xf) == 0xd ? makeToken(kind, 1) :
+           (control & 0xf) == 0xe ? makeToken(kind, 0, 0, true) :
+           (control & 0xf) == 0xf ? makeToken(kind, 0) :
+           makeToken(kind, token_inline, int8_t(control & 0xf));
+}
+
+static constexpr JKSNToken makeChecksumToken(JKSNTokenKind kind, uint8_t control) {
+    return makeToken(kind, token_inline, int8_t(
+        (control & 0x7) == 0 ? 1 :
+        (control & 0x7) == 1 ? 4 :
+        (control & 0x7) == 2 ? 16 :
+        (control & 0x7) == 3 ? 20 :
+        (control & 0x7) == 4 ? 32 : 64));
+}
+
+static constexpr JKSNToken makeControlToken(uint8_t control) {
+    return control <= 0x03 ? makeToken(JKSNTokenKind(TOKEN_UNDEFINED + control)) :
+           control == 0x0f ? makeToken(TOKEN_JSON_LITERAL) :
+           (control & 0xf0) == 0x10 ? makeIntegerToken(TOKEN_INT, control) :
+           control == 0x20 ? makeToken(TOKEN_NAN) :
+           control == 0x2b ? makeToken(TOKEN_LONG_DOUBLE) :
+           control == 0x2c ? makeToken(TOKEN_DOUBLE) :
+           control == 0x2d ? makeToken(TOKEN_FLOAT) :
+           control == 0x2e ? makeToken(TOKEN_NEG_INFINITY) :
+           control == 0x2f ? makeToken(TOKEN_POS_INFINITY) :
+           control == 0x3c ? makeToken(TOKEN_UTF16_HASH, 1) :
+           (control & 0xf0) == 0x30 ? makeLengthToken(TOKEN_UTF16, control) :
+           (control & 0xf0) == 0x40 ? makeLengthToken(TOKEN_UTF8, control) :
+           control == 0x5c ? makeToken(TOKEN_BLOB_HASH, 1) :
+           (control & 0xf0) == 0x50 ? makeLengthToken(TOKEN_BLOB, control) :
+           control == 0x70 ? makeToken(TOKEN_CLEAR) :
+           (control & 0xf0) == 0x70 ? makeLengthToken(TOKEN_REFRESH, control) :
+           (control & 0xf0) == 0x80 ? makeLengthToken(TOKEN_ARRAY, control) :
+           (control & 0xf0) == 0x90 ? makeLengthToken(TOKEN_OBJECT, control) :
+           control == 0xa0 ? makeToken(TOKEN_UNSPECIFIED) :
+           (control & 0xf0) == 0xa0 ? makeLengthToken(TOKEN_SWAPPED, control) :
+           control == 0xc8 ? makeToken(TOKEN_LENGTHLESS) :
+           /* 0xd6-0xda hold -5 to -1, and 0xdb-0xdf share the layout of 0x1b-0x1f */
+           control >= 0xd0 && control <= 0xd5 ? makeToken(TOKEN_DELTA, token_inline, int8_t(control & 0xf)) :
+           control >= 0xd6 && control <= 0xda ? makeToken(TOKEN_DELTA, token_inline, int8_t((control & 0xf) - 11)) :
+           (control & 0xf0) == 0xd0 ? makeIntegerToken(TOKEN_DELTA, control) :
+           control >= 0xf0 && control <= 0xf5 ? makeChecksumToken(TOKEN_CHECKSUM, control) :
+           control >= 0xf8 && control <= 0xfd ? makeChecksumToken(TOKEN_TRAILER, control) :
+           control == 0xff ? makeToken(TOKEN_PRAGMA) :
+           makeToken(TOKEN_INVALID);
+}
+
+#define JKSN_TOKEN_ROW(hi) \
+    makeControlToken(hi|0x0), makeControlToken(hi|0x1), makeControlToken(hi|0x2), makeControlToken(hi|0x3), \
+    makeControlToken(hi|0x4), makeControlToken(hi|0x5), makeControlToken(hi|0x6), makeControlToken(hi|0x7), \
+    makeControlToken(hi|0x8), makeControlToken(hi|0x9), makeControlToken(hi|0xa), makeControlToken(hi|0xb), \
+    makeControlToken(hi|0xc), makeControlToken(hi|0xd), makeControlToken(hi|0xe), makeControlToken(hi|0xf)
+static constexpr JKSNToken control_tokens[256] = {
+    JKSN_TOKEN_ROW(0x00), JKSN_TOKEN_ROW(0x10), JKSN_TOKEN_ROW(0x20), JKSN_TOKEN_ROW(0x30),
+    JKSN_TOKEN_ROW(0x40), JKSN_TOKEN_ROW(0x50), JKSN_TOKEN_ROW(0x60), JKSN_TOKEN_ROW(0x70),
+    JKSN_TOKEN_ROW(0x80), JKSN_TOKEN_ROW(0x90), JKSN_TOKEN_ROW(0xa0), JKSN_TOKEN_ROW(0xb0),
+    JKSN_TOKEN_ROW(0xc0), JKSN_TOKEN_ROW(0xd0), JKSN_TOKEN_ROW(0xe0), JKSN_TOKEN_ROW(0xf0)
+};
+#undef JKSN_TOKEN_ROW
+
+enum JKSNFrameKind {
+    FRAME_ARRAY,
+    FRAME_OBJECT,
+    FRAME_SWAPPED,
+    FRAME_LENGTHLESS,
+    /* Values read only for their effect on the hashtable, or pragmas */
+    FRAME_DISCARD,
+    /* A value followed by a checksum */
+    FRAME_TRAILER
+};
+
+/* A container, or another value that encloses values, whose contents are still being decoded */
+struct JKSNFrame {
+    JKSNFrameKind kind;
+    /* Values still expected, or the checksum size of a trailer */
+    size_t remaining;
+    /* Array elements, object values, or rows of a swapped array */
+    JKSNArray items;
+    /* Object keys, or column names of a swapped array, kept on the heap until the frame is closed */
+    JKSNArray keys;
+    /* The pending key or column name, or the finished value of a trailer */
+    JKSNValue key;
+    bool haskey;
+    /* Whether the array elements go to numbers, as they have all been numbers
+       of one type so far, instead of items */
+    bool packing;
+    JKSNNumberArray numbers;
+    size_t size() const {
+        return this->packing ? this->numbers.size() : this->items.size();
+    }
+};
+
+/* The same for skipValue, which only counts the values */
+struct JKSNSkipFrame {
+    JKSNFrameKind kind;
+    size_t remaining;
+    bool haskey;
+};
+
+class JKSNDecoderPrivate {
+public:
+    template<typename Input> JKSNValue parseValue(Input &fp) {
+        return this->parseValue(fp, fp.getByte());
+    }
+    template<typename Input> JKSNValue parseValue(Input &fp, uint8_t control);
+    template<typename Input> JKSNValue parseToken(Input &fp, uint8_t control, std::vector<JKSNFrame> &stack);
+    void openFrame(std::vector<JKSNFrame> &stack, JKSNFrameKind kind, size_t remaining, size_t reserve = 0) const {
+        /* Containers for a document are collected straight into its arena.
+           Arrays of numbers are packed, except in a document, whose arena
+           could not free them, and except columns of a swapped array, which
+           are taken apart into rows straight away. */
+        bool packing = (kind == FRAME_ARRAY || kind == FRAME_LENGTHLESS) && !this->arena &&
+            (stack.empty() || stack.back().kind != FRAME_SWAPPED);
+        stack.push_back(JKSNFrame{kind, remaining, JKSNArray(this->arena), JKSNArray(), JKSNValue(), false, packing, JKSNNumberArray()});
+        stack.back().items.reserve(reserve);
+        if(kind == FRAME_OBJECT)
+            stack.back().keys.reserve(reserve);
+    }
+    template<typename Input> uint8_t parseIntegerRun(Input &fp, uint8_t control, JKSNFrame &frame);
+    static size_t countIntegerRun(const char *buffer, size_t size);
+    /* Hands a finished value to the innermost frame, and returns true if there is none */
+    bool closeFrames(std::vector<JKSNFrame> &stack, JKSNValue &value);
+    /* Steps over a value without building it, but still updates the hashtable and the last integer */
+    template<typename Input> jksn_data_type skipValue(Input &fp) {
+        return this->skipValue(fp, fp.getByte());
+    }
+    template<typename Input> jksn_data_type skipValue(Input &fp, uint8_t control);
+    template<typename Input> jksn_data_type skipToken(Input &fp, uint8_t control, std::vector<JKSNSkipFrame> &stack);
+    template<typename Input> JKSNValue parseProjected(Input &fp, const JKSNProjection &projection, size_t node);
+    template<typename Input> JKSNValue parseProjected(Input &fp, const JKSNProjection &projection, size_t node, size_t &trailer);
+    template<typename Input> JKSNValue parseProjectedMember(Input &fp, const JKSNProjection &projection, size_t node);
+    template<typename Input> static uintmax_t decodeInt(Input &fp, size_t size);
+    static size_t decodeVarint(const char *buffer, size_t size, uintmax_t &result);
+    template<typename Input> static uintmax_t decodeLength(Input &fp, const JKSNToken &token);
+    template<typename Input> static uintmax_t decodeLength(Input &fp, uint8_t control) {
+        return decodeLength(fp, control_tokens[control]);
+    }
+    template<typename Input> static intmax_t decodeInteger(Input &fp, const JKSNToken &token);
+    template<typename Input> static intmax_t decodeInteger(Input &fp, uint8_t control) {
+        return decodeInteger(fp, control_tokens[control]);
+    }
+    template<typename Input> static intmax_t decodeDelta(Input &fp, uint8_t control) {
+        return decodeInteger(fp, control_tokens[control]);
+    }
+    static size_t checksumSize(uint8_t control);
+    template<typename Input> static JKSNValue parseFloat(Input &fp);
+    template<typename Input> static JKSNValue parseDouble(Input &fp);
+    template<typename Input> static JKSNValue parseLongDouble(Input &fp);
     JKSNCache cache;
-    static uintmax_t decodeInt(std::istream &fp, size_t size);
-    static JKSNValue parseFloat(std::istream &fp);
-    static JKSNValue parseDouble(std::istream &fp);
-    static JKSNValue parseLongDouble(std::istream &fp);
-    JKSNValue parseSwappedArray(std::istream &fp, size_t column_length);
+    JKSNKeyTable keys;
+    JKSNShapeTable shapes;
+    /* The owner of the buffer, and the arena, while decoding into a JKSNDocument */
+    std::shared_ptr<const void> document;
+    JKSNArena *arena = nullptr;
+    /* Forgets the document once it is decoded, with the shapes kept in its arena */
+    void endDocument() {
+        this->document = nullptr;
+        this->arena = nullptr;
+        this->shapes.clear();
+    }
+    JKSNLimits limits;
+    size_t depth = 0;
+    size_t used = 0;
+    class Nesting {
+    public:
+        explicit Nesting(JKSNDecoderPrivate *decoder) :
+            decoder(decoder) {
+            if(decoder->depth == decoder->limits.max_depth)
+                throw JKSNLimitError("JKSN stream exceeds the nesting depth limit");
+            ++decoder->depth;
+        }
+        Nesting(const Nesting &) = delete;
+        Nesting &operator=(const Nesting &) = delete;
+        ~Nesting() {
+            --this->decoder->depth;
+        }
+    private:
+        JKSNDecoderPrivate *decoder;
+    };
+    size_t checkLength(uintmax_t length) const {
+        if(length > this->limits.max_length || length > ~size_t(0))
+            throw JKSNLimitError("JKSN stream exceeds the container length limit");
+        return size_t(length);
+    }
+    size_t checkStringSize(uintmax_t length, size_t unit = 1) const {
+        if(length > this->limits.max_string / unit)
+            throw JKSNLimitError("JKSN stream exceeds the string length limit");
+        return size_t(length);
+    }
+    void charge(size_t bytes) {
+        if(bytes > this->limits.max_bytes - this->used)
+            throw JKSNLimitError("JKSN stream exceeds the memory limit");
+        this->used += bytes;
+    }
+    /* Never more than the input could still supply, nor than the memory limit allows */
+    template<typename Input> size_t reservable(Input &fp, size_t count) const {
+        return std::min(fp.reservable(count), (this->limits.max_bytes - this->used) / sizeof (JKSNValue));
+    }
+private:
+    template<typename Input> void cacheString(Input &, JKSNCacheEntry &entry, const char *str, size_t size) {
+        if(Input::contiguous && this->document)
+            entry.borrow(this->document, str, size);
+        else
+            entry.assign(str, size);
+    }
+    template<typename Input> JKSNValue makeString(Input &, const char *str, size_t size, std::string &&buf, bool is_blob) {
+        if(!Input::contiguous)
+            return JKSNValue(std::move(buf), is_blob);
+        else if(this->document)
+            return JKSNValue::fromBorrowed(str, size, is_blob);
+        else
+            return JKSNValue::fromBytes(str, size, is_blob);
+    }
+    JKSNValue makeString(const JKSNCacheEntry &entry, bool is_blob) {
+        /* Only a slot referring into the same document may be borrowed, as
+           other slots may be overwritten while the value is still alive */
+        if(entry.isBorrowedFrom(this->document))
+            return JKSNValue::fromBorrowed(entry.data(), entry.size(), is_blob);
+        else
+            return JKSNValue::fromBytes(entry.data(), entry.size(), is_blob);
+    }
+    JKSNValue makeArray(JKSNArray &&items) const {
+        return this->arena ? JKSNValue::fromArena(std::move(items), *this->arena) : JKSNValue(std::move(items));
+    }
+    static void pushElement(JKSNFrame &frame, JKSNValue &&value);
+    static void startPacking(JKSNFrame &frame, jksn_data_type type);
+    static void stopPacking(JKSNFrame &frame);
+    /* Packed if it has at least JKSNValue::pack_threshold elements */
+    JKSNValue closeArray(JKSNFrame &frame) const;
+    JKSNValue makeObject(JKSNObject &&members) const {
+        return this->arena ? JKSNValue::fromArena(std::move(members), *this->arena) : JKSNValue(std::move(members));
+    }
+    /* Objects with the same keys as one decoded before share its shape */
+    JKSNObject shareObject(const JKSNArray &keys, JKSNArray &&values);
+    JKSNArray transposeColumns(JKSNArray &columns);
+    void shareRows(const JKSNArray &names, JKSNArray &rows);
+    template<typename Input> JKSNValue parseProjectedSwappedArray(Input &fp, const JKSNProjection &projection, size_t node, size_t column_length);
+    static JKSNValue projectValue(JKSNValue &&value, const JKSNProjection &projection, size_t node);
+};
+
+class JKSNReaderPrivate {
+public:
+    virtual ~JKSNReaderPrivate() = default;
+    virtual bool next() = 0;
+    virtual void skip() = 0;
+    struct Frame {
+        jksn_token_type token;
+        size_t expected;
+        size_t seen;
+        size_t trailer;
+        bool lengthless;
+    };
+    jksn_token_type token = JKSN_TOKEN_NONE;
+    jksn_data_type type = JKSN_UNDEFINED;
+    size_t size = 0;
+    JKSNValue value;
+    std::string chunk;
+    bool lastchunk = false;
+    std::vector<Frame> stack;
+protected:
+    explicit JKSNReaderPrivate(JKSNDecoderPrivate *decoder) :
+        owned(decoder ? nullptr : new JKSNDecoderPrivate),
+        decoder(decoder ? decoder : owned.get()) {
+    }
+    std::unique_ptr<JKSNDecoderPrivate> owned;
+    JKSNDecoderPrivate *decoder;
+};
+
+template<typename Input>
+class JKSNReaderInput : public JKSNReaderPrivate {
+public:
+    template<typename... Args>
+    JKSNReaderInput(JKSNDecoderPrivate *decoder, Args &&...args) :
+        JKSNReaderPrivate(decoder),
+        input(std::forward<Args>(args)...) {
+    }
+    bool next() override;
+    void skip() override;
+private:
+    static const size_t chunk_size = 65536;
+    Input input;
+    bool started = false;
+    bool instring = false;
+    uint8_t strcontrol = 0;
+    uint8_t strhash = 0;
+    size_t strremain = 0;
+    size_t strtrailer = 0;
+    std::string strtext;
+    std::string strcarry;
+    uint8_t readPrefixes(size_t &trailer);
+    void startContainer(jksn_token_type token, size_t size, size_t expected, size_t trailer, bool lengthless = false);
+    void closeContainer();
+    void startString(uint8_t control, size_t trailer);
+    void readChunk();
+    void finishValue();
 };
 
+static void skipHeader(std::istream &fp);
 static std::string UTF8ToUTF16LE(const std::string &utf8str, bool strict = false);
-static std::string UTF16ToUTF8(const std::u16string &utf16str);
+static inline std::string UTF16ToUTF8(const std::u16string &utf16str);
+static std::string UTF16LEToUTF8(const char *utf16le, size_t length);
 static uint8_t DJBHash(const std::string &obj, uint8_t iv = 0);
+static uint8_t DJBHash(const char *buf, size_t size, uint8_t iv = 0);
+static size_t FNVHash(const char *buf, size_t size);
 static inline bool isLittleEndian();
 
 JKSNEncoder::JKSNEncoder() :
@@ -201,10 +913,25 @@ std::ostream &JKSNEncoder::dump(const JKSNValue &obj, std::ostream &result, bool
 }
 
 std::string JKSNEncoder::dump(const JKSNValue &obj, bool header) {
-    std::ostringstream result;
-    if(!this->dump(obj, result, header))
-        throw JKSNEncodeError("no enough memory");
-    return result.str();
+    /* Sized first and written in place, as dumpFile does, instead of
+       growing a stream and copying it out */
+    JKSNProxy proxy = this->p->dumpToProxy(obj);
+    std::string result(header ? "jk!" : "");
+    size_t offset = result.size();
+    result.resize(offset + proxy.size());
+    proxy.output(&result[offset]);
+    return result;
+}
+
+void JKSNEncoder::dumpFile(const JKSNValue &obj, const std::string &path, bool header) {
+    JKSNProxy proxy = this->p->dumpToProxy(obj);
+    JKSNMappedFile file(path, (header ? 3 : 0) + proxy.size());
+    char *buf = file.data();
+    if(header) {
+        std::memcpy(buf, "jk!", 3);
+        buf += 3;
+    }
+    proxy.output(buf);
 }
 
 JKSNProxy JKSNEncoderPrivate::dumpToProxy(const JKSNValue &obj) {
@@ -214,6 +941,66 @@ JKSNProxy JKSNEncoderPrivate::dumpToProxy(const JKSNValue &obj) {
 }
 
 JKSNProxy JKSNEncoderPrivate::dumpValue(const JKSNValue &obj) {
+    /* Containers wait on an explicit stack for their children instead of
+       recursing, so that the nesting depth is limited only by memory */
+    if(!obj.isArray() && !obj.isObject())
+        return dumpScalar(obj);
+    std::vector<DumpFrame> stack;
+    openValue(obj, stack);
+    for(;;) {
+        DumpFrame &frame = stack.back();
+        if(frame.next != frame.count) {
+            const JKSNValue *child;
+            switch(frame.kind) {
+            case DumpFrame::ARRAY:
+                child = frame.items[frame.next++];
+                break;
+            case DumpFrame::OBJECT:
+                child = frame.next++ % 2 == 0 ? &frame.member->first : &(frame.member++)->second;
+                break;
+            default:
+                child = frame.columns[frame.next++ / 2];
+                if(frame.next % 2 == 0) {
+                    std::vector<const JKSNValue *> columns_value;
+                    columns_value.reserve(frame.items.size());
+                    /* Rows that share a shape have the column in the same place */
+                    const JKSNShape *shape = nullptr;
+                    size_t position = 0;
+                    for(const JKSNValue *const row : frame.items) {
+                        static JKSNValue unspecified_value = JKSNValue::fromUnspecified();
+                        const JKSNObject &members = row->toMap();
+                        if(&members.shape() != shape) {
+                            shape = &members.shape();
+                            position = shape->find(*child);
+                        }
+                        columns_value.push_back(position != members.size() ? &members.begin()[std::ptrdiff_t(position)].second : &unspecified_value);
+                    }
+                    openArray(std::move(columns_value), nullptr, stack);
+                    continue;
+                }
+            }
+            if(child->isArray() || child->isObject())
+                openValue(*child, stack);
+            else
+                frame.proxy.children.push_back(dumpScalar(*child));
+            continue;
+        }
+        if(frame.kind == DumpFrame::ARRAY && testSwapAvailability(frame.items)) {
+            encodeSwappedArray(frame);
+            continue;
+        }
+        assert(frame.proxy.children.size() == frame.count);
+        JKSNProxy result = std::move(frame.proxy);
+        if(frame.kind == DumpFrame::SWAPPED && !(result.size(3) < frame.straight->size(3)))
+            result = std::move(*frame.straight);
+        stack.pop_back();
+        if(stack.empty())
+            return result;
+        stack.back().proxy.children.push_back(std::move(result));
+    }
+}
+
+JKSNProxy JKSNEncoderPrivate::dumpScalar(const JKSNValue &obj) {
     switch(obj.getType()) {
     case JKSN_UNDEFINED:
         return dumpUndefined(obj);
@@ -233,10 +1020,6 @@ JKSNProxy JKSNEncoderPrivate::dumpValue(const JKSNValue &obj) {
         return dumpString(obj);
     case JKSN_BLOB:
         return dumpBlob(obj);
-    case JKSN_ARRAY:
-        return dumpArray(obj);
-    case JKSN_OBJECT:
-        return dumpObject(obj);
     case JKSN_UNSPECIFIED:
         return dumpUnspecified(obj);
     default:
@@ -244,6 +1027,216 @@ JKSNProxy JKSNEncoderPrivate::dumpValue(const JKSNValue &obj) {
     }
 }
 
+void JKSNEncoderPrivate::openValue(const JKSNValue &obj, std::vector<DumpFrame> &stack) {
+    if(obj.isPacked())
+        openNumbers(JKSNValue(obj), &obj, stack);
+    else if(obj.isArray()) {
+        std::vector<const JKSNValue *> obj_vector;
+        obj_vector.reserve(obj.toVector().size());
+        for(const JKSNValue &i : obj.toVector())
+            obj_vector.push_back(&i);
+        openArray(std::move(obj_vector), &obj, stack);
+    } else {
+        const JKSNObject &obj_map = obj.toMap();
+        stack.push_back(DumpFrame{DumpFrame::OBJECT, encodeContainer(0x90, obj_map.size(), &obj),
+            std::vector<const JKSNValue *>(), std::vector<const JKSNValue *>(), obj_map.cbegin(), 0, obj_map.size()*2, nullptr});
+    }
+}
+
+void JKSNEncoderPrivate::openArray(std::vector<const JKSNValue *> &&obj, const JKSNValue *origin, std::vector<DumpFrame> &stack) {
+    JKSNValue numbers = gatherNumbers(obj);
+    if(numbers.isPacked())
+        return openNumbers(std::move(numbers), origin, stack);
+    size_t length = obj.size();
+    stack.push_back(DumpFrame{DumpFrame::ARRAY, encodeContainer(0x80, length, origin),
+        std::move(obj), std::vector<const JKSNValue *>(), JKSNObject::const_iterator(), 0, length, nullptr});
+}
+
+JKSNValue JKSNEncoderPrivate::gatherNumbers(const std::vector<const JKSNValue *> &obj) {
+    /* Elements that are all numbers of one type are encoded as if they were
+       packed, and short arrays are not worth the copy */
+    if(obj.size() < JKSNValue::pack_threshold)
+        return JKSNValue();
+    jksn_data_type type = obj[0]->getType();
+    if(type != JKSN_INT && type != JKSN_FLOAT && type != JKSN_DOUBLE)
+        return JKSNValue();
+    for(const JKSNValue *const i : obj)
+        if(i->getType() != type)
+            return JKSNValue();
+    if(type == JKSN_INT) {
+        std::vector<intmax_t> numbers;
+        numbers.reserve(obj.size());
+        for(const JKSNValue *const i : obj)
+            numbers.push_back(i->toInt());
+        return JKSNNumberArray(std::move(numbers));
+    } else if(type == JKSN_FLOAT) {
+        std::vector<float> numbers;
+        numbers.reserve(obj.size());
+        for(const JKSNValue *const i : obj)
+            numbers.push_back(i->toFloat());
+        return JKSNNumberArray(std::move(numbers));
+    } else {
+        std::vector<double> numbers;
+        numbers.reserve(obj.size());
+        for(const JKSNValue *const i : obj)
+            numbers.push_back(i->toDouble());
+        return JKSNNumberArray(std::move(numbers));
+    }
+}
+
+void JKSNEncoderPrivate::openNumbers(JKSNValue &&numbers, const JKSNValue *origin, std::vector<DumpFrame> &stack) {
+    /* The elements are written into the buffer of the array instead of
+       becoming proxies, and the frame is left with no children to visit */
+    const JKSNNumberArray &elements = numbers.toNumbers();
+    stack.push_back(DumpFrame{DumpFrame::ARRAY, encodeContainer(0x80, elements.size(), origin),
+        std::vector<const JKSNValue *>(), std::vector<const JKSNValue *>(), JKSNObject::const_iterator(), 0, 0, nullptr});
+    JKSNProxy &proxy = stack.back().proxy;
+    switch(elements.elementType()) {
+    case JKSN_INT:
+        encodeIntegers(elements.toInts(), proxy.buf, nullptr);
+        proxy.numbers = std::move(numbers);
+        break;
+    case JKSN_FLOAT:
+        encodeFloats(elements.toFloats(), proxy.buf);
+        break;
+    default:
+        encodeDoubles(elements.toDoubles(), proxy.buf);
+    }
+}
+
+void JKSNEncoderPrivate::encodeIntegers(const std::vector<intmax_t> &numbers, std::string &buf, JKSNCache *cache) {
+    /* Written a chunk at a time, as most integers take far less than their
+       longest encoding */
+    char chunk[integer_chunk*max_integer_size];
+    buf.clear();
+    for(size_t begin = 0; begin < numbers.size(); begin += integer_chunk) {
+        size_t count = std::min(numbers.size()-begin, size_t(integer_chunk));
+        buf.append(chunk, writeIntegers(chunk, &numbers[begin], count, cache));
+    }
+}
+
+char *JKSNEncoderPrivate::writeIntegers(char *buf, const intmax_t *numbers, size_t count, JKSNCache *cache) {
+    size_t i = 0;
+#ifdef JKSN_HAVE_SSE2
+    /* Two at a time, the deltas of numbers that take two bytes or more and
+       differ from the one before by a byte are written without classifying
+       them one by one. Numbers too close to the limits are left to
+       writeInteger, which knows when a delta could overflow. */
+    if(cache && sizeof (intmax_t) == 8) {
+        const __m128i delta_bias = _mm_set1_epi64x(0x80);
+        const __m128i number_bias = _mm_set1_epi64x(0x100);
+        const __m128i limit_bias = _mm_set1_epi64x(0x4000000000000000LL);
+        const __m128i zero = _mm_setzero_si128();
+        for(; count - i >= 2; i += 2) {
+            if(!cache->haslastint) {
+                buf = writeInteger(buf, numbers[i], cache);
+                buf = writeInteger(buf, numbers[i+1], cache);
+                continue;
+            }
+            __m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i *>(numbers + i));
+            __m128i delta = _mm_sub_epi64(current, _mm_set_epi64x(int64_t(numbers[i]), int64_t(cache->lastint)));
+            /* Lanes that pass each test are zero: deltas within [-0x80, 0x7f] and
+               numbers within [-2**62, 2**62), but numbers outside [-0x100, 0xff] */
+            __m128i near = _mm_or_si128(_mm_srli_epi64(_mm_add_epi64(delta, delta_bias), 8),
+                                        _mm_srli_epi64(_mm_add_epi64(current, limit_bias), 63));
+            __m128i small = _mm_srli_epi64(_mm_add_epi64(current, number_bias), 9);
+            unsigned near_mask = unsigned(_mm_movemask_epi8(_mm_cmpeq_epi32(near, zero)));
+            unsigned small_mask = unsigned(_mm_movemask_epi8(_mm_cmpeq_epi32(small, zero)));
+            if(near_mask != 0xffff || (small_mask & 0xff) == 0xff || (small_mask >> 8) == 0xff) {
+                buf = writeInteger(buf, numbers[i], cache);
+                buf = writeInteger(buf, numbers[i+1], cache);
+                continue;
+            }
+            int64_t deltas[2];
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(deltas), delta);
+            for(int64_t d : deltas)
+                if(d >= -0x5 && d <= 0x5)
+                    *buf++ = char(0xd0 | (d >= 0 ? d : d+11));
+                else {
+                    *buf++ = char(0xdd);
+                    *buf++ = char(uint8_t(d));
+                }
+            cache->lastint = numbers[i+1];
+        }
+    }
+#endif
+    for(; i < count; ++i)
+        buf = writeInteger(buf, numbers[i], cache);
+    return buf;
+}
+
+void JKSNEncoderPrivate::encodeFloats(const std::vector<float> &numbers, std::string &buf) {
+    buf.resize(numbers.size()*max_float_size);
+    char *const start = &buf[0];
+    char *end = start;
+    size_t i = 0;
+#ifdef JKSN_HAVE_SSE2
+    /* Four finite numbers at a time are turned big-endian with shifts and shuffles */
+    const __m128i exponent_mask = _mm_set1_epi32(0x7f800000);
+    for(; numbers.size() - i >= 4; i += 4) {
+        __m128i bits = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&numbers[i]));
+        if(_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(bits, exponent_mask), exponent_mask)) != 0) {
+            for(size_t j = i; j < i+4; ++j)
+                end = writeFloat(end, numbers[j]);
+            continue;
+        }
+        bits = _mm_or_si128(_mm_slli_epi16(bits, 8), _mm_srli_epi16(bits, 8));
+        bits = _mm_shufflehi_epi16(_mm_shufflelo_epi16(bits, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+        uint32_t swapped[4];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(swapped), bits);
+        for(uint32_t number : swapped) {
+            *end++ = char(0x2d);
+            std::memcpy(end, &number, sizeof number);
+            end += sizeof number;
+        }
+    }
+#endif
+    for(; i < numbers.size(); ++i)
+        end = writeFloat(end, numbers[i]);
+    buf.resize(size_t(end - start));
+}
+
+void JKSNEncoderPrivate::encodeDoubles(const std::vector<double> &numbers, std::string &buf) {
+    buf.resize(numbers.size()*max_double_size);
+    char *const start = &buf[0];
+    char *end = start;
+    size_t i = 0;
+#ifdef JKSN_HAVE_SSE2
+    /* Two finite numbers at a time are turned big-endian with shifts and
+       shuffles, and the exponents are tested in the high halves */
+    const __m128i exponent_mask = _mm_set1_epi64x(0x7ff0000000000000LL);
+    for(; numbers.size() - i >= 2; i += 2) {
+        __m128i bits = _mm_loadu_si128(reinterpret_cast<const __m128i *>(&numbers[i]));
+        if((_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(bits, exponent_mask), exponent_mask)) & 0xf0f0) != 0) {
+            end = writeDouble(end, numbers[i]);
+            end = writeDouble(end, numbers[i+1]);
+            continue;
+        }
+        bits = _mm_or_si128(_mm_slli_epi16(bits, 8), _mm_srli_epi16(bits, 8));
+        bits = _mm_shufflehi_epi16(_mm_shufflelo_epi16(bits, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+        end[0] = char(0x2c);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(end+1), bits);
+        end[9] = char(0x2c);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(end+10), _mm_unpackhi_epi64(bits, bits));
+        end += 2*max_double_size;
+    }
+#endif
+    for(; i < numbers.size(); ++i)
+        end = writeDouble(end, numbers[i]);
+    buf.resize(size_t(end - start));
+}
+
+JKSNProxy JKSNEncoderPrivate::encodeContainer(uint8_t control, size_t length, const JKSNValue *origin) {
+    if(length <= 0xc)
+        return JKSNProxy(origin, control | uint8_t(length));
+    else if(length <= 0xff)
+        return JKSNProxy(origin, control | 0xe, encodeInt(length, 1));
+    else if(length <= 0xffff)
+        return JKSNProxy(origin, control | 0xd, encodeInt(length, 2));
+    else
+        return JKSNProxy(origin, control | 0xf, encodeInt(length, 0));
+}
+
 JKSNProxy JKSNEncoderPrivate::dumpUndefined(const JKSNValue &obj) {
     return JKSNProxy(&obj, 0x00);
 }
@@ -257,75 +1250,141 @@ JKSNProxy JKSNEncoderPrivate::dumpBool(const JKSNValue &obj) {
 }
 
 JKSNProxy JKSNEncoderPrivate::dumpInt(const JKSNValue &obj) {
-    const intmax_t number = obj.toInt();
-    if(number >= 0 && number <= 0xa)
-        return JKSNProxy(&obj, 0x10 | uint8_t(number));
-    else if(number >= -0x80 && number <= 0x7f)
-        return JKSNProxy(&obj, 0x1d, encodeInt(uintmax_t(number), 1));
+    char buffer[max_integer_size];
+    intmax_t number = obj.toInt();
+    char *end = writeInteger(buffer, number, nullptr);
+    JKSNProxy result(&obj, uint8_t(buffer[0]), std::string(buffer+1, end));
+    result.number = number;
+    return result;
+}
+
+/* The size of the data of an integer too large for the control byte */
+size_t JKSNEncoderPrivate::integerSize(intmax_t number) {
+    if(number >= -0x80 && number <= 0x7f)
+        return 1;
     else if(number >= -0x8000 && number <= 0x7fff)
-        return JKSNProxy(&obj, 0x1c, encodeInt(uintmax_t(number), 2));
+        return 2;
     else if((number >= -0x80000000LL && number <= -0x200000) ||
             (number >= 0x200000 && number <= 0x7fffffff))
-        return JKSNProxy(&obj, 0x1b, encodeInt(uintmax_t(number), 4));
-    else if(number >= 0)
-        return JKSNProxy(&obj, 0x1f, encodeInt(uintmax_t(number), 0));
+        return 4;
+    uintmax_t magnitude = number >= 0 ? uintmax_t(number) : 0-uintmax_t(number);
+    size_t result = 1;
+    while((magnitude >>= 7) != 0)
+        ++result;
+    return result;
+}
+
+/* Writes an integer too large for the control byte, with the control byte
+   of an integer (0x10) or of a delta (0xd0) */
+char *JKSNEncoderPrivate::writeLongInteger(char *buf, uint8_t control, intmax_t number) {
+    size_t size = integerSize(number);
+    switch(size) {
+    case 1:
+        *buf++ = char(control | 0xd);
+        *buf++ = char(uint8_t(number));
+        return buf;
+    case 2:
+        *buf++ = char(control | 0xc);
+        *buf++ = char(uint8_t(uintmax_t(number) >> 8));
+        *buf++ = char(uint8_t(number));
+        return buf;
+    case 4:
+        *buf++ = char(control | 0xb);
+        *buf++ = char(uint8_t(uintmax_t(number) >> 24));
+        *buf++ = char(uint8_t(uintmax_t(number) >> 16));
+        *buf++ = char(uint8_t(uintmax_t(number) >> 8));
+        *buf++ = char(uint8_t(number));
+        return buf;
+    default:
+        {
+            /* Written backwards from the last group, which has no continuation bit */
+            *buf++ = char(control | (number >= 0 ? 0xf : 0xe));
+            uintmax_t magnitude = number >= 0 ? uintmax_t(number) : 0-uintmax_t(number);
+            char *end = buf + size;
+            *--end = char(magnitude & 0x7f);
+            while((magnitude >>= 7) != 0)
+                *--end = char((magnitude & 0x7f) | 0x80);
+            return buf + size;
+        }
+    }
+}
+
+/* Writes an integer, or its delta from the last integer of the stream when
+   that is shorter, and remembers it in cache unless that is nullptr */
+char *JKSNEncoderPrivate::writeInteger(char *buf, intmax_t number, JKSNCache *cache) {
+    bool short_number = number >= 0 && number <= 0xa;
+    bool use_delta = false;
+    intmax_t delta = 0;
+    /* Integers of opposite signs never gain from a delta, and subtracting them may overflow */
+    if(!short_number && cache && cache->haslastint && (number < 0) == (cache->lastint < 0) && number != INTMAX_MIN) {
+        delta = number - cache->lastint;
+        use_delta = std::abs(delta) < std::abs(number) &&
+            ((delta >= -0x5 && delta <= 0x5) || integerSize(delta) < integerSize(number));
+    }
+    if(use_delta && delta >= -0x5 && delta <= 0x5)
+        *buf++ = char(0xd0 | (delta >= 0 ? delta : delta+11));
+    else if(use_delta)
+        buf = writeLongInteger(buf, 0xd0, delta);
+    else if(short_number)
+        *buf++ = char(0x10 | number);
     else
-        return JKSNProxy(&obj, 0x1e, encodeInt(uintmax_t(-number), 0));
+        buf = writeLongInteger(buf, 0x10, number);
+    if(cache) {
+        cache->haslastint = true;
+        cache->lastint = number;
+    }
+    return buf;
 }
 
 JKSNProxy JKSNEncoderPrivate::dumpFloat(const JKSNValue &obj) {
-    const float number = obj.toFloat();
-    if(isnan(number))
-        return JKSNProxy(&obj, 0x20);
-    else if(isinf(number))
-        return JKSNProxy(&obj, number >= 0 ? 0x2f : 0x2e);
+    char buffer[max_float_size];
+    char *end = writeFloat(buffer, obj.toFloat());
+    return JKSNProxy(&obj, uint8_t(buffer[0]), std::string(buffer+1, end));
+}
+
+char *JKSNEncoderPrivate::writeFloat(char *buf, float number) {
+    if(std::isnan(number))
+        *buf++ = char(0x20);
+    else if(std::isinf(number))
+        *buf++ = char(number >= 0 ? 0x2f : 0x2e);
     else {
         static_assert(sizeof (float) == 4, "sizeof (float) should be 4");
-        const union {
-            float data_float;
-            char data_int[4];
-        } conv = {number};
-        if(isLittleEndian())
-            return JKSNProxy(&obj, 0x2d, std::string({
-                conv.data_int[3], conv.data_int[2], conv.data_int[1], conv.data_int[0]
-            }));
-        else
-            return JKSNProxy(&obj, 0x2d, std::string({
-                conv.data_int[0], conv.data_int[1], conv.data_int[2], conv.data_int[3]
-            }));
+        uint32_t bits;
+        std::memcpy(&bits, &number, sizeof bits);
+        *buf++ = char(0x2d);
+        for(int shift = 24; shift >= 0; shift -= 8)
+            *buf++ = char(uint8_t(bits >> shift));
     }
+    return buf;
 }
 
 JKSNProxy JKSNEncoderPrivate::dumpDouble(const JKSNValue &obj) {
-    const double number = obj.toDouble();
-    if(isnan(number))
-        return JKSNProxy(&obj, 0x20);
-    else if(isinf(number))
-        return JKSNProxy(&obj, number >= 0 ? 0x2f : 0x2e);
+    char buffer[max_double_size];
+    char *end = writeDouble(buffer, obj.toDouble());
+    return JKSNProxy(&obj, uint8_t(buffer[0]), std::string(buffer+1, end));
+}
+
+char *JKSNEncoderPrivate::writeDouble(char *buf, double number) {
+    if(std::isnan(number))
+        *buf++ = char(0x20);
+    else if(std::isinf(number))
+        *buf++ = char(number >= 0 ? 0x2f : 0x2e);
     else {
         static_assert(sizeof (double) == 8, "sizeof (double) should be 8");
-        const union {
-            double data_double;
-            char data_int[8];
-        } conv = {number};
-        if(isLittleEndian())
-            return JKSNProxy(&obj, 0x2c, std::string({
-                conv.data_int[7], conv.data_int[6], conv.data_int[5], conv.data_int[4],
-                conv.data_int[3], conv.data_int[2], conv.data_int[1], conv.data_int[0]
-            }));
-        else
-            return JKSNProxy(&obj, 0x2c, std::string({
-                conv.data_int[0], conv.data_int[1], conv.data_int[2], conv.data_int[3],
-                conv.data_int[4], conv.data_int[5], conv.data_int[6], conv.data_int[7]
-            }));
+        uint64_t bits;
+        std::memcpy(&bits, &number, sizeof bits);
+        *buf++ = char(0x2c);
+        for(int shift = 56; shift >= 0; shift -= 8)
+            *buf++ = char(uint8_t(bits >> shift));
     }
+    return buf;
 }
 
 JKSNProxy JKSNEncoderPrivate::dumpLongDouble(const JKSNValue &obj) {
     const long double number = obj.toLongDouble();
-    if(isnan(number))
+    if(std::isnan(number))
         return JKSNProxy(&obj, 0x20);
-    else if(isinf(number))
+    else if(std::isinf(number))
         return JKSNProxy(&obj, number >= 0 ? 0x2f : 0x2e);
     else if(sizeof (long double) == 12) {
         const union {
@@ -417,92 +1476,27 @@ bool JKSNEncoderPrivate::testSwapAvailability(const std::vector<const JKSNValue
     return columns;
 }
 
-JKSNProxy JKSNEncoderPrivate::encodeStraightArray(const std::vector<const JKSNValue *> &obj, const JKSNValue *origin) {
-    size_t length = obj.size();
-    std::unique_ptr<JKSNProxy> result;
-    if(length <= 0xc)
-        result.reset(new JKSNProxy(origin, 0x80 | uint8_t(length)));
-    else if(length <= 0xff)
-        result.reset(new JKSNProxy(origin, 0x8e, encodeInt(length, 1)));
-    else if(length <= 0xffff)
-        result.reset(new JKSNProxy(origin, 0x8d, encodeInt(length, 2)));
-    else
-        result.reset(new JKSNProxy(origin, 0x8f, encodeInt(length, 0)));
-    for(const JKSNValue *const i : obj)
-        result->children.push_back(dumpValue(*i));
-    assert(result->children.size() == length);
-    return std::move(*result);
-}
-
-JKSNProxy JKSNEncoderPrivate::encodeSwappedArray(const std::vector<const JKSNValue *> &obj, const JKSNValue *origin) {
-    std::list<JKSNValue> columns;
+void JKSNEncoderPrivate::encodeSwappedArray(DumpFrame &frame) {
+    /* The straight encoding is kept aside, and the same frame goes on to
+       collect the column names and the column arrays instead */
     std::unordered_set<JKSNValue> columns_set;
-    for(const JKSNValue *const row : obj)
-        for(const std::pair<JKSNValue, JKSNValue> &column : row->toMap())
+    const JKSNShape *shape = nullptr;
+    for(const JKSNValue *const row : frame.items) {
+        /* Rows with the shape of the one before have no new columns */
+        if(&row->toMap().shape() == shape)
+            continue;
+        shape = &row->toMap().shape();
+        for(const auto &column : row->toMap())
             if(columns_set.find(column.first) == columns_set.end()) {
-                columns.push_back(column.first);
+                frame.columns.push_back(&column.first);
                 columns_set.insert(column.first);
             }
-    size_t collen = columns.size();
-    std::unique_ptr<JKSNProxy> result;
-    if(collen <= 0xc)
-        result.reset(new JKSNProxy(origin, 0xa0 | uint8_t(collen)));
-    else if(collen <= 0xff)
-        result.reset(new JKSNProxy(origin, 0xae, encodeInt(collen, 1)));
-    else if(collen <= 0xffff)
-        result.reset(new JKSNProxy(origin, 0xad, encodeInt(collen, 2)));
-    else
-        result.reset(new JKSNProxy(origin, 0xaf, encodeInt(collen, 0)));
-    for(const JKSNValue &column : columns) {
-        result->children.push_back(dumpValue(column));
-        std::vector<const JKSNValue *> columns_value;
-        columns_value.reserve(obj.size());
-        for(const JKSNValue *const row : obj) {
-            static JKSNValue unspecified_value = JKSNValue::fromUnspecified();
-            std::map<JKSNValue, JKSNValue>::const_iterator it = row->toMap().find(column);
-            columns_value.push_back(it != row->toMap().end() ? &it->second : &unspecified_value);
-        }
-        result->children.push_back(dumpArray(columns_value));
-    }
-    assert(result->children.size() == collen*2);
-    return std::move(*result);
-}
-
-JKSNProxy JKSNEncoderPrivate::dumpArray(const JKSNValue &obj) {
-    std::vector<const JKSNValue *> obj_vector;
-    obj_vector.reserve(obj.toVector().size());
-    for(const JKSNValue &i : obj.toVector())
-        obj_vector.push_back(&i);
-    return dumpArray(obj_vector, &obj);
-}
-
-JKSNProxy JKSNEncoderPrivate::dumpArray(const std::vector<const JKSNValue *> &obj, const JKSNValue *origin) {
-    JKSNProxy result = encodeStraightArray(obj, origin);
-    if(testSwapAvailability(obj)) {
-        JKSNProxy result_swapped = encodeSwappedArray(obj);
-        if(result_swapped.size(3) < result.size(3))
-            result = std::move(result_swapped);
-    }
-    return result;
-}
-
-JKSNProxy JKSNEncoderPrivate::dumpObject(const JKSNValue &obj) {
-    size_t length = obj.toMap().size();
-    std::unique_ptr<JKSNProxy> result;
-    if(length <= 0xc)
-        result.reset(new JKSNProxy(&obj, 0x90 | uint8_t(length)));
-    else if(length <= 0xff)
-        result.reset(new JKSNProxy(&obj, 0x9e, encodeInt(length, 1)));
-    else if(length <= 0xffff)
-        result.reset(new JKSNProxy(&obj, 0x9d, encodeInt(length, 2)));
-    else
-        result.reset(new JKSNProxy(&obj, 0x9f, encodeInt(length, 0)));
-    for(const std::pair<JKSNValue, JKSNValue> &item : obj.toMap()) {
-        result->children.push_back(dumpValue(item.first));
-        result->children.push_back(dumpValue(item.second));
     }
-    assert(result->children.size() == length*2);
-    return std::move(*result);
+    frame.straight.reset(new JKSNProxy(std::move(frame.proxy)));
+    frame.proxy = encodeContainer(0xa0, frame.columns.size(), nullptr);
+    frame.kind = DumpFrame::SWAPPED;
+    frame.next = 0;
+    frame.count = frame.columns.size()*2;
 }
 
 JKSNProxy JKSNEncoderPrivate::dumpUnspecified(const JKSNValue &obj) {
@@ -510,70 +1504,56 @@ JKSNProxy JKSNEncoderPrivate::dumpUnspecified(const JKSNValue &obj) {
 }
 
 JKSNProxy &JKSNEncoderPrivate::optimize(JKSNProxy &obj) {
-    uint8_t control = obj.control & 0xf0;
-    switch(control) {
-        case 0x10:
-            if (this->cache.haslastint) {
-                intmax_t delta = obj.origin->toInt() - this->cache.lastint;
-                if(std::abs(delta) < std::abs(obj.origin->toInt())) {
-                    uint8_t new_control;
-                    std::string new_data;
-                    if(delta >= 0 && delta <= 0x5)
-                        new_control = 0xd0 | uint8_t(delta);
-                    else if(delta >= -0x5 && delta <= -0x1)
-                        new_control = 0xd0 | uint8_t(delta+11);
-                    else if(delta >= -0x80 && delta <= 0x7f) {
-                        new_control = 0xdd;
-                        new_data = encodeInt(uintmax_t(delta), 1);
-                    } else if(delta >= -0x8000 && delta <= 0x7fff) {
-                        new_control = 0xdc;
-                        new_data = encodeInt(uintmax_t(delta), 2);
-                    } else if((delta >= -0x80000000LL && delta <= -0x200000) ||
-                              (delta >= 0x200000 && delta <= 0x7fffffff)) {
-                        new_control = 0xdb;
-                        new_data = encodeInt(uintmax_t(delta), 4);
-                    } else if(delta >= 0) {
-                        new_control = 0xdf;
-                        new_data = encodeInt(uintmax_t(delta), 0);
-                    } else {
-                        new_control = 0xde;
-                        new_data = encodeInt(uintmax_t(-delta), 0);
-                    }
-                    if(new_data.size() < obj.data.size()) {
-                        obj.control = new_control;
-                        obj.data = std::move(new_data);
-                    }
+    /* Proxies are visited in stream order, the order in which the decoder
+       fills its hashtable, with an explicit stack instead of recursion */
+    std::vector<std::pair<std::list<JKSNProxy>::iterator, std::list<JKSNProxy>::iterator> > stack;
+    JKSNProxy *next = &obj;
+    for(;;) {
+        JKSNProxy &item = *next;
+        uint8_t control = item.control & 0xf0;
+        switch(control) {
+            case 0x10:
+                {
+                    char buffer[max_integer_size];
+                    char *end = writeInteger(buffer, item.number, &this->cache);
+                    item.control = uint8_t(buffer[0]);
+                    item.data.assign(buffer+1, end);
+                    break;
                 }
-            }
-            this->cache.haslastint = true;
-            this->cache.lastint = obj.origin->toInt();
-            break;
-        case 0x30:
-        case 0x40:
-            if(obj.buf.size() > 1) {
-                if(this->cache.texthash[obj.hash] && *this->cache.texthash[obj.hash] == obj.buf) {
-                    obj.control = 0x3c;
-                    obj.data = encodeInt(obj.hash, 1);
-                    obj.buf.clear();
+            /* Every string enters the hashtable, as the decoder does, but only
+               strings longer than a reference are replaced with one */
+            case 0x30:
+            case 0x40:
+                if(item.buf.size() > 1 && this->cache.texthash[item.hash].equals(item.buf)) {
+                    item.control = 0x3c;
+                    item.data = encodeInt(item.hash, 1);
+                    item.buf.clear();
                 } else
-                    this->cache.texthash[obj.hash] = std::make_shared<std::string>(obj.buf);
-            }
-            break;
-        case 0x50:
-            if(obj.buf.size() > 1) {
-                if(this->cache.blobhash[obj.hash] && *this->cache.blobhash[obj.hash] == obj.buf) {
-                    obj.control = 0x3c;
-                    obj.data = encodeInt(obj.hash, 1);
-                    obj.buf.clear();
+                    this->cache.texthash[item.hash].assign(item.buf.data(), item.buf.size());
+                break;
+            case 0x50:
+                if(item.buf.size() > 1 && this->cache.blobhash[item.hash].equals(item.buf)) {
+                    item.control = 0x5c;
+                    item.data = encodeInt(item.hash, 1);
+                    item.buf.clear();
                 } else
-                    this->cache.blobhash[obj.hash] = std::make_shared<std::string>(obj.buf);
-            }
-            break;
-        default:
-            for(JKSNProxy &child : obj.children)
-                this->optimize(child);
+                    this->cache.blobhash[item.hash].assign(item.buf.data(), item.buf.size());
+                break;
+            default:
+                if(item.numbers.isPacked()) {
+                    /* The integers of the array are written again, now that the
+                       last integer before them is known */
+                    encodeIntegers(item.numbers.toNumbers().toInts(), item.buf, &this->cache);
+                    item.numbers = JKSNValue();
+                } else if(!item.children.empty())
+                    stack.emplace_back(item.children.begin(), item.children.end());
+        }
+        while(!stack.empty() && stack.back().first == stack.back().second)
+            stack.pop_back();
+        if(stack.empty())
+            return obj;
+        next = &*stack.back().first++;
     }
-    return obj;
 }
 
 std::string JKSNEncoderPrivate::encodeInt(uintmax_t number, size_t size) {
@@ -596,13 +1576,13 @@ std::string JKSNEncoderPrivate::encodeInt(uintmax_t number, size_t size) {
         });
     case 0:
         {
-            std::string result(1, char(number & 0x7f));
-            number >>= 7;
-            while(number != 0) {
-                result.append(1, char((number & 0x7f) | 0x80));
-                number >>= 7;
-            }
-            return std::string(result.crbegin(), result.crend());
+            /* Written backwards from the last group, which has no continuation bit */
+            char buffer[(sizeof number*8+6)/7];
+            char *start = buffer + sizeof buffer;
+            *--start = char(number & 0x7f);
+            while((number >>= 7) != 0)
+                *--start = char((number & 0x7f) | 0x80);
+            return std::string(start, buffer + sizeof buffer);
         }
     default:
         assert(size == 1 || size == 2 || size == 4 || size == 0);
@@ -643,437 +1623,1212 @@ JKSNDecoder::~JKSNDecoder() {
 }
 
 JKSNValue JKSNDecoder::parse(std::istream &fp, bool header) {
-    if(header) {
-        char header_buf[3];
-        if(!fp.read(header_buf, 3) || fp.gcount() != 3 || std::memcmp(header_buf, "jk!", 3))
-            fp.seekg(-fp.gcount(), fp.cur);
-    }
-    return this->p->parseValue(fp);
+    if(header)
+        skipHeader(fp);
+    JKSNStreamInput input(fp);
+    this->p->used = 0;
+    return this->p->parseValue(input);
 }
 
 JKSNValue JKSNDecoder::parse(const std::string &str, bool header) {
-    std::istringstream stream(str);
-    return this->parse(stream, header);
+    return this->parse(str.data(), str.size(), nullptr, header);
+}
+
+JKSNValue JKSNDecoder::parse(const char *buf, size_t size, size_t *consumed, bool header) {
+    JKSNBufferInput input(buf, buf+size);
+    if(header && size >= 3 && !std::memcmp(buf, "jk!", 3))
+        input.skip(3);
+    this->p->used = 0;
+    JKSNValue result = this->p->parseValue(input);
+    if(consumed)
+        *consumed = input.tell();
+    return result;
+}
+
+JKSNValue JKSNDecoder::parseFile(const std::string &path, bool header) {
+    JKSNMappedFile file(path);
+    return this->parse(file.data(), file.size(), nullptr, header);
+}
+
+JKSNDocument JKSNDecoder::parseDocument(std::string &&buf, bool header) {
+    std::shared_ptr<std::string> storage = std::make_shared<std::string>(std::move(buf));
+    JKSNDocument result;
+    result.storage = storage;
+    /* The first chunk of the arena is as large as the buffer */
+    result.arena = std::make_shared<JKSNArena>(std::max(storage->size(), size_t(0x10000)));
+    /* Slots of the hashtable that borrow from the buffer keep it alive as well */
+    this->p->document = storage;
+    this->p->arena = result.arena.get();
+    try {
+        result.root = this->parse(storage->data(), storage->size(), nullptr, header);
+    } catch(...) {
+        this->p->endDocument();
+        throw;
+    }
+    this->p->endDocument();
+    return result;
+}
+
+JKSNDocument JKSNDecoder::parseDocumentFile(const std::string &path, bool header) {
+    std::shared_ptr<JKSNMappedFile> file = std::make_shared<JKSNMappedFile>(path);
+    JKSNDocument result;
+    result.storage = file;
+    result.arena = std::make_shared<JKSNArena>(std::max(file->size(), size_t(0x10000)));
+    this->p->document = file;
+    this->p->arena = result.arena.get();
+    try {
+        result.root = this->parse(file->data(), file->size(), nullptr, header);
+    } catch(...) {
+        this->p->endDocument();
+        throw;
+    }
+    this->p->endDocument();
+    return result;
+}
+
+JKSNValue JKSNDecoder::parse(std::istream &fp, const JKSNProjection &projection, bool header) {
+    if(header)
+        skipHeader(fp);
+    JKSNStreamInput input(fp);
+    this->p->used = 0;
+    return this->p->parseProjectedMember(input, projection, 0);
+}
+
+JKSNValue JKSNDecoder::parse(const std::string &str, const JKSNProjection &projection, bool header) {
+    return this->parse(str.data(), str.size(), nullptr, projection, header);
+}
+
+JKSNValue JKSNDecoder::parse(const char *buf, size_t size, size_t *consumed, const JKSNProjection &projection, bool header) {
+    JKSNBufferInput input(buf, buf+size);
+    if(header && size >= 3 && !std::memcmp(buf, "jk!", 3))
+        input.skip(3);
+    this->p->used = 0;
+    JKSNValue result = this->p->parseProjectedMember(input, projection, 0);
+    if(consumed)
+        *consumed = input.tell();
+    return result;
+}
+
+JKSNValue JKSNDecoder::parseFile(const std::string &path, const JKSNProjection &projection, bool header) {
+    JKSNMappedFile file(path);
+    return this->parse(file.data(), file.size(), nullptr, projection, header);
+}
+
+void JKSNDecoder::setLimits(const JKSNLimits &limits) {
+    this->p->limits = limits;
+}
+
+const JKSNLimits &JKSNDecoder::getLimits() const {
+    return this->p->limits;
+}
+
+JKSNProjection::JKSNProjection(std::initializer_list<std::string> paths) {
+    for(const std::string &path : paths)
+        this->add(path);
+}
+
+JKSNProjection::JKSNProjection(const std::vector<std::string> &paths) {
+    for(const std::string &path : paths)
+        this->add(path);
+}
+
+JKSNProjection &JKSNProjection::add(const std::string &path) {
+    if(!path.empty() && path[0] != '/')
+        throw JKSNError("JKSN projection path should start with a slash");
+    this->paths.push_back(path);
+    /* The tree is rebuilt so that every wildcard can be merged into its siblings,
+       whichever order the paths were added in */
+    this->nodes.assign(1, Node());
+    for(const std::string &item : this->paths) {
+        size_t node = 0;
+        size_t pos = 0;
+        while(pos < item.size()) {
+            size_t end = std::min(item.find('/', pos+1), item.size());
+            std::string token;
+            for(size_t i = pos+1; i < end; ++i)
+                if(item[i] == '~' && i+1 < end && (item[i+1] == '0' || item[i+1] == '1'))
+                    token.push_back(item[++i] == '0' ? '~' : '/');
+                else
+                    token.push_back(item[i]);
+            if(token == "*") {
+                if(this->nodes[node].wildcard == npos) {
+                    this->nodes.push_back(Node());
+                    this->nodes[node].wildcard = this->nodes.size()-1;
+                }
+                node = this->nodes[node].wildcard;
+            } else
+                node = this->child(node, token);
+            pos = end;
+        }
+        this->nodes[node].selected = true;
+    }
+    this->distribute(0);
+    return *this;
+}
+
+size_t JKSNProjection::child(size_t node, const std::string &token) {
+    std::map<std::string, size_t>::const_iterator it = this->nodes[node].keys.find(token);
+    if(it != this->nodes[node].keys.end())
+        return it->second;
+    size_t result = this->nodes.size();
+    this->nodes.push_back(Node());
+    this->nodes[node].keys[token] = result;
+    /* A token made of digits also addresses an array element */
+    if(!token.empty() && token.size() <= 18 && token.find_first_not_of("0123456789") == std::string::npos && (token == "0" || token[0] != '0'))
+        this->nodes[node].indices[size_t(std::stoull(token))] = result;
+    return result;
+}
+
+void JKSNProjection::merge(size_t target, size_t source) {
+    if(this->nodes[source].selected)
+        this->nodes[target].selected = true;
+    std::vector<std::pair<std::string, size_t>> keys(this->nodes[source].keys.begin(), this->nodes[source].keys.end());
+    for(const std::pair<std::string, size_t> &key : keys)
+        this->merge(this->child(target, key.first), key.second);
+    size_t wildcard = this->nodes[source].wildcard;
+    if(wildcard != npos) {
+        if(this->nodes[target].wildcard == npos) {
+            this->nodes.push_back(Node());
+            this->nodes[target].wildcard = this->nodes.size()-1;
+        }
+        this->merge(this->nodes[target].wildcard, wildcard);
+    }
+}
+
+void JKSNProjection::distribute(size_t node) {
+    std::vector<size_t> children;
+    for(const std::pair<const std::string, size_t> &key : this->nodes[node].keys)
+        children.push_back(key.second);
+    size_t wildcard = this->nodes[node].wildcard;
+    if(wildcard != npos)
+        for(size_t child : children)
+            this->merge(child, wildcard);
+    for(size_t child : children)
+        this->distribute(child);
+    if(wildcard != npos)
+        this->distribute(wildcard);
+}
+
+size_t JKSNProjection::findKey(size_t node, const JKSNValue &key) const {
+    if(node == npos)
+        return npos;
+    const Node &item = this->nodes[node];
+    if(!item.keys.empty() && (key.isString() || key.isInt())) {
+        std::map<std::string, size_t>::const_iterator it = item.keys.find(key.toString());
+        if(it != item.keys.end())
+            return it->second;
+    }
+    return item.wildcard;
+}
+
+size_t JKSNProjection::findIndex(size_t node, size_t index) const {
+    if(node == npos)
+        return npos;
+    const Node &item = this->nodes[node];
+    if(!item.indices.empty()) {
+        std::map<size_t, size_t>::const_iterator it = item.indices.find(index);
+        if(it != item.indices.end())
+            return it->second;
+    }
+    return item.wildcard;
 }
 
-JKSNValue JKSNDecoderPrivate::parseValue(std::istream &fp) {
+
+template<typename Input>
+JKSNValue JKSNDecoderPrivate::parseValue(Input &fp, uint8_t control) {
+    /* Containers are kept on an explicit stack, as in the push decoder, so that
+       the nesting depth is limited by memory and limits.max_depth, not by the call stack */
+    Nesting nesting(this);
+    std::vector<JKSNFrame> stack;
     for(;;) {
-        char signed_control;
-        if(!fp.get(signed_control))
-            throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
-        uint8_t control = uint8_t(signed_control);
-        uint8_t ctrlhi = control & 0xf0;
-        switch(ctrlhi) {
-        /* Special values */
-        case 0x00:
-            switch(control) {
-            case 0x00:
-                return JKSNValue();
-            case 0x01:
-                return JKSNValue(nullptr);
-            case 0x02:
-                return JKSNValue(false);
-            case 0x03:
-                return JKSNValue(true);
-            case 0x0f:
-                throw JKSNDecodeError("this JKSN decoder does not support JSON literals");
+        if(!stack.empty())
+            control = this->parseIntegerRun(fp, control, stack.back());
+        this->charge(sizeof (JKSNValue));
+        size_t opened = stack.size();
+        JKSNValue value = this->parseToken(fp, control, stack);
+        if(stack.size() == opened)
+            for(;;) {
+                if(this->closeFrames(stack, value))
+                    return value;
+                /* A pragma may have been the only frame, which leaves the stack empty */
+                if(stack.empty() || stack.back().kind != FRAME_TRAILER || !stack.back().haskey)
+                    break;
+                fp.skip(stack.back().remaining);
+                value = std::move(stack.back().key);
+                stack.pop_back();
             }
+        if(stack.size() > this->limits.max_depth - this->depth)
+            throw JKSNLimitError("JKSN stream exceeds the nesting depth limit");
+        control = fp.getByte();
+    }
+}
+
+/* Appends a run of one-byte integers and deltas, the usual contents of a time
+   series, straight to an array frame. The last integer of the run is returned
+   as the next control byte, so that parseToken finishes the frame as usual. */
+template<typename Input>
+uint8_t JKSNDecoderPrivate::parseIntegerRun(Input &fp, uint8_t control, JKSNFrame &frame) {
+    const JKSNToken &token = control_tokens[control];
+    /* A leading delta without a last integer is left to report its error */
+    if((token.kind != TOKEN_INT && (token.kind != TOKEN_DELTA || !this->cache.haslastint)) ||
+       token.width != token_inline || (frame.kind != FRAME_ARRAY && frame.kind != FRAME_LENGTHLESS))
+        return control;
+    size_t available;
+    const char *buffer = fp.peek(available);
+    if(frame.kind == FRAME_ARRAY)
+        available = std::min(available, frame.remaining - 1);
+    size_t length = countIntegerRun(buffer, available);
+    if(length == 0)
+        return control;
+    if(frame.kind == FRAME_LENGTHLESS)
+        this->checkLength(frame.size() + length + 1);
+    this->charge(length * sizeof (JKSNValue));
+    /* The integers before the last one, starting with control itself */
+    intmax_t lastint = this->cache.lastint;
+    /* An array stays packed if it has had nothing but integers */
+    if(frame.packing && frame.numbers.empty())
+        startPacking(frame, JKSN_INT);
+    else if(frame.packing && frame.numbers.elementType() != JKSN_INT)
+        stopPacking(frame);
+    if(frame.packing)
+        frame.numbers.reserve(frame.numbers.size() + length);
+    else
+        frame.items.reserve(frame.items.size() + length);
+    for(size_t i = 0; i < length; ++i) {
+        const JKSNToken &item = control_tokens[i == 0 ? control : uint8_t(buffer[i-1])];
+        if(item.kind == TOKEN_INT)
+            lastint = item.value;
+        else
+            lastint = intmax_t(uintmax_t(lastint) + uintmax_t(intmax_t(item.value)));
+        if(frame.packing)
+            frame.numbers.ints.push_back(lastint);
+        else
+            frame.items.emplace_back(lastint);
+    }
+    this->cache.lastint = lastint;
+    this->cache.haslastint = true;
+    if(frame.kind == FRAME_ARRAY)
+        frame.remaining -= length;
+    fp.skip(length);
+    return uint8_t(buffer[length-1]);
+}
+
+/* Counts the leading bytes of buffer that are one-byte integers (0x10-0x1a)
+   or one-byte deltas (0xd0-0xda) */
+size_t JKSNDecoderPrivate::countIntegerRun(const char *buffer, size_t size) {
+    size_t result = 0;
+#ifdef JKSN_HAVE_SSE2
+    const __m128i high_mask = _mm_set1_epi8(char(0xf0));
+    const __m128i low_mask = _mm_set1_epi8(0x0f);
+    const __m128i int_high = _mm_set1_epi8(0x10);
+    const __m128i delta_high = _mm_set1_epi8(char(0xd0));
+    const __m128i low_max = _mm_set1_epi8(0x0a);
+    for(; size - result >= 16; result += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(buffer + result));
+        __m128i high = _mm_and_si128(bytes, high_mask);
+        __m128i low = _mm_and_si128(bytes, low_mask);
+        __m128i matches = _mm_and_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(high, int_high), _mm_cmpeq_epi8(high, delta_high)),
+            _mm_cmpeq_epi8(_mm_max_epu8(low, low_max), low_max));
+        unsigned mask = unsigned(_mm_movemask_epi8(matches));
+        if(mask != 0xffff)
+            return result + size_t(__builtin_ctz(~mask));
+    }
+#endif
+    for(; result < size; ++result) {
+        uint8_t control = uint8_t(buffer[result]);
+        if(((control & 0xf0) != 0x10 && (control & 0xf0) != 0xd0) || (control & 0xf) > 0xa)
             break;
+    }
+    return result;
+}
+
+/* Reads one token, which is either a whole value, or opens a container or
+   another frame and leaves its contents to the caller */
+template<typename Input>
+JKSNValue JKSNDecoderPrivate::parseToken(Input &fp, uint8_t control, std::vector<JKSNFrame> &stack) {
+    for(;;) {
+        /* One jump on the kind of token, looked up from the control byte */
+        const JKSNToken &token = control_tokens[control];
+        switch(token.kind) {
+        /* Special values */
+        case TOKEN_UNDEFINED:
+            return JKSNValue();
+        case TOKEN_NULL:
+            return JKSNValue(nullptr);
+        case TOKEN_FALSE:
+            return JKSNValue(false);
+        case TOKEN_TRUE:
+            return JKSNValue(true);
+        case TOKEN_JSON_LITERAL:
+            throw JKSNDecodeError("this JKSN decoder does not support JSON literals");
         /* Integers */
-        case 0x10:
+        case TOKEN_INT:
+            this->cache.lastint = this->decodeInteger(fp, token);
             this->cache.haslastint = true;
-            switch(control) {
-            case 0x1b:
-                this->cache.lastint = intmax_t(int32_t(this->decodeInt(fp, 4)));
-                break;
-            case 0x1c:
-                this->cache.lastint = intmax_t(int16_t(this->decodeInt(fp, 2)));
-                break;
-            case 0x1d:
-                this->cache.lastint = intmax_t(int8_t(this->decodeInt(fp, 1)));
-                break;
-            case 0x1e:
-                this->cache.lastint = -intmax_t(this->decodeInt(fp, 0));
-                if(this->cache.lastint >= 0)
-                    throw JKSNDecodeError("this build of JKSN decoder does not support variable length integers");
-                break;
-            case 0x1f:
-                this->cache.lastint = intmax_t(this->decodeInt(fp, 0));
-                if(this->cache.lastint < 0)
-                    throw JKSNDecodeError("this build of JKSN decoder does not support variable length integers");
-                break;
-            default:
-                this->cache.lastint = control & 0xf;
-            }
             return JKSNValue(this->cache.lastint);
         /* Floating point numbers */
-        case 0x20:
-            switch(control) {
-            case 0x20:
-                return JKSNValue(NAN);
-            case 0x2b:
-                return this->parseLongDouble(fp);
-            case 0x2c:
-                return this->parseDouble(fp);
-            case 0x2d:
-                return this->parseFloat(fp);
-            case 0x2e:
-                return JKSNValue(-INFINITY);
-            case 0x2f:
-                return JKSNValue(INFINITY);
-            }
-            break;
+        case TOKEN_NAN:
+            return JKSNValue(NAN);
+        case TOKEN_LONG_DOUBLE:
+            return this->parseLongDouble(fp);
+        case TOKEN_DOUBLE:
+            return this->parseDouble(fp);
+        case TOKEN_FLOAT:
+            return this->parseFloat(fp);
+        case TOKEN_NEG_INFINITY:
+            return JKSNValue(-INFINITY);
+        case TOKEN_POS_INFINITY:
+            return JKSNValue(INFINITY);
         /* UTF-16 strings */
-        case 0x30:
+        case TOKEN_UTF16_HASH:
             {
-                size_t strsize;
-                switch(control) {
-                case 0x3c:
-                    {
-                        char hashvalue;
-                        if(!fp.get(hashvalue))
-                            throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
-                        if(this->cache.texthash[uint8_t(hashvalue)])
-                            return JKSNValue(*this->cache.texthash[uint8_t(hashvalue)]);
-                        else
-                            throw JKSNDecodeError("JKSN stream requires a non-existing hash");
-                    }
-                case 0x3d:
-                    strsize = this->decodeInt(fp, 2);
-                    break;
-                case 0x3e:
-                    strsize = this->decodeInt(fp, 1);
-                    break;
-                case 0x3f:
-                    strsize = this->decodeInt(fp, 0);
-                    break;
-                default:
-                    strsize = control & 0xf;
+                uint8_t hashvalue = fp.getByte();
+                if(this->cache.texthash[hashvalue]) {
+                    this->charge(this->cache.texthash[hashvalue].size());
+                    return this->makeString(this->cache.texthash[hashvalue], false);
                 }
-                std::vector<char16_t> strbuf(strsize);
-                if(!fp.read(reinterpret_cast<char *>(strbuf.data()), std::streamsize(strsize*2)))
-                    throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
-                if(!isLittleEndian())
-                    for(char16_t &i : strbuf)
-                        i = char16_t(uint16_t(i) >> 8 | uint16_t(i) << 8);
-                std::string result = UTF16ToUTF8(std::u16string(strbuf.cbegin(), strbuf.cend()));
-                this->cache.texthash[DJBHash(result)].reset(new std::string(result));
+                else
+                    throw JKSNDecodeError("JKSN stream requires a non-existing hash");
+            }
+        case TOKEN_UTF16:
+            {
+                size_t strsize = this->checkStringSize(this->decodeLength(fp, token), 2);
+                this->charge(strsize*2);
+                std::string strbuf;
+                const char *utf16le = fp.read(strsize*2, strbuf);
+                std::string result = UTF16LEToUTF8(utf16le, strsize);
+                this->cache.texthash[DJBHash(utf16le, strsize*2)].assign(result.data(), result.size());
                 return JKSNValue(std::move(result));
             }
         /* UTF-8 strings */
-        case 0x40:
+        case TOKEN_UTF8:
             {
-                size_t strsize;
-                switch(control) {
-                case 0x4d:
-                    strsize = this->decodeInt(fp, 2);
-                    break;
-                case 0x4e:
-                    strsize = this->decodeInt(fp, 1);
-                    break;
-                case 0x3f:
-                    strsize = this->decodeInt(fp, 0);
-                    break;
-                default:
-                    strsize = control & 0xf;
-                }
-                std::vector<char> strbuf(strsize);
-                if(!fp.read(strbuf.data(), std::streamsize(strsize)))
-                    throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
-                std::string result = std::string(strbuf.cbegin(), strbuf.cend());
-                this->cache.texthash[DJBHash(result)].reset(new std::string(result));
-                return JKSNValue(std::move(result));
+                size_t strsize = this->checkStringSize(this->decodeLength(fp, token));
+                this->charge(strsize);
+                std::string strbuf;
+                const char *str = fp.read(strsize, strbuf);
+                this->cacheString(fp, this->cache.texthash[DJBHash(str, strsize)], str, strsize);
+                return this->makeString(fp, str, strsize, std::move(strbuf), false);
             }
         /* Blob strings */
-        case 0x50:
+        case TOKEN_BLOB_HASH:
             {
-                size_t strsize;
-                switch(control) {
-                case 0x5c:
-                    {
-                        char hashvalue;
-                        if(!fp.get(hashvalue))
-                            throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
-                        if(this->cache.blobhash[uint8_t(hashvalue)])
-                            return JKSNValue(*this->cache.blobhash[uint8_t(hashvalue)]);
-                        else
-                            throw JKSNDecodeError("JKSN stream requires a non-existing hash");
-                    }
-                case 0x5d:
-                    strsize = this->decodeInt(fp, 2);
-                    break;
-                case 0x5e:
-                    strsize = this->decodeInt(fp, 1);
-                    break;
-                case 0x5f:
-                    strsize = this->decodeInt(fp, 0);
-                    break;
-                default:
-                    strsize = control & 0xf;
+                uint8_t hashvalue = fp.getByte();
+                if(this->cache.blobhash[hashvalue]) {
+                    this->charge(this->cache.blobhash[hashvalue].size());
+                    return this->makeString(this->cache.blobhash[hashvalue], true);
                 }
-                std::vector<char> strbuf(strsize);
-                if(!fp.read(strbuf.data(), std::streamsize(strsize)))
-                    throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
-                std::string result = std::string(strbuf.cbegin(), strbuf.cend());
-                this->cache.blobhash[DJBHash(result)].reset(new std::string(result));
-                return JKSNValue(std::move(result), true);
+                else
+                    throw JKSNDecodeError("JKSN stream requires a non-existing hash");
+            }
+        case TOKEN_BLOB:
+            {
+                size_t strsize = this->checkStringSize(this->decodeLength(fp, token));
+                this->charge(strsize);
+                std::string strbuf;
+                const char *str = fp.read(strsize, strbuf);
+                this->cacheString(fp, this->cache.blobhash[DJBHash(str, strsize)], str, strsize);
+                return this->makeString(fp, str, strsize, std::move(strbuf), true);
             }
         /* Hashtable refreshers */
-        case 0x70:
+        case TOKEN_CLEAR:
+            this->cache.clearStrings();
+            control = fp.getByte();
+            continue;
+        case TOKEN_REFRESH:
             {
-                size_t objlen;
-                switch(control) {
-                case 0x70:
-                    this->cache.texthash.fill(nullptr);
-                    this->cache.texthash.fill(nullptr);
-                    continue;
-                case 0x7d:
-                    objlen = this->decodeInt(fp, 2);
-                    break;
-                case 0x7e:
-                    objlen = this->decodeInt(fp, 1);
-                    break;
-                case 0x7f:
-                    objlen = this->decodeInt(fp, 0);
-                    break;
-                default:
-                    objlen = control & 0xf;
+                size_t objlen = this->checkLength(this->decodeLength(fp, token));
+                if(objlen != 0) {
+                    openFrame(stack, FRAME_DISCARD, objlen);
+                    return JKSNValue();
                 }
-                while(objlen--)
-                    this->parseValue(fp);
+                control = fp.getByte();
                 continue;
             }
         /* Arrays */
-        case 0x80:
+        case TOKEN_ARRAY:
             {
-                size_t objlen;
-                switch(control) {
-                case 0x8d:
-                    objlen = this->decodeInt(fp, 2);
-                    break;
-                case 0x8e:
-                    objlen = this->decodeInt(fp, 1);
-                    break;
-                case 0x8f:
-                    objlen = this->decodeInt(fp, 0);
-                    break;
-                default:
-                    objlen = control & 0xf;
-                }
-                std::vector<JKSNValue> result;
-                result.reserve(objlen);
-                while(objlen--)
-                    result.push_back(this->parseValue(fp));
-                return JKSNValue(std::move(result));
+                size_t objlen = this->checkLength(this->decodeLength(fp, token));
+                if(objlen == 0)
+                    return JKSNValue(JKSNArray());
+                openFrame(stack, FRAME_ARRAY, objlen, this->reservable(fp, objlen));
+                return JKSNValue();
             }
         /* Objects */
-        case 0x90:
+        case TOKEN_OBJECT:
             {
-                size_t objlen;
-                switch(control) {
-                case 0x9d:
-                    objlen = this->decodeInt(fp, 2);
-                    break;
-                case 0x9e:
-                    objlen = this->decodeInt(fp, 1);
-                    break;
-                case 0x9f:
-                    objlen = this->decodeInt(fp, 0);
-                    break;
-                default:
-                    objlen = control & 0xf;
-                }
-                std::map<JKSNValue, JKSNValue> result;
-                while(objlen--) {
-                    JKSNValue key = this->parseValue(fp);
-                    result[std::move(key)] = this->parseValue(fp);
-                }
-                return JKSNValue(std::move(result));
+                size_t objlen = this->checkLength(this->decodeLength(fp, token));
+                if(objlen == 0)
+                    return JKSNValue(JKSNObject());
+                openFrame(stack, FRAME_OBJECT, objlen, this->reservable(fp, objlen));
+                return JKSNValue();
             }
         /* Row-col swapped arrays */
-        case 0xa0:
+        case TOKEN_UNSPECIFIED:
+            return JKSNValue::fromUnspecified();
+        case TOKEN_SWAPPED:
             {
-                size_t collen;
-                switch(control) {
-                case 0xa0:
-                    return JKSNValue::fromUnspecified();
-                case 0xad:
-                    collen = this->decodeInt(fp, 2);
-                    break;
-                case 0xae:
-                    collen = this->decodeInt(fp, 1);
-                    break;
-                case 0xaf:
-                    collen = this->decodeInt(fp, 0);
-                    break;
-                default:
-                    collen = control & 0xf;
-                }
-                return this->parseSwappedArray(fp, collen);
+                size_t collen = this->checkLength(this->decodeLength(fp, token));
+                if(collen == 0)
+                    return JKSNValue(JKSNArray());
+                openFrame(stack, FRAME_SWAPPED, collen);
+                return JKSNValue();
             }
         /* Lengthless arrays */
-        case 0xc0:
-            switch(control) {
-                case 0xc8:
-                    {
-                        std::vector<JKSNValue> result;
-                        for(;;) {
-                            JKSNValue item = this->parseValue(fp);
-                            if(!item.isUnspecified())
-                                result.push_back(std::move(item));
-                            else
-                                return JKSNValue(std::move(result));
-                        }
-                    }
-            }
-            break;
+        case TOKEN_LENGTHLESS:
+            openFrame(stack, FRAME_LENGTHLESS, 0);
+            return JKSNValue();
         /* Delta encoded integers */
-        case 0xd0:
+        case TOKEN_DELTA:
             {
-                intmax_t delta;
-                switch(control) {
-                case 0xd0: case 0xd1: case 0xd2: case 0xd3: case 0xd4: case 0xd5:
-                    delta = control & 0xf;
-                    break;
-                case 0xd6: case 0xd7: case 0xd8: case 0xd9: case 0xda:
-                    delta = intmax_t(control & 0xf)-11;
-                    break;
-                case 0xdb:
-                    delta = intmax_t(int32_t(this->decodeInt(fp, 4)));
-                    break;
-                case 0xdc:
-                    delta = intmax_t(int16_t(this->decodeInt(fp, 2)));
-                    break;
-                case 0xdd:
-                    delta = intmax_t(int8_t(this->decodeInt(fp, 1)));
-                    break;
-                case 0xde:
-                    delta = -intmax_t(this->decodeInt(fp, 0));
-                    if(delta >= 0)
-                        throw JKSNDecodeError("this build of JKSN decoder does not support variable length integers");
-                    break;
-                case 0xdf:
-                    delta = intmax_t(this->decodeInt(fp, 0));
-                    if(delta < 0)
-                        throw JKSNDecodeError("this build of JKSN decoder does not support variable length integers");
-                    break;
-                }
+                intmax_t delta = this->decodeInteger(fp, token);
                 if(!this->cache.haslastint)
                     throw JKSNDecodeError("JKSN stream contains an invalid delta encoded integer");
-                this->cache.haslastint = true;
-                this->cache.lastint += delta;
+                this->cache.lastint = intmax_t(uintmax_t(this->cache.lastint) + uintmax_t(delta));
                 return JKSNValue(this->cache.lastint);
             }
-        case 0xf0:
-            /* Ignore checksums */
-            if(control <= 0xf5) {
-                std::vector<char> buf;
-                switch(control) {
-                case 0xf0:
-                    buf.reserve(1);
-                    if(!fp.read(buf.data(), 1))
-                        throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
-                    continue;
-                case 0xf1:
-                    buf.reserve(4);
-                    if(!fp.read(buf.data(), 4))
-                        throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
-                    continue;
-                case 0xf2:
-                    buf.reserve(16);
-                    if(!fp.read(buf.data(), 16))
-                        throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
-                    continue;
-                case 0xf3:
-                    buf.reserve(20);
-                    if(!fp.read(buf.data(), 20))
-                        throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
-                    continue;
-                case 0xf4:
-                    buf.reserve(32);
-                    if(!fp.read(buf.data(), 32))
-                        throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
-                    continue;
-                case 0xf5:
-                    buf.reserve(64);
-                    if(!fp.read(buf.data(), 64))
-                        throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
-                    continue;
-                }
-            } else if (control >= 0xf8 && control <= 0xfd) {
-                std::vector<char> buf;
-                JKSNValue result;
-                switch(control) {
-                case 0xf8:
-                    result = parseValue(fp);
-                    buf.reserve(1);
-                    if(!fp.read(buf.data(), 1))
-                        throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
-                    continue;
-                case 0xf9:
-                    result = parseValue(fp);
-                    buf.reserve(4);
-                    if(!fp.read(buf.data(), 4))
-                        throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
-                    continue;
-                case 0xfa:
-                    result = parseValue(fp);
-                    buf.reserve(16);
-                    if(!fp.read(buf.data(), 16))
-                        throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
-                    continue;
-                case 0xfb:
-                    result = parseValue(fp);
-                    buf.reserve(20);
-                    if(!fp.read(buf.data(), 20))
-                        throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
-                    continue;
-                case 0xfc:
-                    result = parseValue(fp);
-                    buf.reserve(32);
-                    if(!fp.read(buf.data(), 32))
-                        throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
-                    continue;
-                case 0xfd:
-                    result = parseValue(fp);
-                    buf.reserve(64);
-                    if(!fp.read(buf.data(), 64))
-                        throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
-                    continue;
+        /* Ignore checksums */
+        case TOKEN_CHECKSUM:
+            fp.skip(size_t(token.value));
+            control = fp.getByte();
+            continue;
+        case TOKEN_TRAILER:
+            openFrame(stack, FRAME_TRAILER, size_t(token.value));
+            return JKSNValue();
+        /* Ignore pragmas */
+        case TOKEN_PRAGMA:
+            openFrame(stack, FRAME_DISCARD, 1);
+            return JKSNValue();
+        case TOKEN_INVALID:
+            break;
+        }
+        throw JKSNDecodeError("cannot encode unrecognizable type of value");
+    }
+}
+
+bool JKSNDecoderPrivate::closeFrames(std::vector<JKSNFrame> &stack, JKSNValue &value) {
+    /* A finished value may in turn finish every container it closes */
+    for(;;) {
+        if(stack.empty())
+            return true;
+        if(this->arena)
+            value.moveToArena(*this->arena);
+        JKSNFrame &frame = stack.back();
+        switch(frame.kind) {
+        case FRAME_ARRAY:
+            pushElement(frame, std::move(value));
+            if(--frame.remaining != 0)
+                return false;
+            value = this->closeArray(frame);
+            break;
+        case FRAME_OBJECT:
+            if(!frame.haskey) {
+                this->keys.intern(value);
+                frame.keys.push_back(std::move(value));
+                frame.haskey = true;
+                return false;
+            }
+            frame.items.push_back(std::move(value));
+            frame.haskey = false;
+            if(--frame.remaining != 0)
+                return false;
+            value = this->makeObject(this->shareObject(frame.keys, std::move(frame.items)));
+            break;
+        case FRAME_SWAPPED:
+            if(!frame.haskey) {
+                /* Every row shares the column name */
+                this->keys.intern(value);
+                frame.keys.push_back(std::move(value));
+                frame.haskey = true;
+                return false;
+            }
+            if(!value.isArray())
+                throw JKSNDecodeError("JKSN row-col swapped array requires an array but not found");
+            /* Columns are kept whole until the last one is in, so that each row is
+               sized once by the columns read rather than by a count from the stream */
+            frame.items.push_back(std::move(value));
+            frame.haskey = false;
+            if(--frame.remaining != 0)
+                return false;
+            frame.items = this->transposeColumns(frame.items);
+            this->shareRows(frame.keys, frame.items);
+            value = this->makeArray(std::move(frame.items));
+            break;
+        case FRAME_LENGTHLESS:
+            if(!value.isUnspecified()) {
+                this->checkLength(frame.size()+1);
+                pushElement(frame, std::move(value));
+                return false;
+            }
+            value = this->closeArray(frame);
+            break;
+        case FRAME_DISCARD:
+            if(--frame.remaining == 0)
+                stack.pop_back();
+            return false;
+        case FRAME_TRAILER:
+            /* The checksum is skipped by the caller, which may have to wait for it */
+            frame.key = std::move(value);
+            frame.haskey = true;
+            return false;
+        }
+        stack.pop_back();
+    }
+}
+
+void JKSNDecoderPrivate::pushElement(JKSNFrame &frame, JKSNValue &&value) {
+    if(frame.packing) {
+        jksn_data_type type = value.getType();
+        if(frame.numbers.empty() && (type == JKSN_INT || type == JKSN_FLOAT || type == JKSN_DOUBLE))
+            startPacking(frame, type);
+        if(type == frame.numbers.elementType()) {
+            frame.numbers.push_back(value);
+            return;
+        }
+        stopPacking(frame);
+    }
+    frame.items.push_back(std::move(value));
+}
+
+void JKSNDecoderPrivate::startPacking(JKSNFrame &frame, jksn_data_type type) {
+    /* The first element decides the type, and the room reserved for items goes to numbers */
+    if(type != frame.numbers.elementType())
+        frame.numbers = JKSNNumberArray(type);
+    frame.numbers.reserve(frame.items.capacity());
+    JKSNArray().swap(frame.items);
+}
+
+void JKSNDecoderPrivate::stopPacking(JKSNFrame &frame) {
+    frame.items.reserve(std::max(frame.items.capacity(), frame.numbers.size()+1));
+    for(size_t i = 0; i < frame.numbers.size(); ++i)
+        frame.items.push_back(frame.numbers[i]);
+    frame.numbers = JKSNNumberArray();
+    frame.packing = false;
+}
+
+JKSNValue JKSNDecoderPrivate::closeArray(JKSNFrame &frame) const {
+    if(frame.packing && frame.numbers.size() >= JKSNValue::pack_threshold)
+        return JKSNValue(std::move(frame.numbers));
+    else if(frame.packing)
+        stopPacking(frame);
+    return this->makeArray(std::move(frame.items));
+}
+
+void JKSNKeyTable::intern(JKSNValue &key) {
+    /* Short keys are inline and borrowed ones cost nothing to copy already */
+    if(!key.isStringOrBlob() || key.data_storage != JKSNValue::STORAGE_HEAP || key.data_string->size() > max_key_size)
+        return;
+    const std::string &bytes = *key.data_string;
+    size_t hash = FNVHash(bytes.data(), bytes.size());
+    if(this->count*2 >= this->slots.size())
+        this->grow();
+    size_t mask = this->slots.size()-1;
+    size_t slot = hash & mask;
+    for(; !this->slots[slot].isUndefined(); slot = (slot+1) & mask) {
+        const JKSNValue &entry = this->slots[slot];
+        if(entry.data_key->data.hash == hash && entry.getType() == key.getType() && entry.data_key->data.bytes == bytes) {
+            key = entry;
+            return;
+        }
+    }
+    JKSNValue result;
+    result.data_key = new JKSNValue::SharedKey(std::move(*key.data_string), hash);
+    result.data_storage = JKSNValue::STORAGE_INTERNED;
+    result.data_type = key.data_type;
+    key = result;
+    this->slots[slot] = std::move(result);
+    ++this->count;
+}
+
+void JKSNKeyTable::grow() {
+    if(this->count == max_keys)
+        this->clear();
+    std::vector<JKSNValue> old(std::max<size_t>(this->slots.size()*2, 64));
+    old.swap(this->slots);
+    size_t mask = this->slots.size()-1;
+    for(JKSNValue &entry : old)
+        if(!entry.isUndefined()) {
+            size_t slot = entry.data_key->data.hash & mask;
+            while(!this->slots[slot].isUndefined())
+                slot = (slot+1) & mask;
+            this->slots[slot] = std::move(entry);
+        }
+}
+
+JKSNObject::SharedShape *JKSNShapeTable::share(const JKSNArray &keys, const JKSNAllocator<JKSNValue> &allocator) {
+    if(allocator.arena != this->arena) {
+        this->clear();
+        this->arena = allocator.arena;
+    }
+    /* Only strings are kept, as keys of other types may compare equal to a
+       key of another type, such as 1 to 1.0, which the object would not keep */
+    bool kept = keys.size() <= max_shape_size;
+    for(size_t i = 0; kept && i < keys.size(); ++i)
+        kept = keys[i].isStringOrBlob();
+    size_t hash = keys.size();
+    size_t slot = 0;
+    if(kept) {
+        for(const JKSNValue &key : keys)
+            hash = hash*31 + JKSNShape::hashKey(key);
+        if(this->count*2 >= this->slots.size())
+            this->grow();
+        size_t mask = this->slots.size()-1;
+        for(slot = hash & mask; this->slots[slot].shape; slot = (slot+1) & mask) {
+            JKSNObject::SharedShape *shape = this->slots[slot].shape;
+            if(this->slots[slot].hash == hash && shape->data.keys.size() == keys.size() &&
+               std::equal(keys.begin(), keys.end(), shape->data.keys.begin(), [](const JKSNValue &a, const JKSNValue &b) {
+                   return a.getType() == b.getType() && a == b;
+               })) {
+                shape->acquire();
+                return shape;
+            }
+        }
+    }
+    JKSNObject::SharedShape *shape = JKSNObject::newShape(allocator);
+    shape->data.keys.reserve(keys.size());
+    for(const JKSNValue &key : keys) {
+        size_t key_hash = 0;
+        if(shape->data.locate(key, key_hash) != shape->data.size()) {
+            JKSNObject::releaseShape(shape);
+            return nullptr;
+        }
+        shape->data.append(JKSNValue(key), key_hash);
+    }
+    if(kept) {
+        shape->acquire();
+        this->slots[slot] = Slot{hash, shape};
+        ++this->count;
+    }
+    return shape;
+}
+
+void JKSNShapeTable::clear() {
+    /* Shapes in an arena are left to it, as it may be gone already */
+    if(!this->arena)
+        for(Slot &slot : this->slots)
+            JKSNObject::releaseShape(slot.shape);
+    this->slots.clear();
+    this->count = 0;
+    this->arena = nullptr;
+}
+
+void JKSNShapeTable::grow() {
+    if(this->count == max_shapes) {
+        JKSNArena *arena = this->arena;
+        this->clear();
+        this->arena = arena;
+    }
+    std::vector<Slot> old(std::max<size_t>(this->slots.size()*2, 64), Slot{0, nullptr});
+    old.swap(this->slots);
+    size_t mask = this->slots.size()-1;
+    for(const Slot &entry : old)
+        if(entry.shape) {
+            size_t slot = entry.hash & mask;
+            while(this->slots[slot].shape)
+                slot = (slot+1) & mask;
+            this->slots[slot] = entry;
+        }
+}
+
+JKSNObject JKSNDecoderPrivate::shareObject(const JKSNArray &keys, JKSNArray &&values) {
+    JKSNObject result(values.get_allocator());
+    if(JKSNObject::SharedShape *shape = this->shapes.share(keys, values.get_allocator())) {
+        result.keys = shape;
+        result.values = std::move(values);
+        return result;
+    }
+    /* A key that appears again replaces the value, but keeps the place, of its first appearance */
+    for(size_t i = 0; i < keys.size(); ++i)
+        result[keys[i]] = std::move(values[i]);
+    return result;
+}
+
+JKSNArray JKSNDecoderPrivate::transposeColumns(JKSNArray &columns) {
+    /* Row i takes the ith value of every column, with the gaps marked unspecified */
+    std::vector<JKSNArray *> cells;
+    cells.reserve(columns.size());
+    size_t count = 0;
+    for(JKSNValue &column : columns) {
+        cells.push_back(&column.ownVector());
+        count = std::max(count, cells.back()->size());
+    }
+    JKSNArray rows(columns.get_allocator());
+    rows.reserve(count);
+    for(size_t i = 0; i < count; ++i) {
+        JKSNObject row(columns.get_allocator());
+        row.values.reserve(cells.size());
+        for(JKSNArray *column : cells)
+            row.values.push_back(i < column->size() ? std::move((*column)[i]) : JKSNValue::fromUnspecified());
+        rows.push_back(this->makeObject(std::move(row)));
+    }
+    return rows;
+}
+
+void JKSNDecoderPrivate::shareRows(const JKSNArray &names, JKSNArray &rows) {
+    /* Rows with every column share one shape, and the others one for each set
+       of columns they have */
+    JKSNObject::SharedShape *full = this->shapes.share(names, rows.get_allocator());
+    JKSNArray present;
+    for(JKSNValue &row : rows) {
+        JKSNObject &members = row.ownMap();
+        bool complete = full != nullptr;
+        for(size_t i = 0; complete && i < members.values.size(); ++i)
+            complete = !members.values[i].isUnspecified();
+        if(complete) {
+            full->acquire();
+            members.keys = full;
+            continue;
+        }
+        present.clear();
+        JKSNArray cells(members.values.get_allocator());
+        for(size_t i = 0; i < members.values.size(); ++i)
+            if(!members.values[i].isUnspecified()) {
+                present.push_back(names[i]);
+                cells.push_back(std::move(members.values[i]));
+            }
+        members = this->shareObject(present, std::move(cells));
+    }
+    JKSNObject::releaseShape(full);
+}
+
+template<typename Input>
+jksn_data_type JKSNDecoderPrivate::skipValue(Input &fp, uint8_t control) {
+    /* Containers are counted down on an explicit stack, as in parseValue */
+    Nesting nesting(this);
+    std::vector<JKSNSkipFrame> stack;
+    for(;;) {
+        size_t opened = stack.size();
+        jksn_data_type type = this->skipToken(fp, control, stack);
+        if(stack.size() == opened)
+            for(;;) {
+                if(stack.empty())
+                    return type;
+                JKSNSkipFrame &frame = stack.back();
+                bool closed = false;
+                switch(frame.kind) {
+                case FRAME_ARRAY:
+                    closed = --frame.remaining == 0;
+                    type = JKSN_ARRAY;
+                    break;
+                case FRAME_OBJECT:
+                    frame.haskey = !frame.haskey;
+                    closed = !frame.haskey && --frame.remaining == 0;
+                    type = JKSN_OBJECT;
+                    break;
+                case FRAME_SWAPPED:
+                    if(frame.haskey && type != JKSN_ARRAY)
+                        throw JKSNDecodeError("JKSN row-col swapped array requires an array but not found");
+                    frame.haskey = !frame.haskey;
+                    closed = !frame.haskey && --frame.remaining == 0;
+                    type = JKSN_ARRAY;
+                    break;
+                case FRAME_LENGTHLESS:
+                    closed = type == JKSN_UNSPECIFIED;
+                    type = JKSN_ARRAY;
+                    break;
+                case FRAME_DISCARD:
+                    if(--frame.remaining == 0)
+                        stack.pop_back();
+                    break;
+                case FRAME_TRAILER:
+                    fp.skip(frame.remaining);
+                    closed = true;
+                    break;
                 }
-                return result;
-            /* Ignore pragmas */
+                if(!closed)
+                    break;
+                stack.pop_back();
+            }
+        if(stack.size() > this->limits.max_depth - this->depth)
+            throw JKSNLimitError("JKSN stream exceeds the nesting depth limit");
+        control = fp.getByte();
+    }
+}
+
+template<typename Input>
+jksn_data_type JKSNDecoderPrivate::skipToken(Input &fp, uint8_t control, std::vector<JKSNSkipFrame> &stack) {
+    for(;;) {
+        const JKSNToken &token = control_tokens[control];
+        switch(token.kind) {
+        case TOKEN_UNDEFINED:
+            return JKSN_UNDEFINED;
+        case TOKEN_NULL:
+            return JKSN_NULL;
+        case TOKEN_FALSE:
+        case TOKEN_TRUE:
+            return JKSN_BOOL;
+        case TOKEN_JSON_LITERAL:
+            throw JKSNDecodeError("this JKSN decoder does not support JSON literals");
+        case TOKEN_INT:
+            this->cache.lastint = this->decodeInteger(fp, token);
+            this->cache.haslastint = true;
+            return JKSN_INT;
+        case TOKEN_NAN:
+        case TOKEN_NEG_INFINITY:
+        case TOKEN_POS_INFINITY:
+            return JKSN_FLOAT;
+        case TOKEN_LONG_DOUBLE:
+            fp.skip(10);
+            return JKSN_LONG_DOUBLE;
+        case TOKEN_DOUBLE:
+            fp.skip(8);
+            return JKSN_DOUBLE;
+        case TOKEN_FLOAT:
+            fp.skip(4);
+            return JKSN_FLOAT;
+        case TOKEN_UTF16_HASH:
+            if(!this->cache.texthash[fp.getByte()])
+                throw JKSNDecodeError("JKSN stream requires a non-existing hash");
+            return JKSN_STRING;
+        case TOKEN_UTF16:
+            {
+                size_t strsize = this->checkStringSize(this->decodeLength(fp, token), 2);
+                std::string strbuf;
+                const char *utf16le = fp.read(strsize*2, strbuf);
+                this->cache.texthash[DJBHash(utf16le, strsize*2)].assign(UTF16LEToUTF8(utf16le, strsize));
+                return JKSN_STRING;
+            }
+        case TOKEN_UTF8:
+            {
+                size_t strsize = this->checkStringSize(this->decodeLength(fp, token));
+                std::string strbuf;
+                const char *utf8 = fp.read(strsize, strbuf);
+                this->cacheString(fp, this->cache.texthash[DJBHash(utf8, strsize)], utf8, strsize);
+                return JKSN_STRING;
+            }
+        case TOKEN_BLOB_HASH:
+            if(!this->cache.blobhash[fp.getByte()])
+                throw JKSNDecodeError("JKSN stream requires a non-existing hash");
+            return JKSN_BLOB;
+        case TOKEN_BLOB:
+            {
+                size_t strsize = this->checkStringSize(this->decodeLength(fp, token));
+                std::string strbuf;
+                const char *blob = fp.read(strsize, strbuf);
+                this->cacheString(fp, this->cache.blobhash[DJBHash(blob, strsize)], blob, strsize);
+                return JKSN_BLOB;
+            }
+        case TOKEN_CLEAR:
+            this->cache.clearStrings();
+            control = fp.getByte();
+            continue;
+        case TOKEN_REFRESH:
+            {
+                size_t objlen = this->checkLength(this->decodeLength(fp, token));
+                if(objlen != 0) {
+                    stack.push_back(JKSNSkipFrame{FRAME_DISCARD, objlen, false});
+                    return JKSN_UNDEFINED;
+                }
+                control = fp.getByte();
+                continue;
+            }
+        case TOKEN_ARRAY:
+            {
+                size_t objlen = this->checkLength(this->decodeLength(fp, token));
+                if(objlen != 0)
+                    stack.push_back(JKSNSkipFrame{FRAME_ARRAY, objlen, false});
+                return JKSN_ARRAY;
+            }
+        case TOKEN_OBJECT:
+            {
+                size_t objlen = this->checkLength(this->decodeLength(fp, token));
+                if(objlen != 0)
+                    stack.push_back(JKSNSkipFrame{FRAME_OBJECT, objlen, false});
+                return JKSN_OBJECT;
+            }
+        case TOKEN_UNSPECIFIED:
+            return JKSN_UNSPECIFIED;
+        case TOKEN_SWAPPED:
+            {
+                size_t collen = this->checkLength(this->decodeLength(fp, token));
+                if(collen != 0)
+                    stack.push_back(JKSNSkipFrame{FRAME_SWAPPED, collen, false});
+                return JKSN_ARRAY;
+            }
+        case TOKEN_LENGTHLESS:
+            stack.push_back(JKSNSkipFrame{FRAME_LENGTHLESS, 0, false});
+            return JKSN_ARRAY;
+        case TOKEN_DELTA:
+            {
+                intmax_t delta = this->decodeInteger(fp, token);
+                if(!this->cache.haslastint)
+                    throw JKSNDecodeError("JKSN stream contains an invalid delta encoded integer");
+                this->cache.lastint = intmax_t(uintmax_t(this->cache.lastint) + uintmax_t(delta));
+                return JKSN_INT;
+            }
+        case TOKEN_CHECKSUM:
+            fp.skip(size_t(token.value));
+            control = fp.getByte();
+            continue;
+        case TOKEN_TRAILER:
+            stack.push_back(JKSNSkipFrame{FRAME_TRAILER, size_t(token.value), false});
+            return JKSN_UNDEFINED;
+        case TOKEN_PRAGMA:
+            stack.push_back(JKSNSkipFrame{FRAME_DISCARD, 1, false});
+            return JKSN_UNDEFINED;
+        case TOKEN_INVALID:
+            break;
+        }
+        throw JKSNDecodeError("cannot decode unrecognizable type of value");
+    }
+}
+
+template<typename Input>
+JKSNValue JKSNDecoderPrivate::parseProjected(Input &fp, const JKSNProjection &projection, size_t node) {
+    size_t trailer = 0;
+    JKSNValue result = this->parseProjected(fp, projection, node, trailer);
+    if(trailer != 0)
+        fp.skip(trailer);
+    return result;
+}
+
+template<typename Input>
+JKSNValue JKSNDecoderPrivate::parseProjected(Input &fp, const JKSNProjection &projection, size_t node, size_t &trailer) {
+    Nesting nesting(this);
+    this->charge(sizeof (JKSNValue));
+    uint8_t control = fp.getByte();
+    for(;;) {
+        switch(control & 0xf0) {
+        case 0x70:
+            if(control == 0x70) {
+                this->cache.clearStrings();
+            } else {
+                size_t objlen = this->checkLength(this->decodeLength(fp, control));
+                while(objlen--)
+                    this->skipValue(fp);
+            }
+            control = fp.getByte();
+            continue;
+        case 0x80:
+            {
+                size_t objlen = this->checkLength(this->decodeLength(fp, control));
+                JKSNArray result;
+                result.reserve(this->reservable(fp, objlen));
+                for(size_t i = 0; i < objlen; ++i)
+                    result.push_back(this->parseProjectedMember(fp, projection, projection.findIndex(node, i)));
+                return JKSNValue(std::move(result));
+            }
+        case 0x90:
+            {
+                size_t objlen = this->checkLength(this->decodeLength(fp, control));
+                JKSNObject result;
+                while(objlen--) {
+                    JKSNValue key = this->parseValue(fp);
+                    this->keys.intern(key);
+                    size_t child = projection.findKey(node, key);
+                    JKSNValue value = this->parseProjectedMember(fp, projection, child);
+                    if(projection.isSelected(child) || value.isArray() || value.isObject())
+                        result[std::move(key)] = std::move(value);
+                }
+                return JKSNValue(std::move(result));
+            }
+        case 0xa0:
+            if(control == 0xa0)
+                return JKSNValue::fromUnspecified();
+            return this->parseProjectedSwappedArray(fp, projection, node, this->checkLength(this->decodeLength(fp, control)));
+        case 0xc0:
+            if(control == 0xc8) {
+                JKSNArray result;
+                for(;;) {
+                    JKSNValue item = this->parseProjectedMember(fp, projection, projection.findIndex(node, result.size()));
+                    if(item.isUnspecified())
+                        return JKSNValue(std::move(result));
+                    this->checkLength(result.size()+1);
+                    result.push_back(std::move(item));
+                }
+            }
+            break;
+        case 0xf0:
+            if(control <= 0xf5) {
+                fp.skip(this->checksumSize(control));
+                control = fp.getByte();
+                continue;
+            } else if(control >= 0xf8 && control <= 0xfd) {
+                /* Checksums after the value are added up instead of recursed into */
+                trailer += this->checksumSize(control);
+                control = fp.getByte();
+                continue;
             } else if(control == 0xff) {
-                parseValue(fp);
+                this->skipValue(fp);
+                control = fp.getByte();
                 continue;
             }
+            break;
         }
-        throw JKSNDecodeError("cannot encode unrecognizable type of value");
+        /* A scalar where a container is expected does not match the projection */
+        this->skipValue(fp, control);
+        return JKSNValue();
     }
 }
 
-uintmax_t JKSNDecoderPrivate::decodeInt(std::istream &fp, size_t size) {
-    switch(size) {
+template<typename Input>
+JKSNValue JKSNDecoderPrivate::parseProjectedMember(Input &fp, const JKSNProjection &projection, size_t node) {
+    if(projection.isSelected(node))
+        return this->parseValue(fp);
+    else if(node != JKSNProjection::npos)
+        return this->parseProjected(fp, projection, node);
+    /* The placeholder still takes a place in its array */
+    this->charge(sizeof (JKSNValue));
+    if(this->skipValue(fp) == JKSN_UNSPECIFIED)
+        return JKSNValue::fromUnspecified();
+    else
+        return JKSNValue();
+}
+
+template<typename Input>
+JKSNValue JKSNDecoderPrivate::parseProjectedSwappedArray(Input &fp, const JKSNProjection &projection, size_t node, size_t column_length) {
+    JKSNArray result;
+    while(column_length--) {
+        JKSNValue column_name = this->parseValue(fp);
+        this->keys.intern(column_name);
+        /* A column is decoded if any row pattern selects it, otherwise it is
+           only walked through to learn the number of rows */
+        bool wanted = false;
+        if(node != JKSNProjection::npos) {
+            const JKSNProjection::Node &pattern = projection.nodes[node];
+            size_t wildcard = pattern.wildcard;
+            if(wildcard != JKSNProjection::npos)
+                wanted = projection.isSelected(wildcard) || projection.findKey(wildcard, column_name) != JKSNProjection::npos;
+            for(const std::pair<const size_t, size_t> &index : pattern.indices)
+                wanted = wanted || projection.isSelected(index.second) || projection.findKey(index.second, column_name) != JKSNProjection::npos;
+        }
+        JKSNValue column_values = wanted ? this->parseValue(fp) : this->parseProjected(fp, projection, JKSNProjection::npos);
+        if(!column_values.isArray())
+            throw JKSNDecodeError("JKSN row-col swapped array requires an array but not found");
+        JKSNArray &column_values_vector = column_values.toVector();
+        for(size_t i = 0; i < column_values_vector.size(); ++i) {
+            size_t row = projection.findIndex(node, i);
+            if(i == result.size())
+                result.push_back(row != JKSNProjection::npos ? JKSNValue(JKSNObject()) : JKSNValue());
+            if(!wanted || row == JKSNProjection::npos || column_values_vector[i].isUnspecified())
+                continue;
+            if(projection.isSelected(row))
+                result[i].toMap()[column_name] = std::move(column_values_vector[i]);
+            else {
+                size_t cell = projection.findKey(row, column_name);
+                if(projection.isSelected(cell))
+                    result[i].toMap()[column_name] = std::move(column_values_vector[i]);
+                else if(cell != JKSNProjection::npos) {
+                    JKSNValue value = projectValue(std::move(column_values_vector[i]), projection, cell);
+                    if(value.isArray() || value.isObject())
+                        result[i].toMap()[column_name] = std::move(value);
+                }
+            }
+        }
+    }
+    return JKSNValue(std::move(result));
+}
+
+JKSNValue JKSNDecoderPrivate::projectValue(JKSNValue &&value, const JKSNProjection &projection, size_t node) {
+    if(projection.isSelected(node))
+        return std::move(value);
+    else if(node == JKSNProjection::npos)
+        return JKSNValue();
+    else if(value.isArray()) {
+        JKSNArray &items = value.toVector();
+        for(size_t i = 0; i < items.size(); ++i)
+            items[i] = projectValue(std::move(items[i]), projection, projection.findIndex(node, i));
+        return std::move(value);
+    } else if(value.isObject()) {
+        JKSNObject result;
+        for(auto &&item : value.toMap()) {
+            size_t child = projection.findKey(node, item.first);
+            JKSNValue member = projectValue(std::move(item.second), projection, child);
+            if(projection.isSelected(child) || member.isArray() || member.isObject())
+                result[item.first] = std::move(member);
+        }
+        return JKSNValue(std::move(result));
+    } else
+        return JKSNValue();
+}
+
+template<typename Input>
+uintmax_t JKSNDecoderPrivate::decodeLength(Input &fp, const JKSNToken &token) {
+    if(token.width == token_inline)
+        return uintmax_t(token.value);
+    return decodeInt(fp, token.width);
+}
+
+template<typename Input>
+intmax_t JKSNDecoderPrivate::decodeInteger(Input &fp, const JKSNToken &token) {
+    intmax_t result;
+    switch(token.width) {
+    case 4:
+        return intmax_t(int32_t(decodeInt(fp, 4)));
+    case 2:
+        return intmax_t(int16_t(decodeInt(fp, 2)));
     case 1:
-        {
-            char buffer;
-            if(!fp.get(buffer))
-                throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
-            return uintmax_t(uint8_t(buffer));
+        return intmax_t(int8_t(decodeInt(fp, 1)));
+    case 0:
+        if(token.negative) {
+            result = -intmax_t(decodeInt(fp, 0));
+            if(result >= 0)
+                throw JKSNDecodeError("this build of JKSN decoder does not support variable length integers");
+        } else {
+            result = intmax_t(decodeInt(fp, 0));
+            if(result < 0)
+                throw JKSNDecodeError("this build of JKSN decoder does not support variable length integers");
         }
+        return result;
+    default:
+        return token.value;
+    }
+}
+
+size_t JKSNDecoderPrivate::checksumSize(uint8_t control) {
+    assert(control_tokens[control].kind == TOKEN_CHECKSUM || control_tokens[control].kind == TOKEN_TRAILER);
+    return size_t(control_tokens[control].value);
+}
+
+size_t JKSNDecoderPrivate::decodeVarint(const char *buffer, size_t size, uintmax_t &result) {
+    /* Returns the length of the varint at buffer, or 0 if it is left to the
+       byte by byte loop of decodeInt: when fewer than eight bytes are there to
+       be loaded at once, or when the varint is longer, and might overflow */
+#ifdef JKSN_HAVE_FAST_VARINT
+    if(size < 8 || sizeof (uintmax_t) != sizeof (uint64_t))
+        return 0;
+    uint64_t word;
+    std::memcpy(&word, buffer, 8);
+    /* The first byte without the continuation bit ends the varint */
+    uint64_t stops = ~word & 0x8080808080808080ULL;
+    if(stops == 0)
+        return 0;
+    size_t length = size_t(__builtin_ctzll(stops) >> 3) + 1;
+    /* Big-endian groups, moved so that the last one is in the lowest byte */
+    uint64_t groups = __builtin_bswap64(word & 0x7f7f7f7f7f7f7f7fULL) >> (64 - length*8);
+#ifdef __BMI2__
+    result = uintmax_t(_pext_u64(groups, 0x7f7f7f7f7f7f7f7fULL));
+#else
+    groups = (groups & 0x007f007f007f007fULL) | (groups & 0x7f007f007f007f00ULL) >> 1;
+    groups = (groups & 0x00003fff00003fffULL) | (groups & 0x3fff00003fff0000ULL) >> 2;
+    result = uintmax_t((groups & 0x000000000fffffffULL) | (groups & 0x0fffffff00000000ULL) >> 4);
+#endif
+    return length;
+#else
+    (void) buffer;
+    (void) size;
+    (void) result;
+    return 0;
+#endif
+}
+
+template<typename Input>
+uintmax_t JKSNDecoderPrivate::decodeInt(Input &fp, size_t size) {
+    switch(size) {
+    case 1:
+        return uintmax_t(fp.getByte());
     case 2:
         {
-            char buffer[2];
-            if(!fp.read(buffer, 2))
-                throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
+            std::string storage;
+            const char *buffer = fp.read(2, storage);
             return uintmax_t(uint8_t(buffer[0])) << 8 |
                    uintmax_t(uint8_t(buffer[1]));
         }
     case 4:
         {
-            char buffer[4];
-            if(!fp.read(buffer, 4))
-                throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
+            std::string storage;
+            const char *buffer = fp.read(4, storage);
             return uintmax_t(uint8_t(buffer[0])) << 24 |
                    uintmax_t(uint8_t(buffer[1])) << 16 |
                    uintmax_t(uint8_t(buffer[2])) << 8 |
@@ -1081,15 +2836,22 @@ uintmax_t JKSNDecoderPrivate::decodeInt(std::istream &fp, size_t size) {
         }
     case 0:
         {
-            char thisbyte;
-            uintmax_t result = 0;
+            uintmax_t result;
+            size_t available;
+            const char *buffer = fp.peek(available);
+            size_t length = decodeVarint(buffer, available, result);
+            if(length != 0) {
+                fp.skip(length);
+                return result;
+            }
+            uint8_t thisbyte;
+            result = 0;
             do {
                 if(result & ~(~ uintmax_t(0) >> 7))
                     throw JKSNDecodeError("this build of JKSN decoder does not support variable length integers");
-                if(!fp.get(thisbyte))
-                    throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
-                result = (result << 7) | (uint8_t(thisbyte) & 0x7f);
-            } while(uint8_t(thisbyte) & 0x80);
+                thisbyte = fp.getByte();
+                result = (result << 7) | (thisbyte & 0x7f);
+            } while(thisbyte & 0x80);
             return result;
         }
     default:
@@ -1098,11 +2860,11 @@ uintmax_t JKSNDecoderPrivate::decodeInt(std::istream &fp, size_t size) {
     }
 }
 
-JKSNValue JKSNDecoderPrivate::parseFloat(std::istream &fp) {
+template<typename Input>
+JKSNValue JKSNDecoderPrivate::parseFloat(Input &fp) {
     static_assert(sizeof (float) == 4, "sizeof (float) should be 4");
-    char buffer[4];
-    if(!fp.read(buffer, 4))
-        throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
+    std::string storage;
+    const char *buffer = fp.read(4, storage);
     const union {
         uint32_t data_int;
         float data_float;
@@ -1115,11 +2877,11 @@ JKSNValue JKSNDecoderPrivate::parseFloat(std::istream &fp) {
     return JKSNValue(conv.data_float);
 }
 
-JKSNValue JKSNDecoderPrivate::parseDouble(std::istream &fp) {
+template<typename Input>
+JKSNValue JKSNDecoderPrivate::parseDouble(Input &fp) {
     static_assert(sizeof (double) == 8, "sizeof (double) should be 8");
-    char buffer[8];
-    if(!fp.read(buffer, 8))
-        throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
+    std::string storage;
+    const char *buffer = fp.read(8, storage);
     const union {
         uint64_t data_int;
         double data_double;
@@ -1136,11 +2898,11 @@ JKSNValue JKSNDecoderPrivate::parseDouble(std::istream &fp) {
     return JKSNValue(conv.data_double);
 }
 
-JKSNValue JKSNDecoderPrivate::parseLongDouble(std::istream &fp) {
+template<typename Input>
+JKSNValue JKSNDecoderPrivate::parseLongDouble(Input &fp) {
     if(sizeof (long double) == 12) {
-        char buffer[10];
-        if(!fp.read(buffer, 10))
-            throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
+        std::string storage;
+        const char *buffer = fp.read(10, storage);
         union {
             uint8_t data_int[12];
             long double data_long_double;
@@ -1174,9 +2936,8 @@ JKSNValue JKSNDecoderPrivate::parseLongDouble(std::istream &fp) {
         }
         return JKSNValue(conv.data_long_double);
     } else if(sizeof (long double) == 16) {
-        char buffer[10];
-        if(!fp.read(buffer, 10))
-            throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
+        std::string storage;
+        const char *buffer = fp.read(10, storage);
         union {
             uint8_t data_int[16];
             long double data_long_double;
@@ -1221,24 +2982,1894 @@ JKSNValue JKSNDecoderPrivate::parseLongDouble(std::istream &fp) {
         throw JKSNEncodeError("this build of JKSN decoder does not support long double numbers");
 }
 
-JKSNValue JKSNDecoderPrivate::parseSwappedArray(std::istream &fp, size_t column_length) {
-    std::vector<JKSNValue> result;
-    while(column_length--) {
-        JKSNValue column_name = this->parseValue(fp);
-        JKSNValue column_values = this->parseValue(fp);
-        if(!column_values.isArray())
-            throw JKSNDecodeError("JKSN row-col swapped array requires an array but not found");
-        std::vector<JKSNValue> &column_values_vector = column_values.toVector();
-        for(size_t i = 0; i < column_values_vector.size(); ++i) {
-            if(i == result.size())
-                result.push_back(JKSNValue::fromMap(std::map<JKSNValue, JKSNValue>()));
-            if(!column_values_vector[i].isUnspecified())
-                result[i].toMap()[column_name] = std::move(column_values_vector[i]);
-        }
+
+class JKSNViewIndex {
+    /* Note: Nodes are recorded in stream order, so that the children of a container
+       immediately follow it and `next` points past its whole subtree.
+       Once the whole document is scanned, the nodes and a table of links to the
+       children of every container form the tape, which can be saved and mapped. */
+public:
+    struct Node {
+        /* Payload offset of strings, blobs and floats, value of integers and booleans,
+           or the position of the children of a container in the links of the tape */
+        uint64_t data;
+        /* Byte length of strings and blobs, element count of arrays, member count
+           of objects, or column count of row-col swapped arrays */
+        uint64_t length;
+        /* Node following the whole subtree, 0 until its end has been scanned */
+        uint64_t next;
+        uint8_t type;
+        uint8_t control;
+        /* 1 if data indexes the strings carried over from a decoder */
+        uint8_t external;
+        uint8_t reserved[5];
+    };
+    static_assert(sizeof (Node) == 32, "sizeof (JKSNViewIndex::Node) should be 32");
+    JKSNViewIndex(const char *begin, const char *end, std::shared_ptr<JKSNMappedFile> file = nullptr, const JKSNCache *seed = nullptr, const JKSNLimits &limits = JKSNLimits());
+    const Node &operator[](size_t node) {
+        if(this->tape) {
+            if(node >= this->tapesize)
+                throw JKSNDecodeError("JKSN tape does not match the document");
+            return this->tape[node];
+        }
+        this->ensureNodes(node+1);
+        return this->nodes[node];
+    }
+    size_t count(size_t node);
+    size_t child(size_t node, size_t index);
+    size_t rows(size_t node);
+    size_t elements(size_t node);
+    size_t findMember(size_t node, const std::string &key);
+    void ensureNodes(size_t count);
+    void ensureEnd(size_t node);
+    size_t reservable(size_t node, uint64_t count);
+    JKSNValue materialize(size_t node);
+    JKSNValue materializeRow(size_t node, size_t row);
+    JKSNValue materializeParallel(size_t node, unsigned threads);
+    void exportCache(JKSNCache &cache);
+    size_t consumed() const {
+        return this->input.tell();
+    }
+    void buildTape(bool sorted = true);
+    void saveTape(const std::string &path);
+    void loadTape(const char *buf, size_t size, std::shared_ptr<JKSNMappedFile> file = nullptr);
+    const char *const begin;
+    const char *const end;
+private:
+    struct Frame {
+        size_t node;
+        size_t expected;
+        size_t seen;
+        size_t trailer;
+        bool lengthless;
+    };
+    /* A run of values skipped over by a prefix, or the children of a container in it */
+    struct SkipFrame {
+        uintmax_t remaining;
+        /* Checksum size to skip once the container is closed, or that of the
+           value the prefix belongs to */
+        size_t trailer;
+        bool lengthless;
+        bool prefix;
+    };
+    /* A container being materialized, or a row of a swapped array taken as an object */
+    struct BuildFrame {
+        JKSNFrameKind kind;
+        size_t node;
+        /* The row, or ~0 if the whole node is materialized */
+        size_t row;
+        /* Next child, or twice the next column of a row, and their number */
+        size_t next;
+        size_t count;
+        JKSNArray items;
+        JKSNObject::container_type members;
+        JKSNValue key;
+        bool haskey;
+    };
+    struct TapeHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteorder;
+        uint64_t document;
+        uint64_t nodes;
+        uint64_t links;
+    };
+    struct HashEntry {
+        size_t offset;
+        size_t length;
+        uint8_t control;
+        bool external;
+    };
+    std::shared_ptr<JKSNMappedFile> file;
+    std::shared_ptr<JKSNMappedFile> tapefile;
+    JKSNBufferInput input;
+    /* Checked while the document is scanned, with the nodes charged against max_bytes */
+    JKSNLimits limits;
+    size_t used = 0;
+    std::vector<Node> nodes;
+    std::vector<Frame> stack;
+    std::unordered_map<size_t, std::vector<size_t>> children;
+    /* Rows of the swapped arrays counted before the tape is built */
+    std::unordered_map<size_t, size_t> rowcounts;
+    std::vector<uint64_t> linkstorage;
+    std::vector<std::string> externals;
+    const Node *tape = nullptr;
+    size_t tapesize = 0;
+    const uint64_t *links = nullptr;
+    size_t linksize = 0;
+    bool haslastint = false;
+    intmax_t lastint = 0;
+    std::array<HashEntry, 256> texthash;
+    std::array<HashEntry, 256> blobhash;
+    void step();
+    void closeNode(size_t node);
+    uint8_t readPrefixes(size_t &trailer);
+    void readNode(Node &node, size_t &expected, bool &lengthless);
+    static size_t checkedLength(uintmax_t length, size_t multiplier);
+    uintmax_t checkLength(uintmax_t length) const {
+        if(length > this->limits.max_length)
+            throw JKSNLimitError("JKSN stream exceeds the container length limit");
+        return length;
+    }
+    void charge(size_t bytes) {
+        if(bytes > this->limits.max_bytes - this->used)
+            throw JKSNLimitError("JKSN stream exceeds the memory limit");
+        this->used += bytes;
+    }
+    JKSNValue materialize(size_t node, size_t row);
+    BuildFrame openFrame(size_t node, size_t row);
+    bool nextTask(BuildFrame &frame, size_t &node, size_t &row);
+    JKSNValue materializeScalar(const Node &item);
+    JKSNValue assemble(size_t node, JKSNArray &&children);
+    size_t link(uint64_t position);
+    const char *payload(const Node &node);
+    std::string keyString(const Node &node);
+    int compareKey(size_t node, const std::string &key);
+    std::vector<size_t> partition(size_t node, size_t members, size_t stride, unsigned threads);
+    template<typename Func> static void runParallel(const std::vector<size_t> &bounds, Func func);
+    /* Packs arrays of numbers as JKSNDecoder does */
+    static JKSNValue packed(JKSNArray &&items) {
+        bool pack = items.size() >= JKSNValue::pack_threshold;
+        JKSNValue result(std::move(items));
+        if(pack)
+            result.pack();
+        return result;
+    }
+};
+
+JKSNViewIndex::JKSNViewIndex(const char *begin, const char *end, std::shared_ptr<JKSNMappedFile> file, const JKSNCache *seed, const JKSNLimits &limits) :
+    begin(begin),
+    end(end),
+    file(std::move(file)),
+    input(begin, end),
+    limits(limits) {
+    this->texthash.fill(HashEntry());
+    this->blobhash.fill(HashEntry());
+    if(seed) {
+        /* Strings left in the hashtable of a decoder are referred to by their place in externals */
+        this->haslastint = seed->haslastint;
+        this->lastint = seed->haslastint ? seed->lastint : 0;
+        for(size_t i = 0; i < 256; ++i) {
+            if(seed->texthash[i]) {
+                this->texthash[i] = HashEntry{this->externals.size(), seed->texthash[i].size(), 0x40, true};
+                this->externals.push_back(seed->texthash[i].toString());
+            }
+            if(seed->blobhash[i]) {
+                this->blobhash[i] = HashEntry{this->externals.size(), seed->blobhash[i].size(), 0x50, true};
+                this->externals.push_back(seed->blobhash[i].toString());
+            }
+        }
+    }
+}
+
+size_t JKSNViewIndex::count(size_t node) {
+    if(this->tape) {
+        /* Every element is a distinct node */
+        if((*this)[node].length > this->tapesize)
+            throw JKSNDecodeError("JKSN tape does not match the document");
+        return size_t(this->tape[node].length);
+    }
+    if((*this)[node].control == 0xc8)
+        this->ensureEnd(node);
+    return size_t(this->nodes[node].length);
+}
+
+size_t JKSNViewIndex::child(size_t node, size_t index) {
+    if(this->tape) {
+        /* Children always follow their parent, which also rules out cycles */
+        size_t result = this->link((*this)[node].data + index);
+        if(result <= node)
+            throw JKSNDecodeError("JKSN tape does not match the document");
+        return result;
+    }
+    std::vector<size_t> &list = this->children[node];
+    if(list.empty()) {
+        this->ensureNodes(node+2);
+        list.push_back(node+1);
+    }
+    while(list.size() <= index) {
+        size_t last = list.back();
+        this->ensureEnd(last);
+        list.push_back(size_t(this->nodes[last].next));
+    }
+    return list[index];
+}
+
+size_t JKSNViewIndex::rows(size_t node) {
+    const Node &item = (*this)[node];
+    if(this->tape)
+        /* Behind the columns and the sorted column names */
+        return this->link(item.data + item.length*2 + 1 + this->link(item.data + item.length*2));
+    std::unordered_map<size_t, size_t>::const_iterator found = this->rowcounts.find(node);
+    if(found != this->rowcounts.end())
+        return found->second;
+    /* Columns that are swapped arrays themselves are counted first, innermost
+       first as in buildTape, and kept for the rows of the arrays holding them */
+    std::vector<size_t> swapped(1, node);
+    for(size_t i = 0; i < swapped.size(); ++i) {
+        size_t columns = size_t((*this)[swapped[i]].length);
+        for(size_t column = 0; column < columns; ++column) {
+            size_t values = this->child(swapped[i], column*2+1);
+            if(((*this)[values].control & 0xf0) == 0xa0 && this->rowcounts.count(values) == 0)
+                swapped.push_back(values);
+        }
+    }
+    for(std::vector<size_t>::const_reverse_iterator it = swapped.rbegin(); it != swapped.rend(); ++it) {
+        size_t result = 0;
+        size_t columns = size_t((*this)[*it].length);
+        for(size_t column = 0; column < columns; ++column)
+            result = std::max(result, this->elements(this->child(*it, column*2+1)));
+        this->rowcounts[*it] = result;
+    }
+    return this->rowcounts[node];
+}
+
+size_t JKSNViewIndex::elements(size_t node) {
+    /* A column may itself be a row-col swapped array, whose elements are its rows */
+    if(((*this)[node].control & 0xf0) == 0xa0)
+        return this->rows(node);
+    else
+        return this->count(node);
+}
+
+size_t JKSNViewIndex::findMember(size_t node, const std::string &key) {
+    size_t members = this->count(node);
+    if(this->tape) {
+        /* Binary search over the string keys sorted by their bytes, taking the last
+           of equal keys as the decoder does */
+        const Node &item = (*this)[node];
+        uint64_t sorted = item.data + item.length*2;
+        size_t low = 0;
+        size_t high = this->link(sorted);
+        while(low < high) {
+            size_t middle = low + (high-low)/2;
+            if(this->compareKey(this->child(node, this->link(sorted+1+middle)*2), key) <= 0)
+                low = middle+1;
+            else
+                high = middle;
+        }
+        if(low != 0) {
+            size_t member = this->link(sorted+low);
+            if(this->compareKey(this->child(node, member*2), key) == 0)
+                return member;
+        }
+        return ~size_t(0);
+    }
+    size_t result = ~size_t(0);
+    for(size_t i = 0; i < members; ++i)
+        if(this->compareKey(this->child(node, i*2), key) == 0)
+            result = i;
+    return result;
+}
+
+void JKSNViewIndex::ensureNodes(size_t count) {
+    if(this->tape) {
+        if(count > this->tapesize)
+            throw JKSNDecodeError("JKSN tape does not match the document");
+        return;
+    }
+    while(this->nodes.size() < count)
+        this->step();
+}
+
+void JKSNViewIndex::ensureEnd(size_t node) {
+    this->ensureNodes(node+1);
+    if(this->tape)
+        return;
+    while(this->nodes[node].next == 0)
+        this->step();
+}
+
+size_t JKSNViewIndex::reservable(size_t node, uint64_t count) {
+    /* Counts come from the stream, so no more are reserved for than the nodes
+       indexed under node, each of which takes at least one byte of it */
+    this->ensureEnd(node);
+    const Node &item = (*this)[node];
+    size_t total = this->tape ? this->tapesize : this->nodes.size();
+    if(item.next <= node || item.next > total)
+        return 0;
+    return size_t(std::min(count, item.next - node - 1));
+}
+
+void JKSNViewIndex::step() {
+    if(!this->nodes.empty() && this->stack.empty())
+        throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
+    size_t trailer = 0;
+    uint8_t control = this->readPrefixes(trailer);
+    if(control == 0xa0 && !this->stack.empty() && this->stack.back().lengthless) {
+        Frame frame = this->stack.back();
+        this->stack.pop_back();
+        this->input.skip(trailer);
+        this->input.skip(frame.trailer);
+        this->nodes[frame.node].length = frame.seen;
+        this->closeNode(frame.node);
+        return;
+    }
+    Node node = Node();
+    node.control = control;
+    size_t expected = 0;
+    bool lengthless = false;
+    this->readNode(node, expected, lengthless);
+    if(!this->stack.empty()) {
+        const Frame &parent = this->stack.back();
+        if((this->nodes[parent.node].control & 0xf0) == 0xa0 && parent.seen % 2 == 1 && node.type != JKSN_ARRAY)
+            throw JKSNDecodeError("JKSN row-col swapped array requires an array but not found");
+    }
+    this->charge(sizeof (Node) + (node.type == JKSN_STRING || node.type == JKSN_BLOB ? size_t(node.length) : 0));
+    size_t index = this->nodes.size();
+    this->nodes.push_back(node);
+    if(lengthless || expected != 0) {
+        /* The value inside counts as a level as well, as it does in the decoder */
+        if(this->stack.size()+1 >= this->limits.max_depth)
+            throw JKSNLimitError("JKSN stream exceeds the nesting depth limit");
+        this->stack.push_back(Frame{index, expected, 0, trailer, lengthless});
+    } else {
+        if(this->limits.max_depth == 0)
+            throw JKSNLimitError("JKSN stream exceeds the nesting depth limit");
+        this->input.skip(trailer);
+        this->closeNode(index);
+    }
+}
+
+void JKSNViewIndex::closeNode(size_t node) {
+    for(;;) {
+        this->nodes[node].next = this->nodes.size();
+        if(this->stack.empty())
+            return;
+        Frame &parent = this->stack.back();
+        ++parent.seen;
+        if(parent.lengthless && parent.seen > this->limits.max_length)
+            throw JKSNLimitError("JKSN stream exceeds the container length limit");
+        if(parent.lengthless || parent.seen != parent.expected)
+            return;
+        node = parent.node;
+        this->input.skip(parent.trailer);
+        this->stack.pop_back();
+    }
+}
+
+uint8_t JKSNViewIndex::readPrefixes(size_t &trailer) {
+    /* Values skipped over may have prefixes and children of their own, so they
+       are counted down on an explicit stack, as the decoder does in skipValue */
+    std::vector<SkipFrame> skipping;
+    for(;;) {
+        uint8_t control = this->input.getByte();
+        if(control == 0x70) {
+            this->texthash.fill(HashEntry());
+            this->blobhash.fill(HashEntry());
+            continue;
+        } else if((control & 0xf0) == 0x70 || control == 0xff) {
+            uintmax_t objlen = control == 0xff ? 1 : JKSNDecoderPrivate::decodeLength(this->input, control);
+            if(objlen != 0) {
+                if(this->stack.size() + skipping.size()+1 >= this->limits.max_depth)
+                    throw JKSNLimitError("JKSN stream exceeds the nesting depth limit");
+                skipping.push_back(SkipFrame{objlen, trailer, false, true});
+                trailer = 0;
+            }
+            continue;
+        } else if(control >= 0xf0 && control <= 0xf5) {
+            this->input.skip(JKSNDecoderPrivate::checksumSize(control));
+            continue;
+        } else if(control >= 0xf8 && control <= 0xfd) {
+            trailer += JKSNDecoderPrivate::checksumSize(control);
+            continue;
+        } else if(skipping.empty())
+            return control;
+        if(control == 0xa0 && skipping.back().lengthless) {
+            this->input.skip(trailer);
+            trailer = skipping.back().trailer;
+            skipping.pop_back();
+        } else {
+            Node node = Node();
+            node.control = control;
+            size_t expected = 0;
+            bool lengthless = false;
+            this->readNode(node, expected, lengthless);
+            if(lengthless || expected != 0) {
+                if(this->stack.size() + skipping.size()+1 >= this->limits.max_depth)
+                    throw JKSNLimitError("JKSN stream exceeds the nesting depth limit");
+                skipping.push_back(SkipFrame{expected, trailer, lengthless, false});
+                trailer = 0;
+                continue;
+            }
+        }
+        /* A value has been skipped, which may in turn close the frames holding it */
+        for(;;) {
+            this->input.skip(trailer);
+            trailer = 0;
+            SkipFrame &frame = skipping.back();
+            if(frame.lengthless || --frame.remaining != 0)
+                break;
+            trailer = frame.trailer;
+            bool prefix = frame.prefix;
+            skipping.pop_back();
+            /* The prefixes of the value it was skipped for go on */
+            if(prefix)
+                break;
+        }
+    }
+}
+
+size_t JKSNViewIndex::checkedLength(uintmax_t length, size_t multiplier) {
+    if(length > ~size_t(0) / multiplier)
+        throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
+    return size_t(length) * multiplier;
+}
+
+void JKSNViewIndex::readNode(Node &node, size_t &expected, bool &lengthless) {
+    uint8_t control = node.control;
+    switch(control & 0xf0) {
+    case 0x00:
+        switch(control) {
+        case 0x00:
+            node.type = JKSN_UNDEFINED;
+            return;
+        case 0x01:
+            node.type = JKSN_NULL;
+            return;
+        case 0x02:
+        case 0x03:
+            node.type = JKSN_BOOL;
+            node.data = control & 0x1;
+            return;
+        case 0x0f:
+            throw JKSNDecodeError("this JKSN decoder does not support JSON literals");
+        }
+        break;
+    case 0x10:
+        node.type = JKSN_INT;
+        this->lastint = JKSNDecoderPrivate::decodeInteger(this->input, control);
+        node.data = uint64_t(this->lastint);
+        this->haslastint = true;
+        return;
+    case 0x20:
+        node.data = this->input.tell();
+        switch(control) {
+        case 0x20:
+        case 0x2e:
+        case 0x2f:
+            node.type = JKSN_FLOAT;
+            return;
+        case 0x2b:
+            node.type = JKSN_LONG_DOUBLE;
+            this->input.skip(10);
+            return;
+        case 0x2c:
+            node.type = JKSN_DOUBLE;
+            this->input.skip(8);
+            return;
+        case 0x2d:
+            node.type = JKSN_FLOAT;
+            this->input.skip(4);
+            return;
+        }
+        break;
+    case 0x30:
+    case 0x40:
+    case 0x50:
+        {
+            std::array<HashEntry, 256> &hashtable = (control & 0xf0) == 0x50 ? this->blobhash : this->texthash;
+            node.type = (control & 0xf0) == 0x50 ? JKSN_BLOB : JKSN_STRING;
+            if(control == 0x3c || control == 0x5c) {
+                const HashEntry &entry = hashtable[this->input.getByte()];
+                if(entry.control == 0)
+                    throw JKSNDecodeError("JKSN stream requires a non-existing hash");
+                node.control = entry.control;
+                node.external = entry.external;
+                node.data = entry.offset;
+                node.length = entry.length;
+                return;
+            }
+            uintmax_t length = JKSNDecoderPrivate::decodeLength(this->input, control);
+            if(length > this->limits.max_string / ((control & 0xf0) == 0x30 ? 2 : 1))
+                throw JKSNLimitError("JKSN stream exceeds the string length limit");
+            size_t size = checkedLength(length, (control & 0xf0) == 0x30 ? 2 : 1);
+            size_t offset = this->input.tell();
+            const char *buf = this->input.read(size);
+            node.data = offset;
+            node.length = size;
+            hashtable[DJBHash(buf, size)] = HashEntry{offset, size, control, false};
+            return;
+        }
+    case 0x80:
+        node.type = JKSN_ARRAY;
+        expected = checkedLength(this->checkLength(JKSNDecoderPrivate::decodeLength(this->input, control)), 1);
+        node.length = expected;
+        return;
+    case 0x90:
+        node.type = JKSN_OBJECT;
+        expected = checkedLength(this->checkLength(JKSNDecoderPrivate::decodeLength(this->input, control)), 2);
+        node.length = expected/2;
+        return;
+    case 0xa0:
+        if(control == 0xa0) {
+            node.type = JKSN_UNSPECIFIED;
+            return;
+        }
+        node.type = JKSN_ARRAY;
+        expected = checkedLength(this->checkLength(JKSNDecoderPrivate::decodeLength(this->input, control)), 2);
+        node.length = expected/2;
+        return;
+    case 0xc0:
+        if(control == 0xc8) {
+            node.type = JKSN_ARRAY;
+            lengthless = true;
+            return;
+        }
+        break;
+    case 0xd0:
+        {
+            intmax_t delta = JKSNDecoderPrivate::decodeDelta(this->input, control);
+            if(!this->haslastint)
+                throw JKSNDecodeError("JKSN stream contains an invalid delta encoded integer");
+            node.type = JKSN_INT;
+            this->lastint = intmax_t(uintmax_t(this->lastint) + uintmax_t(delta));
+            node.data = uint64_t(this->lastint);
+            return;
+        }
+    }
+    throw JKSNDecodeError("cannot decode unrecognizable type of value");
+}
+
+size_t JKSNViewIndex::link(uint64_t position) {
+    if(position >= this->linksize || this->links[position] >= this->tapesize)
+        throw JKSNDecodeError("JKSN tape does not match the document");
+    return size_t(this->links[position]);
+}
+
+const char *JKSNViewIndex::payload(const Node &node) {
+    if(node.external) {
+        if(node.data >= this->externals.size() || node.length != this->externals[size_t(node.data)].size())
+            throw JKSNDecodeError("JKSN tape does not match the document");
+        return this->externals[size_t(node.data)].data();
+    }
+    size_t size = size_t(this->end - this->begin);
+    if(node.data > size || node.length > size - node.data)
+        throw JKSNDecodeError("JKSN tape does not match the document");
+    return this->begin + node.data;
+}
+
+std::string JKSNViewIndex::keyString(const Node &node) {
+    if((node.control & 0xf0) == 0x30)
+        return UTF16LEToUTF8(this->payload(node), size_t(node.length/2));
+    else
+        return std::string(this->payload(node), size_t(node.length));
+}
+
+int JKSNViewIndex::compareKey(size_t node, const std::string &key) {
+    /* Non-string keys never match and sort before every string */
+    const Node &item = (*this)[node];
+    if(item.type != JKSN_STRING)
+        return -1;
+    else if((item.control & 0xf0) == 0x40) {
+        size_t length = size_t(item.length);
+        int result = std::memcmp(this->payload(item), key.data(), std::min(length, key.size()));
+        return result != 0 ? result : length < key.size() ? -1 : length > key.size() ? 1 : 0;
+    } else
+        return this->keyString(item).compare(key);
+}
+
+void JKSNViewIndex::buildTape(bool sorted) {
+    if(this->tape)
+        return;
+    this->ensureEnd(0);
+    std::vector<uint64_t> result;
+    std::vector<std::pair<std::string, uint64_t>> keys;
+    std::vector<size_t> swapped;
+    for(size_t node = 0; node < this->nodes.size(); ++node) {
+        Node &item = this->nodes[node];
+        if(item.type != JKSN_ARRAY && item.type != JKSN_OBJECT)
+            continue;
+        item.data = result.size();
+        bool keyed = item.type == JKSN_OBJECT || (item.control & 0xf0) == 0xa0;
+        uint64_t children = keyed ? item.length*2 : item.length;
+        uint64_t child = node+1;
+        for(uint64_t i = 0; i < children; ++i) {
+            result.push_back(child);
+            child = this->nodes[size_t(child)].next;
+        }
+        if(!keyed)
+            continue;
+        keys.clear();
+        for(uint64_t i = 0; sorted && i < item.length; ++i) {
+            const Node &key = this->nodes[size_t(result[size_t(item.data + i*2)])];
+            if(key.type == JKSN_STRING)
+                keys.push_back(std::make_pair(this->keyString(key), i));
+        }
+        std::stable_sort(keys.begin(), keys.end(), [](const std::pair<std::string, uint64_t> &a, const std::pair<std::string, uint64_t> &b) {
+            return a.first < b.first;
+        });
+        result.push_back(keys.size());
+        for(const std::pair<std::string, uint64_t> &key : keys)
+            result.push_back(key.second);
+        if(item.type == JKSN_ARRAY) {
+            swapped.push_back(node);
+            result.push_back(0);
+        }
+    }
+    this->linkstorage = std::move(result);
+    this->children.clear();
+    this->rowcounts.clear();
+    this->tape = this->nodes.data();
+    this->tapesize = this->nodes.size();
+    this->links = this->linkstorage.data();
+    this->linksize = this->linkstorage.size();
+    /* Row counts go last, innermost first, as a column may be a swapped array too */
+    for(std::vector<size_t>::const_reverse_iterator it = swapped.rbegin(); it != swapped.rend(); ++it) {
+        const Node &item = this->nodes[*it];
+        size_t rows = 0;
+        for(size_t column = 0; column < size_t(item.length); ++column)
+            rows = std::max(rows, this->elements(this->child(*it, column*2+1)));
+        this->linkstorage[size_t(item.data + item.length*2 + 1 + this->linkstorage[size_t(item.data + item.length*2)])] = rows;
+    }
+}
+
+void JKSNViewIndex::saveTape(const std::string &path) {
+    this->buildTape();
+    if(!this->externals.empty())
+        throw JKSNError("JKSN tape refers to strings outside the document");
+    TapeHeader header = TapeHeader();
+    std::memcpy(header.magic, "JKSNtape", 8);
+    header.version = 1;
+    header.byteorder = 0x01020304;
+    header.document = uint64_t(this->end - this->begin);
+    header.nodes = this->tapesize;
+    header.links = this->linksize;
+    size_t nodesize = this->tapesize * sizeof (Node);
+    size_t linksize = this->linksize * sizeof (uint64_t);
+    JKSNMappedFile file(path, sizeof header + nodesize + linksize);
+    std::memcpy(file.data(), &header, sizeof header);
+    std::memcpy(file.data() + sizeof header, this->tape, nodesize);
+    if(linksize != 0)
+        std::memcpy(file.data() + sizeof header + nodesize, this->links, linksize);
+}
+
+void JKSNViewIndex::loadTape(const char *buf, size_t size, std::shared_ptr<JKSNMappedFile> file) {
+    TapeHeader header;
+    if(size < sizeof header)
+        throw JKSNDecodeError("JKSN tape may be truncated or corrupted");
+    std::memcpy(&header, buf, sizeof header);
+    if(std::memcmp(header.magic, "JKSNtape", 8) || header.version != 1)
+        throw JKSNDecodeError("not a JKSN tape");
+    if(header.byteorder != 0x01020304)
+        throw JKSNDecodeError("JKSN tape was saved on a machine of another byte order");
+    if(header.document != uint64_t(this->end - this->begin))
+        throw JKSNDecodeError("JKSN tape does not match the document");
+    if(header.nodes == 0 || header.nodes > (size - sizeof header) / sizeof (Node) ||
+       header.links > (size - sizeof header - header.nodes * sizeof (Node)) / sizeof (uint64_t))
+        throw JKSNDecodeError("JKSN tape may be truncated or corrupted");
+    if(reinterpret_cast<uintptr_t>(buf) % alignof (uint64_t) != 0)
+        throw JKSNDecodeError("JKSN tape should be aligned to 8 bytes");
+    this->tapefile = std::move(file);
+    this->tape = reinterpret_cast<const Node *>(buf + sizeof header);
+    this->tapesize = size_t(header.nodes);
+    this->links = reinterpret_cast<const uint64_t *>(buf + sizeof header + this->tapesize * sizeof (Node));
+    this->linksize = size_t(header.links);
+}
+
+JKSNValue JKSNViewIndex::materialize(size_t node) {
+    return this->materialize(node, ~size_t(0));
+}
+
+JKSNValue JKSNViewIndex::materializeRow(size_t node, size_t row) {
+    return this->materialize(node, row);
+}
+
+JKSNValue JKSNViewIndex::materialize(size_t node, size_t row) {
+    /* Containers are kept on an explicit stack, as in the decoder, so that the
+       nesting depth is limited by memory, not by the call stack */
+    std::vector<BuildFrame> stack;
+    for(;;) {
+        const Node item = (*this)[node];
+        JKSNValue value;
+        bool opened = row != ~size_t(0) || item.type == JKSN_ARRAY || item.type == JKSN_OBJECT;
+        if(opened)
+            stack.push_back(this->openFrame(node, row));
+        else
+            value = this->materializeScalar(item);
+        for(;;) {
+            if(!opened) {
+                if(stack.empty())
+                    return value;
+                BuildFrame &frame = stack.back();
+                if(frame.kind == FRAME_OBJECT && !frame.haskey) {
+                    frame.key = std::move(value);
+                    frame.haskey = true;
+                } else if(frame.kind == FRAME_OBJECT) {
+                    frame.members.emplace_back(std::move(frame.key), std::move(value));
+                    frame.haskey = false;
+                } else
+                    frame.items.push_back(std::move(value));
+            }
+            opened = false;
+            BuildFrame &frame = stack.back();
+            if(this->nextTask(frame, node, row))
+                break;
+            if(frame.kind == FRAME_ARRAY)
+                value = packed(std::move(frame.items));
+            else if(frame.kind == FRAME_SWAPPED)
+                value = JKSNValue(std::move(frame.items));
+            else
+                value = JKSNValue(JKSNObject(std::move(frame.members)));
+            stack.pop_back();
+        }
+    }
+}
+
+JKSNViewIndex::BuildFrame JKSNViewIndex::openFrame(size_t node, size_t row) {
+    BuildFrame frame;
+    frame.node = node;
+    frame.row = row;
+    frame.next = 0;
+    frame.haskey = false;
+    const Node &item = (*this)[node];
+    if(row != ~size_t(0)) {
+        /* A row of a swapped array is an object of the columns that have it */
+        frame.kind = FRAME_OBJECT;
+        frame.count = this->count(node)*2;
+    } else if(item.type == JKSN_OBJECT) {
+        frame.kind = FRAME_OBJECT;
+        frame.count = this->count(node)*2;
+        frame.members.reserve(this->reservable(node, item.length));
+    } else if((item.control & 0xf0) == 0xa0) {
+        frame.kind = FRAME_SWAPPED;
+        frame.count = this->rows(node);
+        frame.items.reserve(this->reservable(node, frame.count));
+    } else {
+        frame.kind = FRAME_ARRAY;
+        frame.count = this->count(node);
+        frame.items.reserve(this->reservable(node, frame.count));
+    }
+    return frame;
+}
+
+bool JKSNViewIndex::nextTask(BuildFrame &frame, size_t &node, size_t &row) {
+    if(frame.kind == FRAME_SWAPPED) {
+        if(frame.next == frame.count)
+            return false;
+        node = frame.node;
+        row = frame.next++;
+        return true;
+    } else if(frame.row == ~size_t(0)) {
+        if(frame.next == frame.count)
+            return false;
+        node = this->child(frame.node, frame.next++);
+        row = ~size_t(0);
+        return true;
+    }
+    /* Column names are only taken for the columns with a value in this row */
+    for(; frame.next < frame.count; frame.next += 2) {
+        size_t values = this->child(frame.node, frame.next+1);
+        if(frame.row >= this->elements(values))
+            continue;
+        bool swapped = ((*this)[values].control & 0xf0) == 0xa0;
+        if(!frame.haskey) {
+            if(!swapped && (*this)[this->child(values, frame.row)].type == JKSN_UNSPECIFIED)
+                continue;
+            node = this->child(frame.node, frame.next);
+            row = ~size_t(0);
+            return true;
+        }
+        /* The value follows its name and moves on to the next column */
+        node = swapped ? values : this->child(values, frame.row);
+        row = swapped ? frame.row : ~size_t(0);
+        frame.next += 2;
+        return true;
+    }
+    return false;
+}
+
+JKSNValue JKSNViewIndex::materializeScalar(const Node &item) {
+    switch(item.type) {
+    case JKSN_UNDEFINED:
+        return JKSNValue();
+    case JKSN_NULL:
+        return JKSNValue(nullptr);
+    case JKSN_BOOL:
+        return JKSNValue(item.data != 0);
+    case JKSN_INT:
+        return JKSNValue(intmax_t(int64_t(item.data)));
+    case JKSN_FLOAT:
+    case JKSN_DOUBLE:
+    case JKSN_LONG_DOUBLE:
+        {
+            JKSNBufferInput payload(this->payload(item), this->end);
+            switch(item.control) {
+            case 0x20:
+                return JKSNValue(NAN);
+            case 0x2b:
+                return JKSNDecoderPrivate::parseLongDouble(payload);
+            case 0x2c:
+                return JKSNDecoderPrivate::parseDouble(payload);
+            case 0x2d:
+                return JKSNDecoderPrivate::parseFloat(payload);
+            case 0x2e:
+                return JKSNValue(-INFINITY);
+            default:
+                return JKSNValue(INFINITY);
+            }
+        }
+    case JKSN_STRING:
+        return JKSNValue(this->keyString(item));
+    case JKSN_BLOB:
+        return JKSNValue::fromBytes(this->payload(item), size_t(item.length), true);
+    case JKSN_UNSPECIFIED:
+        return JKSNValue::fromUnspecified();
+    default:
+        throw JKSNTypeError();
+    }
+}
+
+JKSNValue JKSNViewIndex::materializeParallel(size_t node, unsigned threads) {
+    /* Containers with too few children to share out are split child by child,
+       kept on an explicit stack as in materialize */
+    std::vector<BuildFrame> stack;
+    for(;;) {
+        const Node item = (*this)[node];
+        JKSNValue value;
+        bool opened = false;
+        if(threads <= 1 || item.next - node < JKSN_PARALLEL_GRAIN || (item.type != JKSN_ARRAY && item.type != JKSN_OBJECT))
+            value = this->materialize(node);
+        else if((item.control & 0xf0) == 0xa0) {
+            /* Rows of a swapped array are gathered from every column, so they are split evenly */
+            size_t rows = this->rows(node);
+            JKSNArray result(rows);
+            std::vector<size_t> bounds;
+            for(unsigned i = 0; i <= threads; ++i)
+                bounds.push_back(rows * i / threads);
+            runParallel(bounds, [&](size_t begin, size_t end) {
+                for(size_t i = begin; i < end; ++i)
+                    result[i] = this->materializeRow(node, i);
+            });
+            value = JKSNValue(std::move(result));
+        } else {
+            size_t stride = item.type == JKSN_OBJECT ? 2 : 1;
+            size_t members = this->count(node);
+            if(members < threads) {
+                /* Too few children to share out, so each of them is split instead */
+                stack.push_back(BuildFrame());
+                stack.back().node = node;
+                stack.back().count = members*stride;
+                opened = true;
+            } else {
+                JKSNArray children(members*stride);
+                runParallel(this->partition(node, members, stride, threads), [&](size_t begin, size_t end) {
+                    for(size_t i = begin*stride; i < end*stride; ++i)
+                        children[i] = this->materialize(this->child(node, i));
+                });
+                value = this->assemble(node, std::move(children));
+            }
+        }
+        for(;;) {
+            if(!opened) {
+                if(stack.empty())
+                    return value;
+                stack.back().items.push_back(std::move(value));
+            }
+            opened = false;
+            BuildFrame &frame = stack.back();
+            if(frame.items.size() < frame.count) {
+                node = this->child(frame.node, frame.items.size());
+                break;
+            }
+            value = this->assemble(frame.node, std::move(frame.items));
+            stack.pop_back();
+        }
+    }
+}
+
+JKSNValue JKSNViewIndex::assemble(size_t node, JKSNArray &&children) {
+    /* Children of an object alternate between keys and values */
+    if((*this)[node].type == JKSN_ARRAY)
+        return packed(std::move(children));
+    JKSNObject::container_type result;
+    result.reserve(children.size()/2);
+    for(size_t i = 0; i+1 < children.size(); i += 2)
+        result.emplace_back(std::move(children[i]), std::move(children[i+1]));
+    return JKSNValue(JKSNObject(std::move(result)));
+}
+
+std::vector<size_t> JKSNViewIndex::partition(size_t node, size_t members, size_t stride, unsigned threads) {
+    /* Members are contiguous in the tape, so the node count of a range tells its weight */
+    size_t first = node+1;
+    size_t total = size_t((*this)[node].next) - first;
+    std::vector<size_t> bounds(1, 0);
+    for(size_t i = 1; i < members && bounds.size() < threads; ++i)
+        if((this->child(node, i*stride) - first) * threads >= total * bounds.size())
+            bounds.push_back(i);
+    bounds.push_back(members);
+    return bounds;
+}
+
+template<typename Func>
+void JKSNViewIndex::runParallel(const std::vector<size_t> &bounds, Func func) {
+    /* The calling thread takes the last range */
+    std::vector<std::thread> workers;
+    std::vector<std::exception_ptr> errors(bounds.size()-1);
+    for(size_t i = 0; i+1 < bounds.size(); ++i) {
+        auto task = [&, i]() {
+            try {
+                func(bounds[i], bounds[i+1]);
+            } catch(...) {
+                errors[i] = std::current_exception();
+            }
+        };
+        if(i+2 < bounds.size())
+            workers.push_back(std::thread(task));
+        else
+            task();
+    }
+    for(std::thread &worker : workers)
+        worker.join();
+    for(const std::exception_ptr &error : errors)
+        if(error)
+            std::rethrow_exception(error);
+}
+
+void JKSNViewIndex::exportCache(JKSNCache &cache) {
+    cache.haslastint = this->haslastint;
+    cache.lastint = this->lastint;
+    for(size_t i = 0; i < 256; ++i) {
+        /* External slots were never overwritten, so the decoder still holds them */
+        const HashEntry &text = this->texthash[i];
+        if(text.control == 0)
+            cache.texthash[i].clear();
+        else if(!text.external && (text.control & 0xf0) == 0x30)
+            cache.texthash[i].assign(UTF16LEToUTF8(this->begin+text.offset, text.length/2));
+        else if(!text.external)
+            cache.texthash[i].assign(this->begin+text.offset, text.length);
+        const HashEntry &blob = this->blobhash[i];
+        if(blob.control == 0)
+            cache.blobhash[i].clear();
+        else if(!blob.external)
+            cache.blobhash[i].assign(this->begin+blob.offset, blob.length);
+    }
+}
+
+JKSNValue JKSNDecoder::parseParallel(const char *buf, size_t size, size_t *consumed, unsigned threads, bool header) {
+    size_t skipped = 0;
+    if(header && size >= 3 && !std::memcmp(buf, "jk!", 3))
+        skipped = 3;
+    JKSNViewIndex index(buf+skipped, buf+size, nullptr, &this->p->cache, this->p->limits);
+    index.buildTape(false);
+    if(threads == 0)
+        threads = std::max(std::thread::hardware_concurrency(), 1u);
+    JKSNValue result = index.materializeParallel(0, threads);
+    index.exportCache(this->p->cache);
+    if(consumed)
+        *consumed = skipped + index.consumed();
+    return result;
+}
+
+JKSNValue JKSNDecoder::parseFileParallel(const std::string &path, unsigned threads, bool header) {
+    JKSNMappedFile file(path);
+    return this->parseParallel(file.data(), file.size(), nullptr, threads, header);
+}
+
+JKSNView::JKSNView(const char *buf, size_t size, bool header) {
+    if(header && size >= 3 && !std::memcmp(buf, "jk!", 3)) {
+        buf += 3;
+        size -= 3;
+    }
+    this->index = std::make_shared<JKSNViewIndex>(buf, buf+size);
+}
+
+JKSNView::JKSNView(const char *buf, size_t size, const char *tape, size_t tape_size, bool header) :
+    JKSNView(buf, size, header) {
+    this->index->loadTape(tape, tape_size);
+}
+
+JKSNView JKSNView::fromFile(const std::string &path, bool header) {
+    std::shared_ptr<JKSNMappedFile> file = std::make_shared<JKSNMappedFile>(path);
+    const char *buf = file->data();
+    size_t size = file->size();
+    if(header && size >= 3 && !std::memcmp(buf, "jk!", 3)) {
+        buf += 3;
+        size -= 3;
+    }
+    JKSNView result;
+    result.index = std::make_shared<JKSNViewIndex>(buf, buf+size, std::move(file));
+    return result;
+}
+
+JKSNView JKSNView::fromFileWithTape(const std::string &path, const std::string &tape_path, bool header) {
+    JKSNView result = fromFile(path, header);
+    std::shared_ptr<JKSNMappedFile> tape = std::make_shared<JKSNMappedFile>(tape_path);
+    result.index->loadTape(tape->data(), tape->size(), tape);
+    return result;
+}
+
+void JKSNView::buildTape() const {
+    if(this->index)
+        this->index->buildTape();
+}
+
+void JKSNView::saveTape(const std::string &path) const {
+    if(!this->index)
+        throw JKSNTypeError();
+    this->index->saveTape(path);
+}
+
+jksn_data_type JKSNView::getType() const {
+    if(!this->index)
+        return JKSN_UNDEFINED;
+    else if(this->row != ~size_t(0))
+        return JKSN_OBJECT;
+    else
+        return jksn_data_type((*this->index)[this->node].type);
+}
+
+size_t JKSNView::size() const {
+    switch(this->getType()) {
+    case JKSN_ARRAY:
+        if(((*this->index)[this->node].control & 0xf0) == 0xa0)
+            return this->index->rows(this->node);
+        else
+            return this->index->count(this->node);
+    case JKSN_OBJECT:
+        if(this->row != ~size_t(0)) {
+            size_t result = 0;
+            for(size_t i = 0; i < this->index->count(this->node); ++i)
+                if(!this->valueAt(i).isUnspecified())
+                    ++result;
+            return result;
+        } else
+            return this->index->count(this->node);
+    default:
+        throw JKSNTypeError();
+    }
+}
+
+JKSNView JKSNView::at(size_t index) const {
+    if(!this->isArray())
+        throw JKSNTypeError();
+    else if(index >= this->size())
+        throw std::out_of_range("JKSN array index out of range");
+    else if(((*this->index)[this->node].control & 0xf0) == 0xa0)
+        return JKSNView(this->index, this->node, index);
+    else
+        return JKSNView(this->index, this->index->child(this->node, index));
+}
+
+JKSNView JKSNView::at(const std::string &key) const {
+    if(!this->isObject())
+        throw JKSNTypeError();
+    size_t member = this->findMember(key);
+    if(member == ~size_t(0))
+        throw std::out_of_range("JKSN object does not contain the key");
+    return this->valueAt(member);
+}
+
+bool JKSNView::has(const std::string &key) const {
+    if(!this->isObject())
+        throw JKSNTypeError();
+    return this->findMember(key) != ~size_t(0);
+}
+
+size_t JKSNView::findMember(const std::string &key) const {
+    size_t member = this->index->findMember(this->node, key);
+    if(member == ~size_t(0) || this->row == ~size_t(0) || !this->valueAt(member).isUnspecified())
+        return member;
+    else
+        return ~size_t(0);
+}
+
+JKSNView JKSNView::keyAt(size_t index) const {
+    if(!this->isObject())
+        throw JKSNTypeError();
+    else if(index >= this->index->count(this->node))
+        throw std::out_of_range("JKSN object index out of range");
+    return JKSNView(this->index, this->index->child(this->node, index*2));
+}
+
+JKSNView JKSNView::valueAt(size_t index) const {
+    if(!this->isObject())
+        throw JKSNTypeError();
+    else if(index >= this->index->count(this->node))
+        throw std::out_of_range("JKSN object index out of range");
+    size_t values = this->index->child(this->node, index*2+1);
+    if(this->row == ~size_t(0))
+        return JKSNView(this->index, values);
+    else if(this->row >= this->index->elements(values)) {
+        static const char unspecified = char(0xa0);
+        return JKSNView(&unspecified, 1, false);
+    } else if(((*this->index)[values].control & 0xf0) == 0xa0)
+        return JKSNView(this->index, values, this->row);
+    else
+        return JKSNView(this->index, this->index->child(values, this->row));
+}
+
+bool JKSNView::toBool() const {
+    if(this->isArray() || this->isObject())
+        return !this->empty();
+    else
+        return this->toValue().toBool();
+}
+
+intmax_t JKSNView::toInt() const {
+    if(!this->index)
+        throw JKSNTypeError();
+    else if(this->isInt())
+        return intmax_t(int64_t((*this->index)[this->node].data));
+    else
+        return this->toValue().toInt();
+}
+
+double JKSNView::toDouble() const {
+    return this->toValue().toDouble();
+}
+
+std::string JKSNView::toString() const {
+    return this->toValue().toString();
+}
+
+JKSNValue JKSNView::toValue() const {
+    if(!this->index)
+        return JKSNValue();
+    else if(this->row != ~size_t(0))
+        return this->index->materializeRow(this->node, this->row);
+    else
+        return this->index->materialize(this->node);
+}
+
+template<typename Input>
+bool JKSNReaderInput<Input>::next() {
+    this->chunk.clear();
+    if(this->instring) {
+        this->readChunk();
+        return true;
+    }
+    if(this->stack.empty()) {
+        if(this->started) {
+            this->token = JKSN_TOKEN_NONE;
+            return false;
+        }
+        this->started = true;
+    } else {
+        Frame &top = this->stack.back();
+        if(!top.lengthless && top.seen == top.expected) {
+            this->closeContainer();
+            return true;
+        }
+        if((top.token == JKSN_TOKEN_START_OBJECT || top.token == JKSN_TOKEN_START_SWAPPED_ARRAY) && top.seen % 2 == 0) {
+            this->token = top.token == JKSN_TOKEN_START_OBJECT ? JKSN_TOKEN_KEY : JKSN_TOKEN_COLUMN;
+            this->value = this->decoder->parseValue(this->input);
+            this->type = this->value.getType();
+            ++top.seen;
+            return true;
+        }
+    }
+    size_t trailer = 0;
+    uint8_t control = this->readPrefixes(trailer);
+    if(!this->stack.empty()) {
+        const Frame &top = this->stack.back();
+        if(top.lengthless && control == 0xa0) {
+            this->input.skip(trailer);
+            this->closeContainer();
+            return true;
+        }
+        if(top.token == JKSN_TOKEN_START_SWAPPED_ARRAY &&
+           (control & 0xf0) != 0x80 && ((control & 0xf0) != 0xa0 || control == 0xa0) && control != 0xc8)
+            throw JKSNDecodeError("JKSN row-col swapped array requires an array but not found");
+    }
+    switch(control & 0xf0) {
+    case 0x30:
+    case 0x40:
+    case 0x50:
+        this->startString(control, trailer);
+        return true;
+    case 0x80:
+        {
+            size_t objlen = size_t(this->decoder->decodeLength(this->input, control));
+            this->startContainer(JKSN_TOKEN_START_ARRAY, objlen, objlen, trailer);
+            return true;
+        }
+    case 0x90:
+        {
+            size_t objlen = size_t(this->decoder->decodeLength(this->input, control));
+            this->startContainer(JKSN_TOKEN_START_OBJECT, objlen, objlen*2, trailer);
+            return true;
+        }
+    case 0xa0:
+        if(control != 0xa0) {
+            size_t collen = size_t(this->decoder->decodeLength(this->input, control));
+            this->startContainer(JKSN_TOKEN_START_SWAPPED_ARRAY, collen, collen*2, trailer);
+            return true;
+        }
+        break;
+    case 0xc0:
+        if(control == 0xc8) {
+            this->startContainer(JKSN_TOKEN_START_ARRAY, ~size_t(0), 0, trailer, true);
+            return true;
+        }
+        break;
+    }
+    this->token = JKSN_TOKEN_SCALAR;
+    this->value = this->decoder->parseValue(this->input, control);
+    this->type = this->value.getType();
+    this->input.skip(trailer);
+    this->finishValue();
+    return true;
+}
+
+template<typename Input>
+void JKSNReaderInput<Input>::skip() {
+    if(this->token == JKSN_TOKEN_STRING_CHUNK) {
+        while(this->instring)
+            this->readChunk();
+        this->chunk.clear();
+    } else if(this->token == JKSN_TOKEN_START_ARRAY || this->token == JKSN_TOKEN_START_OBJECT || this->token == JKSN_TOKEN_START_SWAPPED_ARRAY) {
+        Frame &top = this->stack.back();
+        if(top.lengthless)
+            while(this->decoder->skipValue(this->input) != JKSN_UNSPECIFIED) {
+            }
+        else
+            for(; top.seen < top.expected; ++top.seen)
+                if(this->decoder->skipValue(this->input) != JKSN_ARRAY && top.token == JKSN_TOKEN_START_SWAPPED_ARRAY && top.seen % 2 == 1)
+                    throw JKSNDecodeError("JKSN row-col swapped array requires an array but not found");
+        this->closeContainer();
+    }
+}
+
+template<typename Input>
+uint8_t JKSNReaderInput<Input>::readPrefixes(size_t &trailer) {
+    for(;;) {
+        uint8_t control = this->input.getByte();
+        if(control == 0x70) {
+            this->decoder->cache.clearStrings();
+        } else if((control & 0xf0) == 0x70) {
+            size_t objlen = size_t(this->decoder->decodeLength(this->input, control));
+            while(objlen--)
+                this->decoder->skipValue(this->input);
+        } else if(control <= 0xf5 && control >= 0xf0)
+            this->input.skip(this->decoder->checksumSize(control));
+        else if(control >= 0xf8 && control <= 0xfd)
+            trailer += this->decoder->checksumSize(control);
+        else if(control == 0xff)
+            this->decoder->skipValue(this->input);
+        else
+            return control;
+    }
+}
+
+template<typename Input>
+void JKSNReaderInput<Input>::startContainer(jksn_token_type token, size_t size, size_t expected, size_t trailer, bool lengthless) {
+    this->token = token;
+    this->type = token == JKSN_TOKEN_START_OBJECT ? JKSN_OBJECT : JKSN_ARRAY;
+    this->size = size;
+    this->stack.push_back(Frame{token, expected, 0, trailer, lengthless});
+}
+
+template<typename Input>
+void JKSNReaderInput<Input>::closeContainer() {
+    Frame frame = this->stack.back();
+    this->stack.pop_back();
+    this->input.skip(frame.trailer);
+    this->token = JKSN_TOKEN_END;
+    this->type = frame.token == JKSN_TOKEN_START_OBJECT ? JKSN_OBJECT : JKSN_ARRAY;
+    this->size = frame.lengthless ? frame.seen : frame.token == JKSN_TOKEN_START_ARRAY ? frame.expected : frame.expected/2;
+    this->finishValue();
+}
+
+template<typename Input>
+void JKSNReaderInput<Input>::startString(uint8_t control, size_t trailer) {
+    this->token = JKSN_TOKEN_STRING_CHUNK;
+    this->type = (control & 0xf0) == 0x50 ? JKSN_BLOB : JKSN_STRING;
+    if(control == 0x3c || control == 0x5c) {
+        const JKSNCacheEntry &entry = (control == 0x3c ? this->decoder->cache.texthash : this->decoder->cache.blobhash)[this->input.getByte()];
+        if(!entry)
+            throw JKSNDecodeError("JKSN stream requires a non-existing hash");
+        this->chunk.assign(entry.data(), entry.size());
+        this->size = this->chunk.size();
+        this->lastchunk = true;
+        this->input.skip(trailer);
+        this->finishValue();
+        return;
+    }
+    uintmax_t strsize = this->decoder->decodeLength(this->input, control);
+    if((control & 0xf0) == 0x30 && strsize > ~size_t(0)/2)
+        throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
+    this->size = size_t(strsize);
+    this->instring = true;
+    this->strcontrol = control;
+    this->strhash = 0;
+    this->strremain = (control & 0xf0) == 0x30 ? size_t(strsize)*2 : size_t(strsize);
+    this->strtrailer = trailer;
+    this->strtext.clear();
+    this->strcarry.clear();
+    this->readChunk();
+}
+
+template<typename Input>
+void JKSNReaderInput<Input>::readChunk() {
+    size_t length = std::min(this->strremain, size_t(chunk_size));
+    std::string storage;
+    const char *buf = this->input.read(length, storage);
+    this->strremain -= length;
+    this->strhash = DJBHash(buf, length, this->strhash);
+    if((this->strcontrol & 0xf0) == 0x30) {
+        /* A surrogate pair split between chunks is held back until the next one */
+        std::string units = std::move(this->strcarry);
+        units.append(buf, length);
+        this->strcarry.clear();
+        size_t unitcount = units.size()/2;
+        if(this->strremain != 0 && unitcount != 0 && (uint8_t(units[unitcount*2-1]) & 0xfc) == 0xd8) {
+            this->strcarry = units.substr(unitcount*2-2);
+            --unitcount;
+        }
+        this->chunk = UTF16LEToUTF8(units.data(), unitcount);
+    } else
+        this->chunk.assign(buf, length);
+    /* The whole string is kept for the hashtable, as later references may need it */
+    this->strtext += this->chunk;
+    this->lastchunk = this->strremain == 0;
+    if(this->lastchunk) {
+        std::array<JKSNCacheEntry, 256> &hashtable = (this->strcontrol & 0xf0) == 0x50 ? this->decoder->cache.blobhash : this->decoder->cache.texthash;
+        hashtable[this->strhash].assign(std::move(this->strtext));
+        this->strtext.clear();
+        this->instring = false;
+        this->input.skip(this->strtrailer);
+        this->finishValue();
+    }
+}
+
+template<typename Input>
+void JKSNReaderInput<Input>::finishValue() {
+    if(!this->stack.empty())
+        ++this->stack.back().seen;
+}
+
+JKSNReader::JKSNReader(std::istream &fp, bool header) {
+    if(header)
+        skipHeader(fp);
+    this->p = new JKSNReaderInput<JKSNStreamInput>(nullptr, fp);
+}
+
+JKSNReader::JKSNReader(const char *buf, size_t size, bool header) {
+    if(header && size >= 3 && !std::memcmp(buf, "jk!", 3)) {
+        buf += 3;
+        size -= 3;
+    }
+    this->p = new JKSNReaderInput<JKSNBufferInput>(nullptr, buf, buf+size);
+}
+
+JKSNReader::JKSNReader(JKSNDecoder &decoder, std::istream &fp, bool header) {
+    if(header)
+        skipHeader(fp);
+    this->p = new JKSNReaderInput<JKSNStreamInput>(decoder.p, fp);
+}
+
+JKSNReader::JKSNReader(JKSNDecoder &decoder, const char *buf, size_t size, bool header) {
+    if(header && size >= 3 && !std::memcmp(buf, "jk!", 3)) {
+        buf += 3;
+        size -= 3;
+    }
+    this->p = new JKSNReaderInput<JKSNBufferInput>(decoder.p, buf, buf+size);
+}
+
+JKSNReader::JKSNReader(JKSNReader &&that) :
+    p(that.p) {
+    that.p = nullptr;
+}
+
+JKSNReader &JKSNReader::operator=(JKSNReader &&that) {
+    if(this != &that) {
+        delete this->p;
+        this->p = that.p;
+        that.p = nullptr;
+    }
+    return *this;
+}
+
+JKSNReader::~JKSNReader() {
+    delete this->p;
+}
+
+bool JKSNReader::next() {
+    return this->p->next();
+}
+
+jksn_token_type JKSNReader::getToken() const {
+    return this->p->token;
+}
+
+jksn_data_type JKSNReader::getType() const {
+    return this->p->type;
+}
+
+size_t JKSNReader::size() const {
+    return this->p->size;
+}
+
+size_t JKSNReader::depth() const {
+    return this->p->token == JKSN_TOKEN_START_ARRAY || this->p->token == JKSN_TOKEN_START_OBJECT || this->p->token == JKSN_TOKEN_START_SWAPPED_ARRAY ?
+        this->p->stack.size()-1 : this->p->stack.size();
+}
+
+const JKSNValue &JKSNReader::getValue() const {
+    return this->p->value;
+}
+
+const std::string &JKSNReader::getChunk() const {
+    return this->p->chunk;
+}
+
+bool JKSNReader::isLastChunk() const {
+    return this->p->lastchunk;
+}
+
+void JKSNReader::skip() {
+    this->p->skip();
+}
+
+class JKSNFeedInput {
+    /* Note: Reads the bytes received so far, and throws NeedMore instead of
+       JKSNDecodeError when they run out, so that the token can be retried */
+public:
+    struct NeedMore {
+    };
+    static const bool contiguous = false;
+    JKSNFeedInput(const char *begin, const char *end) :
+        begin(begin),
+        ptr(begin),
+        end(end) {
+    }
+    uint8_t getByte() {
+        if(this->ptr == this->end)
+            throw NeedMore();
+        return uint8_t(*this->ptr++);
+    }
+    const char *read(size_t size, std::string &) {
+        if(size_t(this->end - this->ptr) < size)
+            throw NeedMore();
+        const char *result = this->ptr;
+        this->ptr += size;
+        return result;
+    }
+    void skip(size_t size) {
+        std::string storage;
+        this->read(size, storage);
+    }
+    size_t tell() const {
+        return size_t(this->ptr - this->begin);
+    }
+    size_t remaining() const {
+        return size_t(this->end - this->ptr);
+    }
+    const char *peek(size_t &size) const {
+        size = this->remaining();
+        return this->ptr;
+    }
+    /* Capped, as the items may never arrive */
+    size_t reservable(size_t count) const {
+        return std::min(count, size_t(65536));
+    }
+private:
+    const char *begin;
+    const char *ptr;
+    const char *end;
+};
+
+class JKSNPushDecoderPrivate {
+    /* Note: Every step consumes one whole token or nothing at all. Containers are
+       kept on an explicit stack instead of the call stack of parseValue. */
+public:
+    JKSNPushDecoderPrivate(JKSNDecoderPrivate *decoder, bool header) :
+        owned(decoder ? nullptr : new JKSNDecoderPrivate),
+        decoder(decoder ? decoder : owned.get()),
+        header(header) {
+    }
+    void feed(const char *buf, size_t size);
+    std::unique_ptr<JKSNDecoderPrivate> owned;
+    JKSNDecoderPrivate *decoder;
+    bool header;
+    /* Whether part of the next value, such as its header or a pragma, has been consumed */
+    bool started = false;
+    std::string buffer;
+    size_t pos = 0;
+    std::vector<JKSNFrame> stack;
+    std::deque<JKSNValue> values;
+private:
+    bool step();
+    void push(JKSNFrameKind kind, size_t remaining, size_t reserve = 0);
+    void complete(JKSNValue &&value);
+};
+
+void JKSNPushDecoderPrivate::feed(const char *buf, size_t size) {
+    /* Consumed bytes are dropped once they outnumber the rest, which keeps feeding linear */
+    if(this->pos != 0 && this->pos >= this->buffer.size()-this->pos) {
+        this->buffer.erase(0, this->pos);
+        this->pos = 0;
+    }
+    this->buffer.append(buf, size);
+    for(;;) {
+        size_t count = this->values.size();
+        if(!this->step())
+            break;
+        if(this->values.size() == count)
+            this->started = true;
+    }
+}
+
+bool JKSNPushDecoderPrivate::step() {
+    JKSNFeedInput fp(this->buffer.data()+this->pos, this->buffer.data()+this->buffer.size());
+    try {
+        if(!this->stack.empty() && this->stack.back().kind == FRAME_TRAILER && this->stack.back().haskey) {
+            fp.skip(this->stack.back().remaining);
+            this->pos += fp.tell();
+            JKSNValue result = std::move(this->stack.back().key);
+            this->stack.pop_back();
+            this->complete(std::move(result));
+            return true;
+        }
+        if(this->header && this->stack.empty() && !this->started && this->pos != this->buffer.size() && this->buffer[this->pos] == 'j') {
+            std::string storage;
+            if(!std::memcmp(fp.read(3, storage), "jk!", 3)) {
+                this->pos += 3;
+                return true;
+            }
+            fp = JKSNFeedInput(this->buffer.data()+this->pos, this->buffer.data()+this->buffer.size());
+        }
+        uint8_t control = fp.getByte();
+        if(this->stack.size() >= this->decoder->limits.max_depth)
+            throw JKSNLimitError("JKSN stream exceeds the nesting depth limit");
+        switch(control & 0xf0) {
+        case 0x00:
+            switch(control) {
+            case 0x00:
+                this->pos += fp.tell();
+                this->complete(JKSNValue());
+                return true;
+            case 0x01:
+                this->pos += fp.tell();
+                this->complete(JKSNValue(nullptr));
+                return true;
+            case 0x02:
+            case 0x03:
+                this->pos += fp.tell();
+                this->complete(JKSNValue(control == 0x03));
+                return true;
+            case 0x0f:
+                throw JKSNDecodeError("this JKSN decoder does not support JSON literals");
+            }
+            break;
+        case 0x10:
+            {
+                intmax_t result = this->decoder->decodeInteger(fp, control);
+                this->pos += fp.tell();
+                this->decoder->cache.lastint = result;
+                this->decoder->cache.haslastint = true;
+                this->complete(JKSNValue(result));
+                return true;
+            }
+        case 0x20:
+            {
+                JKSNValue result;
+                switch(control) {
+                case 0x20:
+                    result = JKSNValue(NAN);
+                    break;
+                case 0x2b:
+                    result = this->decoder->parseLongDouble(fp);
+                    break;
+                case 0x2c:
+                    result = this->decoder->parseDouble(fp);
+                    break;
+                case 0x2d:
+                    result = this->decoder->parseFloat(fp);
+                    break;
+                case 0x2e:
+                    result = JKSNValue(-INFINITY);
+                    break;
+                case 0x2f:
+                    result = JKSNValue(INFINITY);
+                    break;
+                default:
+                    throw JKSNDecodeError("cannot encode unrecognizable type of value");
+                }
+                this->pos += fp.tell();
+                this->complete(std::move(result));
+                return true;
+            }
+        case 0x30:
+        case 0x40:
+        case 0x50:
+            {
+                bool is_blob = (control & 0xf0) == 0x50;
+                std::array<JKSNCacheEntry, 256> &hashtable = is_blob ? this->decoder->cache.blobhash : this->decoder->cache.texthash;
+                if(control == 0x3c || control == 0x5c) {
+                    const JKSNCacheEntry &entry = hashtable[fp.getByte()];
+                    if(!entry)
+                        throw JKSNDecodeError("JKSN stream requires a non-existing hash");
+                    this->pos += fp.tell();
+                    this->decoder->charge(entry.size());
+                    this->complete(JKSNValue::fromBytes(entry.data(), entry.size(), is_blob));
+                    return true;
+                }
+                bool is_utf16 = (control & 0xf0) == 0x30;
+                /* Checked before waiting for the bytes, which would otherwise be buffered */
+                size_t strsize = this->decoder->checkStringSize(this->decoder->decodeLength(fp, control), is_utf16 ? 2 : 1);
+                /* Lengths beyond what could still arrive are left for the next feed */
+                if(strsize > fp.remaining() / (is_utf16 ? 2 : 1))
+                    throw JKSNFeedInput::NeedMore();
+                std::string storage;
+                size_t bytesize = is_utf16 ? strsize*2 : strsize;
+                const char *str = fp.read(bytesize, storage);
+                this->pos += fp.tell();
+                this->decoder->charge(bytesize);
+                JKSNCacheEntry &entry = hashtable[DJBHash(str, bytesize)];
+                std::string result = is_utf16 ? UTF16LEToUTF8(str, strsize) : std::string(str, bytesize);
+                entry.assign(result.data(), result.size());
+                this->complete(JKSNValue(std::move(result), is_blob));
+                return true;
+            }
+        case 0x70:
+            if(control == 0x70) {
+                this->pos += fp.tell();
+                this->decoder->cache.clearStrings();
+            } else {
+                size_t objlen = this->decoder->checkLength(this->decoder->decodeLength(fp, control));
+                this->pos += fp.tell();
+                if(objlen != 0)
+                    this->push(FRAME_DISCARD, objlen);
+            }
+            return true;
+        case 0x80:
+            {
+                size_t objlen = this->decoder->checkLength(this->decoder->decodeLength(fp, control));
+                this->pos += fp.tell();
+                if(objlen == 0)
+                    this->complete(JKSNValue(JKSNArray()));
+                else
+                    this->push(FRAME_ARRAY, objlen, this->decoder->reservable(fp, objlen));
+                return true;
+            }
+        case 0x90:
+            {
+                size_t objlen = this->decoder->checkLength(this->decoder->decodeLength(fp, control));
+                this->pos += fp.tell();
+                if(objlen == 0)
+                    this->complete(JKSNValue(JKSNObject()));
+                else
+                    this->push(FRAME_OBJECT, objlen, this->decoder->reservable(fp, objlen));
+                return true;
+            }
+        case 0xa0:
+            {
+                if(control == 0xa0) {
+                    this->pos += fp.tell();
+                    this->complete(JKSNValue::fromUnspecified());
+                    return true;
+                }
+                size_t collen = this->decoder->checkLength(this->decoder->decodeLength(fp, control));
+                this->pos += fp.tell();
+                if(collen == 0)
+                    this->complete(JKSNValue(JKSNArray()));
+                else
+                    this->push(FRAME_SWAPPED, collen);
+                return true;
+            }
+        case 0xc0:
+            if(control == 0xc8) {
+                this->pos += fp.tell();
+                this->push(FRAME_LENGTHLESS, 0);
+                return true;
+            }
+            break;
+        case 0xd0:
+            {
+                intmax_t delta = this->decoder->decodeDelta(fp, control);
+                if(!this->decoder->cache.haslastint)
+                    throw JKSNDecodeError("JKSN stream contains an invalid delta encoded integer");
+                this->pos += fp.tell();
+                this->decoder->cache.lastint = intmax_t(uintmax_t(this->decoder->cache.lastint) + uintmax_t(delta));
+                this->complete(JKSNValue(this->decoder->cache.lastint));
+                return true;
+            }
+        case 0xf0:
+            if(control <= 0xf5) {
+                fp.skip(this->decoder->checksumSize(control));
+                this->pos += fp.tell();
+                return true;
+            } else if(control >= 0xf8 && control <= 0xfd) {
+                this->pos += fp.tell();
+                this->push(FRAME_TRAILER, this->decoder->checksumSize(control));
+                return true;
+            } else if(control == 0xff) {
+                this->pos += fp.tell();
+                this->push(FRAME_DISCARD, 1);
+                return true;
+            }
+        }
+        throw JKSNDecodeError("cannot encode unrecognizable type of value");
+    } catch(JKSNFeedInput::NeedMore &) {
+        return false;
+    }
+}
+
+void JKSNPushDecoderPrivate::push(JKSNFrameKind kind, size_t remaining, size_t reserve) {
+    this->decoder->charge(sizeof (JKSNValue));
+    this->decoder->openFrame(this->stack, kind, remaining, reserve);
+}
+
+void JKSNPushDecoderPrivate::complete(JKSNValue &&value) {
+    this->decoder->charge(sizeof (JKSNValue));
+    if(this->decoder->closeFrames(this->stack, value)) {
+        this->values.push_back(std::move(value));
+        this->started = false;
+        /* The memory limit applies to each value separately */
+        this->decoder->used = 0;
+    }
+}
+
+JKSNPushDecoder::JKSNPushDecoder(bool header) :
+    p(new JKSNPushDecoderPrivate(nullptr, header)) {
+}
+
+JKSNPushDecoder::JKSNPushDecoder(JKSNDecoder &decoder, bool header) :
+    p(new JKSNPushDecoderPrivate(decoder.p, header)) {
+}
+
+JKSNPushDecoder::JKSNPushDecoder(JKSNPushDecoder &&that) :
+    p(that.p) {
+    that.p = nullptr;
+}
+
+JKSNPushDecoder &JKSNPushDecoder::operator=(JKSNPushDecoder &&that) {
+    if(this != &that) {
+        delete this->p;
+        this->p = that.p;
+        that.p = nullptr;
+    }
+    return *this;
+}
+
+JKSNPushDecoder::~JKSNPushDecoder() {
+    delete this->p;
+}
+
+size_t JKSNPushDecoder::feed(const char *buf, size_t size) {
+    this->p->feed(buf, size);
+    return this->p->values.size();
+}
+
+size_t JKSNPushDecoder::available() const {
+    return this->p->values.size();
+}
+
+JKSNValue JKSNPushDecoder::pop() {
+    if(this->p->values.empty())
+        throw JKSNError("no JKSN value has been completely received");
+    JKSNValue result = std::move(this->p->values.front());
+    this->p->values.pop_front();
+    return result;
+}
+
+bool JKSNPushDecoder::pending() const {
+    return this->p->pos != this->p->buffer.size() || !this->p->stack.empty() || this->p->started;
+}
+
+#ifdef JKSN_HAVE_MMAP
+
+static int reserveFile(int fd, size_t size) {
+    /* Writes to a mapping past the space the filesystem can give raise SIGBUS,
+       so a full disk or quota has to be found here, as an error number */
+#ifdef JKSN_HAVE_FALLOCATE
+    int error = posix_fallocate(fd, 0, off_t(size));
+    if(error != EINVAL && error != EOPNOTSUPP)
+        return error;
+#endif
+    /* Otherwise every block is written out once */
+    static const char zeros[65536] = {};
+    size_t done = 0;
+    while(done < size) {
+        ssize_t written = pwrite(fd, zeros, std::min(size-done, sizeof zeros), off_t(done));
+        if(written == -1 && errno != EINTR)
+            return errno;
+        else if(written == 0)
+            return EIO;
+        else if(written > 0)
+            done += size_t(written);
+    }
+    return 0;
+}
+
+JKSNMappedFile::JKSNMappedFile(const std::string &path) {
+    this->fd = open(path.c_str(), O_RDONLY);
+    if(this->fd == -1)
+        throw JKSNError("cannot open JKSN file for reading");
+    struct stat st;
+    if(fstat(this->fd, &st) == -1) {
+        close(this->fd);
+        throw JKSNError("cannot open JKSN file for reading");
+    }
+    this->buf_size = size_t(st.st_size);
+    if(this->buf_size != 0) {
+        void *mapping = mmap(nullptr, this->buf_size, PROT_READ, MAP_PRIVATE, this->fd, 0);
+        if(mapping == MAP_FAILED) {
+            close(this->fd);
+            throw JKSNError("cannot map JKSN file into memory");
+        }
+        this->buf = static_cast<char *>(mapping);
+        madvise(mapping, this->buf_size, MADV_SEQUENTIAL);
+    }
+}
+
+JKSNMappedFile::JKSNMappedFile(const std::string &path, size_t size) {
+    this->fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if(this->fd == -1)
+        throw JKSNError("cannot open JKSN file for writing");
+    if(reserveFile(this->fd, size) != 0) {
+        close(this->fd);
+        throw JKSNError("cannot allocate space for JKSN file");
+    }
+    this->buf_size = size;
+    if(this->buf_size != 0) {
+        void *mapping = mmap(nullptr, this->buf_size, PROT_READ | PROT_WRITE, MAP_SHARED, this->fd, 0);
+        if(mapping == MAP_FAILED) {
+            close(this->fd);
+            throw JKSNError("cannot map JKSN file into memory");
+        }
+        this->buf = static_cast<char *>(mapping);
+        madvise(mapping, this->buf_size, MADV_SEQUENTIAL);
+    }
+}
+
+JKSNMappedFile::~JKSNMappedFile() {
+    if(this->buf)
+        munmap(this->buf, this->buf_size);
+    close(this->fd);
+}
+
+#else
+
+JKSNMappedFile::JKSNMappedFile(const std::string &path) {
+    std::ifstream stream(path, std::ios::in | std::ios::binary);
+    if(!stream)
+        throw JKSNError("cannot open JKSN file for reading");
+    std::ostringstream content;
+    content << stream.rdbuf();
+    this->fallback = content.str();
+    this->buf = &this->fallback[0];
+    this->buf_size = this->fallback.size();
+}
+
+JKSNMappedFile::JKSNMappedFile(const std::string &path, size_t size) :
+    path(path),
+    fallback(size, '\0'),
+    writable(true) {
+    this->buf = &this->fallback[0];
+    this->buf_size = size;
+}
+
+JKSNMappedFile::~JKSNMappedFile() {
+    if(this->writable) {
+        std::ofstream stream(this->path, std::ios::out | std::ios::binary | std::ios::trunc);
+        stream.write(this->fallback.data(), std::streamsize(this->fallback.size()));
     }
-    return JKSNValue(std::move(result));
 }
 
+#endif
 
 static inline bool isLittleEndian() {
     static const union {
@@ -1319,29 +4950,31 @@ static std::string UTF8ToUTF16LE(const std::string &utf8str, bool strict) {
     return utf16str;
 }
 
-static std::string UTF16ToUTF8(const std::u16string &utf16str) {
+template<typename UnitAt>
+static std::string UTF16UnitsToUTF8(UnitAt unit_at, size_t length) {
     std::string utf8str;
     size_t i = 0;
-    utf8str.reserve(utf16str.size()*2);
-    while(i < utf16str.size()) {
-        if(uint16_t(utf16str[i]) < 0x80) {
-            utf8str.push_back(char(utf16str[i]));
+    utf8str.reserve(length*2);
+    while(i < length) {
+        uint16_t thisunit = unit_at(i);
+        if(thisunit < 0x80) {
+            utf8str.push_back(char(thisunit));
             ++i;
-        } else if(uint16_t(utf16str[i]) < 0x800) {
+        } else if(thisunit < 0x800) {
             utf8str.append({
-                char(uint16_t(utf16str[i]) >> 6 | 0xc0),
-                char((uint16_t(utf16str[i]) & 0x3f) | 0x80)
+                char(thisunit >> 6 | 0xc0),
+                char((thisunit & 0x3f) | 0x80)
             });
             ++i;
-        } else if((uint16_t(utf16str[i]) & 0xf800) != 0xd800) {
+        } else if((thisunit & 0xf800) != 0xd800) {
                 utf8str.append({
-                    char(uint16_t(utf16str[i]) >> 12 | 0xe0),
-                    char(((uint16_t(utf16str[i]) >> 6) & 0x3f) | 0x80),
-                    char((uint16_t(utf16str[i]) & 0x3f) | 0x80)
+                    char(thisunit >> 12 | 0xe0),
+                    char(((thisunit >> 6) & 0x3f) | 0x80),
+                    char((thisunit & 0x3f) | 0x80)
                 });
                 ++i;
-        } else if(i+1 < utf16str.size() && uint32_t(utf16str[i] & 0xfc00) == 0xd800 && uint32_t(utf16str[i+1] & 0xfc00) == 0xdc00) {
-            uint32_t ucs4 = uint32_t((utf16str[i] & 0x3ff) << 10 | (utf16str[i+1] & 0x3ff)) + 0x10000;
+        } else if(i+1 < length && (thisunit & 0xfc00) == 0xd800 && (unit_at(i+1) & 0xfc00) == 0xdc00) {
+            uint32_t ucs4 = (uint32_t(thisunit & 0x3ff) << 10 | uint32_t(unit_at(i+1) & 0x3ff)) + 0x10000;
             utf8str.append({
                 char(ucs4 >> 18 | 0xf0),
                 char(((ucs4 >> 12) & 0x3f) | 0x80),
@@ -1358,11 +4991,40 @@ static std::string UTF16ToUTF8(const std::u16string &utf16str) {
     return utf8str;
 }
 
+static inline std::string UTF16ToUTF8(const std::u16string &utf16str) {
+    return UTF16UnitsToUTF8([&utf16str](size_t i) {
+        return uint16_t(utf16str[i]);
+    }, utf16str.size());
+}
+
+static std::string UTF16LEToUTF8(const char *utf16le, size_t length) {
+    return UTF16UnitsToUTF8([utf16le](size_t i) {
+        return uint16_t(uint8_t(utf16le[i*2]) | uint16_t(uint8_t(utf16le[i*2+1])) << 8);
+    }, length);
+}
+
+static void skipHeader(std::istream &fp) {
+    char header_buf[3];
+    if(!fp.read(header_buf, 3) || fp.gcount() != 3 || std::memcmp(header_buf, "jk!", 3))
+        fp.seekg(-fp.gcount(), fp.cur);
+}
+
 static uint8_t DJBHash(const std::string &buf, uint8_t iv) {
+    return DJBHash(buf.data(), buf.size(), iv);
+}
+
+static uint8_t DJBHash(const char *buf, size_t size, uint8_t iv) {
     unsigned int result = iv;
-    for(char i : buf)
-        result += (result << 5) + uint8_t(i);
-    return result;
+    for(size_t i = 0; i < size; ++i)
+        result += (result << 5) + uint8_t(buf[i]);
+    return uint8_t(result);
+}
+
+static size_t FNVHash(const char *buf, size_t size) {
+    uint64_t result = 14695981039346656037ULL;
+    for(size_t i = 0; i < size; ++i)
+        result = (result ^ uint8_t(buf[i])) * 1099511628211ULL;
+    return size_t(result ^ (result >> 32));
 }
 
 bool JKSNValue::toBool() const {
@@ -1379,14 +5041,14 @@ bool JKSNValue::toBool() const {
     case JKSN_DOUBLE:
         return this->data_double != 0.0;
     case JKSN_LONG_DOUBLE:
-        return this->data_long_double != 0.0L;
+        return *this->data_long_double != 0.0L;
     case JKSN_STRING:
     case JKSN_BLOB:
-        return !this->data_string->empty();
+        return this->stringSize() != 0;
     case JKSN_ARRAY:
-        return !this->data_array->empty();
+        return this->isPacked() ? !this->data_numbers->data.empty() : !this->data_array->data.empty();
     case JKSN_OBJECT:
-        return !this->data_object->empty();
+        return !this->data_object->data.empty();
     default:
         throw JKSNTypeError();
     }
@@ -1403,12 +5065,12 @@ intmax_t JKSNValue::toInt() const {
     case JKSN_DOUBLE:
         return this->data_double;
     case JKSN_LONG_DOUBLE:
-        return this->data_long_double;
+        return *this->data_long_double;
     case JKSN_NULL:
         return 0;
     case JKSN_STRING:
         try {
-            return std::stoll(*this->data_string);
+            return std::stoll(this->toString());
         } catch(std::invalid_argument) {
             throw JKSNTypeError();
         } catch(std::out_of_range) {
@@ -1427,7 +5089,7 @@ T JKSNValue::toNumber() const {
     case JKSN_DOUBLE:
         return this->data_double;
     case JKSN_LONG_DOUBLE:
-        return this->data_long_double;
+        return *this->data_long_double;
     case JKSN_INT:
         return this->data_int;
     case JKSN_BOOL:
@@ -1436,7 +5098,7 @@ T JKSNValue::toNumber() const {
         return 0;
     case JKSN_STRING:
         try {
-            return std::stoll(*this->data_string);
+            return std::stoll(this->toString());
         } catch(std::invalid_argument) {
             return NAN;
         } catch(std::out_of_range) {
@@ -1472,20 +5134,29 @@ std::string JKSNValue::toString() const {
         else
             return std::to_string(this->data_double);
     case JKSN_LONG_DOUBLE:
-        if(std::isnan(this->data_long_double))
+        if(std::isnan(*this->data_long_double))
             return "NaN";
-        else if(std::isinf(this->data_long_double))
-            return this->data_long_double >= 0 ? "Infinity" : "-Infinity";
+        else if(std::isinf(*this->data_long_double))
+            return *this->data_long_double >= 0 ? "Infinity" : "-Infinity";
         else
-            return std::to_string(this->data_long_double);
+            return std::to_string(*this->data_long_double);
     case JKSN_STRING:
     case JKSN_BLOB:
-        return *this->data_string;
+        return std::string(this->stringData(), this->stringSize());
     case JKSN_ARRAY:
         {
             std::string res;
+            if(this->isPacked()) {
+                const JKSNNumberArray &numbers = this->data_numbers->data;
+                for(size_t i = 0; i < numbers.size(); ++i) {
+                    if(i != 0)
+                        res.append(1, ',');
+                    res.append(numbers[i].toString());
+                }
+                return res;
+            }
             bool first = true;
-            for(const JKSNValue &i : *this->data_array) {
+            for(const JKSNValue &i : this->data_array->data) {
                 if(!first)
                     res.append(1, ',');
                 first = false;
@@ -1500,6 +5171,60 @@ std::string JKSNValue::toString() const {
     }
 }
 
+static std::vector<JKSNObject::const_iterator> sortedMembers(const JKSNObject &obj) {
+    std::vector<JKSNObject::const_iterator> result;
+    result.reserve(obj.size());
+    for(JKSNObject::const_iterator it = obj.cbegin(); it != obj.cend(); ++it)
+        result.push_back(it);
+    std::sort(result.begin(), result.end(), [](const JKSNObject::const_iterator &a, const JKSNObject::const_iterator &b) {
+        return a->first < b->first;
+    });
+    return result;
+}
+
+/* Elements of an array by value, as a packed array has no JKSNValue to refer to */
+static size_t arraySize(const JKSNValue &array) {
+    return array.isPacked() ? array.toNumbers().size() : array.toVector().size();
+}
+
+static JKSNValue arrayElement(const JKSNValue &array, size_t index) {
+    return array.isPacked() ? array.toNumbers()[index] : array.toVector()[index];
+}
+
+/* For arrays of which at least one is packed, without building a JKSNArray of either */
+static bool packedEquals(const JKSNValue &a, const JKSNValue &b) {
+    if(a.isPacked() && b.isPacked() && a.toNumbers().elementType() == b.toNumbers().elementType())
+        switch(a.toNumbers().elementType()) {
+        case JKSN_INT:
+            return a.toNumbers().toInts() == b.toNumbers().toInts();
+        case JKSN_FLOAT:
+            return a.toNumbers().toFloats() == b.toNumbers().toFloats();
+        default:
+            return a.toNumbers().toDoubles() == b.toNumbers().toDoubles();
+        }
+    size_t size = arraySize(a);
+    if(size != arraySize(b))
+        return false;
+    for(size_t i = 0; i < size; ++i)
+        if(arrayElement(a, i) != arrayElement(b, i))
+            return false;
+    return true;
+}
+
+static bool packedLess(const JKSNValue &a, const JKSNValue &b) {
+    size_t a_size = arraySize(a);
+    size_t b_size = arraySize(b);
+    for(size_t i = 0; i < a_size && i < b_size; ++i) {
+        JKSNValue a_item = arrayElement(a, i);
+        JKSNValue b_item = arrayElement(b, i);
+        if(a_item < b_item)
+            return true;
+        else if(a_item != b_item) /* > */
+            return false;
+    }
+    return a_size < b_size;
+}
+
 bool JKSNValue::operator==(const JKSNValue &that) const {
     jksn_data_type this_type = this->getType();
     jksn_data_type that_type = that.getType();
@@ -1559,11 +5284,21 @@ bool JKSNValue::operator==(const JKSNValue &that) const {
             }
         case JKSN_STRING:
         case JKSN_BLOB:
-            return this->toString() == that.toString();
+            /* Keys interned by one decoder share their bytes, and those by
+               different decoders are still told apart by their hash first */
+            if(this->data_storage == STORAGE_INTERNED && that.data_storage == STORAGE_INTERNED) {
+                if(this->data_key == that.data_key)
+                    return true;
+                else if(this->data_key->data.hash != that.data_key->data.hash)
+                    return false;
+            }
+            return this->stringSize() == that.stringSize() && !std::memcmp(this->stringData(), that.stringData(), this->stringSize());
         case JKSN_ARRAY:
-            {
-                const std::vector<JKSNValue> &this_vector = this->toVector();
-                const std::vector<JKSNValue> &that_vector = that.toVector();
+            if(this->isPacked() || that.isPacked())
+                return packedEquals(*this, that);
+            else {
+                const JKSNArray &this_vector = this->toVector();
+                const JKSNArray &that_vector = that.toVector();
                 if(this_vector.size() != that_vector.size())
                     return false;
                 else {
@@ -1576,15 +5311,17 @@ bool JKSNValue::operator==(const JKSNValue &that) const {
             }
         case JKSN_OBJECT:
             {
-                const std::map<JKSNValue, JKSNValue> &this_map = this->toMap();
-                const std::map<JKSNValue, JKSNValue> &that_map = that.toMap();
+                /* Objects with the same members are equal in whatever order they were inserted */
+                const JKSNObject &this_map = this->toMap();
+                const JKSNObject &that_map = that.toMap();
                 if(this_map.size() != that_map.size())
                     return false;
                 else {
-                    for(auto this_iter = this_map.cbegin(), that_iter = that_map.cbegin();
-                        this_iter != this_map.end(); ++this_iter, ++that_iter)
-                    if((*this_iter).first != (*that_iter).first || (*this_iter).second != (*that_iter).second)
-                        return false;
+                    for(const auto &this_item : this_map) {
+                        JKSNObject::const_iterator that_iter = that_map.find(this_item.first);
+                        if(that_iter == that_map.cend() || this_item.second != that_iter->second)
+                            return false;
+                    }
                     return true;
                 }
             }
@@ -1653,11 +5390,19 @@ bool JKSNValue::operator<(const JKSNValue &that) const {
             }
         case JKSN_STRING:
         case JKSN_BLOB:
-            return this->toString() < that.toString();
-        case JKSN_ARRAY:
             {
-                const std::vector<JKSNValue> &this_vector = this->toVector();
-                const std::vector<JKSNValue> &that_vector = that.toVector();
+                /* Compared in place, as std::string would, without copying either side */
+                size_t this_size = this->stringSize();
+                size_t that_size = that.stringSize();
+                int result = std::memcmp(this->stringData(), that.stringData(), std::min(this_size, that_size));
+                return result < 0 || (result == 0 && this_size < that_size);
+            }
+        case JKSN_ARRAY:
+            if(this->isPacked() || that.isPacked())
+                return packedLess(*this, that);
+            else {
+                const JKSNArray &this_vector = this->toVector();
+                const JKSNArray &that_vector = that.toVector();
                 auto this_iter = this_vector.cbegin();
                 auto that_iter = that_vector.cbegin();
                 for(; this_iter != this_vector.cend(); ++this_iter, ++that_iter) {
@@ -1672,20 +5417,21 @@ bool JKSNValue::operator<(const JKSNValue &that) const {
             }
         case JKSN_OBJECT:
             {
-                const std::map<JKSNValue, JKSNValue> &this_map = this->toMap();
-                const std::map<JKSNValue, JKSNValue> &that_map = this->toMap();
+                /* Members are compared in the order of their keys, to agree with operator== */
+                std::vector<JKSNObject::const_iterator> this_map = sortedMembers(this->toMap());
+                std::vector<JKSNObject::const_iterator> that_map = sortedMembers(that.toMap());
                 auto this_iter = this_map.cbegin();
                 auto that_iter = that_map.cbegin();
                 for(; this_iter != this_map.cend(); ++this_iter, ++that_iter) {
                     if(that_iter == that_map.cend())
                         return false;
-                    else if((*this_iter).first < (*that_iter).first)
+                    else if((*this_iter)->first < (*that_iter)->first)
                         return true;
-                    else if((*this_iter).first != (*that_iter).first) /* > */
+                    else if((*this_iter)->first != (*that_iter)->first) /* > */
                         return false;
-                    else if((*this_iter).second < (*that_iter).second)
+                    else if((*this_iter)->second < (*that_iter)->second)
                         return true;
-                    else if((*this_iter).second != (*that_iter).second)
+                    else if((*this_iter)->second != (*that_iter)->second)
                         return false;
                 }
                 return that_iter != that_map.cend();
@@ -1699,52 +5445,135 @@ bool JKSNValue::operator<(const JKSNValue &that) const {
 
 JKSNValue &JKSNValue::operator=(const JKSNValue &that) {
     if(this != &that) {
-        union {
-            std::string *new_string = nullptr;
-            std::vector<JKSNValue> *new_array;
-            std::map<JKSNValue, JKSNValue> *new_object;
-        } new_data;
-        switch(that.getType()) {
-        case JKSN_BOOL:
-            this->data_bool = that.toBool();
-            break;
-        case JKSN_INT:
-            this->data_int = that.toInt();
-            break;
-        case JKSN_FLOAT:
-            this->data_float = that.toFloat();
-            break;
-        case JKSN_DOUBLE:
-            this->data_double = that.toDouble();
-            break;
-        case JKSN_LONG_DOUBLE:
-            this->data_long_double = that.toLongDouble();
-            break;
-        case JKSN_STRING:
-        case JKSN_BLOB:
-            new_data.new_string = new std::string(that.toString());
-            break;
-        case JKSN_ARRAY:
-            new_data.new_array = new std::vector<JKSNValue>(that.toVector());
-            break;
-        case JKSN_OBJECT:
-            new_data.new_object = new std::map<JKSNValue, JKSNValue>(that.toMap());
-            break;
-        default:
-            break;
+        /* Copied aside first, as that may be a part of this */
+        JKSNValue result;
+        if(that.isLongDouble())
+            result = JKSNValue(*that.data_long_double);
+        else if(that.isStringOrBlob() && that.data_storage == STORAGE_HEAP)
+            result = JKSNValue(*that.data_string, that.isBlob());
+        else {
+            /* Containers and interned keys are shared, and scalars, short
+               strings and borrowed values own nothing */
+            if(that.isArray() && that.data_storage == STORAGE_HEAP)
+                that.data_array->acquire();
+            else if(that.isArray() && that.data_storage == STORAGE_PACKED)
+                that.data_numbers->acquire();
+            else if(that.isObject() && that.data_storage == STORAGE_HEAP)
+                that.data_object->acquire();
+            else if(that.isStringOrBlob() && that.data_storage == STORAGE_INTERNED)
+                that.data_key->acquire();
+            result.copyRepresentation(that);
         }
+        return *this = std::move(result);
+    }
+    return *this;
+}
+
+JKSNValue &JKSNValue::operator=(JKSNValue &&that) noexcept {
+    if(this != &that) {
         this->~JKSNValue();
-        switch((this->data_type = that.getType())) {
+        this->copyRepresentation(that);
+        that.data_type = JKSN_UNDEFINED;
+        that.data_storage = STORAGE_HEAP;
+    }
+    return *this;
+}
+
+void JKSNValue::copyRepresentation(const JKSNValue &that) {
+    /* Every kind of payload fits in the bytes before the storage, so that
+       values are moved without looking at their type */
+    static_assert(offsetof(JKSNValue, data_storage) == inline_capacity, "JKSNValue payload should take up inline_capacity bytes");
+    std::memcpy(this->inlineData(), that.inlineData(), inline_capacity);
+    this->data_storage = that.data_storage;
+    this->data_type = that.data_type;
+}
+
+void JKSNValue::unshare() {
+    /* Only this level is cloned, as copying the children shares theirs. The
+       clone is on the heap, even if the original is in an arena, and holds
+       values even if the original was packed. */
+    JKSNValue result;
+    if(this->isPacked()) {
+        const JKSNNumberArray &numbers = this->data_numbers->data;
+        result.data_array = new SharedArray();
+        result.data_array->data.reserve(numbers.size());
+        for(size_t i = 0; i < numbers.size(); ++i)
+            result.data_array->data.push_back(numbers[i]);
+    } else if(this->isArray())
+        result.data_array = new SharedArray(this->data_array->data);
+    else
+        result.data_object = new SharedObject(this->data_object->data);
+    result.data_type = this->data_type;
+    *this = std::move(result);
+}
+
+void JKSNValue::releaseContainer() {
+    /* Nested containers are moved out onto an explicit stack before their parent
+       is freed, so that freeing never goes more than one level deep. Containers
+       that are still shared with other values are only let go of, and those in
+       an arena are never pushed. */
+    std::vector<JKSNValue> pending;
+    JKSNValue item(std::move(*this));
+    for(;;) {
+        if(item.data_type == JKSN_ARRAY) {
+            if(item.data_array->release()) {
+                for(JKSNValue &child : item.data_array->data)
+                    if(!child.isBorrowed() && child.hasChildren())
+                        pending.push_back(std::move(child));
+                delete item.data_array;
+            }
+        } else if(item.data_object->release()) {
+            /* Keys stay with their shape, which may be shared */
+            for(JKSNValue &child : item.data_object->data.values)
+                if(!child.isBorrowed() && child.hasChildren())
+                    pending.push_back(std::move(child));
+            delete item.data_object;
+        }
+        item.data_type = JKSN_UNDEFINED;
+        if(pending.empty())
+            return;
+        item = std::move(pending.back());
+        pending.pop_back();
+    }
+}
+
+JKSNValue &JKSNValue::materialize() {
+    /* Containers are walked with a list of the values still pending instead of
+       recursion, so that the nesting depth is limited by memory */
+    std::vector<JKSNValue *> pending(1, this);
+    while(!pending.empty()) {
+        JKSNValue &value = *pending.back();
+        pending.pop_back();
+        switch(value.getType()) {
         case JKSN_STRING:
         case JKSN_BLOB:
-            this->data_string = new_data.new_string;
+            if(value.data_storage == STORAGE_BORROWED) {
+                const char *data = value.data_ref;
+                size_t size = value.stringSize();
+                value.data_storage = STORAGE_HEAP;
+                value.initString(data, size);
+            }
+            break;
+        case JKSN_LONG_DOUBLE:
+            if(value.data_storage == STORAGE_BORROWED) {
+                value.data_long_double = new long double(*value.data_long_double);
+                value.data_storage = STORAGE_HEAP;
+            }
             break;
         case JKSN_ARRAY:
-            this->data_array = new_data.new_array;
+            /* Packed numbers borrow nothing */
+            if(!value.isPacked())
+                for(JKSNValue &i : value.toVector())
+                    pending.push_back(&i);
             break;
         case JKSN_OBJECT:
-            this->data_object = new_data.new_object;
-            break;
+            {
+                JKSNObject &members = value.toMap();
+                members.materializeKeys();
+                for(JKSNValue &i : members.values)
+                    pending.push_back(&i);
+                break;
+            }
         default:
             break;
         }
@@ -1752,42 +5581,422 @@ JKSNValue &JKSNValue::operator=(const JKSNValue &that) {
     return *this;
 }
 
-JKSNValue &JKSNValue::operator=(JKSNValue &&that) {
-    if(this != &that) {
-        this->~JKSNValue();
-        switch(that.getType()) {
-        case JKSN_BOOL:
-            this->data_bool = that.toBool();
-            break;
-        case JKSN_INT:
-            this->data_int = that.toInt();
-            break;
-        case JKSN_FLOAT:
-            this->data_float = that.toFloat();
-            break;
-        case JKSN_DOUBLE:
-            this->data_double = that.toDouble();
-            break;
-        case JKSN_LONG_DOUBLE:
-            this->data_long_double = that.toLongDouble();
+bool JKSNValue::pack() {
+    if(!this->isArray())
+        throw JKSNTypeError();
+    else if(this->isPacked())
+        return true;
+    const JKSNArray &items = this->data_array->data;
+    if(items.empty())
+        return false;
+    jksn_data_type type = items[0].getType();
+    if(type != JKSN_INT && type != JKSN_FLOAT && type != JKSN_DOUBLE)
+        return false;
+    for(const JKSNValue &item : items)
+        if(item.getType() != type)
+            return false;
+    JKSNNumberArray numbers(type);
+    numbers.reserve(items.size());
+    for(const JKSNValue &item : items)
+        numbers.push_back(item);
+    *this = JKSNValue(std::move(numbers));
+    return true;
+}
+
+const JKSNArray &JKSNValue::packedElements() const {
+    const JKSNNumberArray &numbers = this->data_numbers->data;
+    JKSNArray *result = numbers.elements.load(std::memory_order_acquire);
+    if(result)
+        return *result;
+    std::unique_ptr<JKSNArray> elements(new JKSNArray);
+    elements->reserve(numbers.size());
+    for(size_t i = 0; i < numbers.size(); ++i)
+        elements->push_back(numbers[i]);
+    /* Threads that build it at the same time keep the first one to be stored */
+    if(numbers.elements.compare_exchange_strong(result, elements.get(), std::memory_order_acq_rel, std::memory_order_acquire))
+        return *elements.release();
+    return *result;
+}
+
+JKSNValue JKSNValue::fromArena(JKSNArray &&data, JKSNArena &arena) {
+    JKSNValue result;
+    result.data_array = new(arena.allocate(sizeof (SharedArray), alignof(SharedArray))) SharedArray(std::move(data));
+    result.data_storage = STORAGE_BORROWED;
+    result.data_type = JKSN_ARRAY;
+    return result;
+}
+
+JKSNValue JKSNValue::fromArena(JKSNObject &&data, JKSNArena &arena) {
+    JKSNValue result;
+    result.data_object = new(arena.allocate(sizeof (SharedObject), alignof(SharedObject))) SharedObject(std::move(data));
+    result.data_storage = STORAGE_BORROWED;
+    result.data_type = JKSN_OBJECT;
+    return result;
+}
+
+void JKSNValue::moveToArena(JKSNArena &arena) {
+    /* Values in an arena are never destroyed, so whatever they own on the heap
+       or share is copied into the arena and borrowed from there */
+    if(this->data_storage != STORAGE_HEAP && this->data_storage != STORAGE_INTERNED && this->data_storage != STORAGE_PACKED)
+        return;
+    switch(this->getType()) {
+    case JKSN_STRING:
+    case JKSN_BLOB:
+        {
+            size_t size = this->stringSize();
+            char *data = static_cast<char *>(arena.allocate(size, 1));
+            std::memcpy(data, this->stringData(), size);
+            *this = fromBorrowed(data, size, this->isBlob());
             break;
-        case JKSN_STRING:
-        case JKSN_BLOB:
-            this->data_string = that.data_string;
+        }
+    case JKSN_LONG_DOUBLE:
+        {
+            long double *data = new(arena.allocate(sizeof (long double), alignof(long double))) long double(*this->data_long_double);
+            delete this->data_long_double;
+            this->data_long_double = data;
+            this->data_storage = STORAGE_BORROWED;
             break;
-        case JKSN_ARRAY:
-            this->data_array = that.data_array;
+        }
+    case JKSN_ARRAY:
+        {
+            /* The decoder puts what it fills in into the arena itself, so only
+               empty containers are usually left to move. Packed arrays are
+               unpacked, as their numbers are on the heap. */
+            JKSNArray data(&arena);
+            data.reserve(this->toVector().size());
+            for(JKSNValue &item : this->toVector()) {
+                data.push_back(std::move(item));
+                data.back().moveToArena(arena);
+            }
+            *this = fromArena(std::move(data), arena);
             break;
-        case JKSN_OBJECT:
-            this->data_object = that.data_object;
+        }
+    case JKSN_OBJECT:
+        {
+            JKSNObject::container_type data(&arena);
+            data.reserve(this->toMap().size());
+            for(auto &&item : this->toMap()) {
+                data.emplace_back(item.first, std::move(item.second));
+                data.back().first.moveToArena(arena);
+                data.back().second.moveToArena(arena);
+            }
+            *this = fromArena(JKSNObject(std::move(data)), arena);
             break;
-        default:
+        }
+    default:
+        break;
+    }
+}
+
+JKSNArena::~JKSNArena() {
+    for(const Chunk &chunk : this->chunks)
+#ifdef JKSN_HAVE_MMAP
+        if(chunk.mapped)
+            munmap(chunk.data, chunk.size);
+        else
+#endif
+            std::free(chunk.data);
+}
+
+void *JKSNArena::grow(size_t size, size_t align) {
+    if(size > ~size_t(0) - align)
+        throw std::bad_alloc();
+    size_t chunk_size = std::max(this->next_chunk, size + align);
+    Chunk chunk{nullptr, chunk_size, false};
+    this->chunks.reserve(this->chunks.size()+1);
+#if defined(JKSN_HAVE_MMAP) && defined(MAP_ANONYMOUS)
+    /* Large chunks come straight from the kernel, which is asked to back them
+       with huge pages where it supports that */
+    if(chunk_size >= 0x200000) {
+        void *data = mmap(nullptr, chunk_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(data != MAP_FAILED) {
+#ifdef MADV_HUGEPAGE
+            madvise(data, chunk_size, MADV_HUGEPAGE);
+#endif
+            chunk.data = data;
+            chunk.mapped = true;
+        }
+    }
+#endif
+    if(!chunk.data && !(chunk.data = std::malloc(chunk_size)))
+        throw std::bad_alloc();
+    this->chunks.push_back(chunk);
+    this->reserved += chunk_size;
+    if(this->next_chunk < max_chunk)
+        this->next_chunk *= 2;
+    this->current = static_cast<char *>(chunk.data);
+    this->end = this->current + chunk_size;
+    return this->allocate(size, align);
+}
+
+size_t JKSNShape::locate(const JKSNValue &key, size_t &hash) const {
+    if(this->index.empty()) {
+        for(size_t i = 0; i < this->keys.size(); ++i)
+            if(this->keys[i] == key)
+                return i;
+        return this->keys.size();
+    }
+    hash = hashKey(key);
+    size_t mask = this->index.size()-1;
+    for(size_t slot = hash & mask; this->index[slot] != 0; slot = (slot+1) & mask)
+        if(this->keys[this->index[slot]-1] == key)
+            return this->index[slot]-1;
+    return this->keys.size();
+}
+
+void JKSNShape::append(JKSNValue &&key, size_t hash) {
+    size_t position = this->keys.size();
+    this->keys.push_back(std::move(key));
+    /* Keys in an arena are never destroyed, so they may not own anything on the heap */
+    if(this->inArena())
+        this->keys.back().moveToArena(*this->keys.get_allocator().arena);
+    if(!this->index.empty() && this->keys.size()*2 <= this->index.size())
+        this->indexKey(position, hash);
+    else if(this->keys.size() > index_threshold)
+        this->rebuildIndex();
+}
+
+void JKSNShape::assign(const JKSNShape &that) {
+    this->keys.assign(that.keys.begin(), that.keys.end());
+    this->index.assign(that.index.begin(), that.index.end());
+    if(this->inArena())
+        for(JKSNValue &key : this->keys)
+            key.moveToArena(*this->keys.get_allocator().arena);
+}
+
+void JKSNShape::erase(size_t position) {
+    this->keys.erase(this->keys.begin() + std::ptrdiff_t(position));
+    if(this->keys.size() > index_threshold)
+        this->rebuildIndex();
+    else
+        this->index.clear();
+}
+
+void JKSNShape::rebuildIndex() {
+    this->index.assign(tableSize(this->keys.size()), 0);
+    for(size_t i = 0; i < this->keys.size(); ++i)
+        this->indexKey(i, hashKey(this->keys[i]));
+}
+
+void JKSNShape::indexKey(size_t position, size_t hash) {
+    size_t mask = this->index.size()-1;
+    size_t slot = hash & mask;
+    while(this->index[slot] != 0)
+        slot = (slot+1) & mask;
+    this->index[slot] = position+1;
+}
+
+size_t JKSNShape::tableSize(size_t size) {
+    /* At most half full, so that probing stays short */
+    size_t result = index_threshold*2;
+    while(result < size*2)
+        result *= 2;
+    return result;
+}
+
+size_t JKSNShape::hashKey(const JKSNValue &key) {
+    /* Keys that compare equal must hash equally, so numbers of every width hash
+       by their value as a double, and other types, which are rare as keys, share
+       a hash of their type */
+    uint64_t result = 14695981039346656037ULL;
+    switch(key.getType()) {
+    case JKSN_STRING:
+    case JKSN_BLOB:
+        /* Interned keys were hashed the same way when they were interned */
+        if(key.data_storage == JKSNValue::STORAGE_INTERNED)
+            return key.data_key->data.hash;
+        return FNVHash(key.stringData(), key.stringSize());
+    case JKSN_INT:
+    case JKSN_FLOAT:
+    case JKSN_DOUBLE:
+    case JKSN_LONG_DOUBLE:
+        {
+            double number = key.toDouble() + 0.0; /* -0.0 equals 0.0 */
+            uint64_t bits;
+            std::memcpy(&bits, &number, sizeof bits);
+            result = (result ^ bits) * 1099511628211ULL;
             break;
         }
-        this->data_type = that.data_type;
-        that.data_type = JKSN_UNDEFINED;
+    default:
+        result = (result ^ uint64_t(key.getType())) * 1099511628211ULL;
+    }
+    return size_t(result ^ (result >> 32));
+}
+
+JKSNObject::JKSNObject(container_type &&members) :
+    values(members.get_allocator()) {
+    if(members.empty())
+        return;
+    this->keys = newShape(this->values.get_allocator());
+    JKSNShape &shape = this->keys->data;
+    shape.keys.reserve(members.size());
+    this->values.reserve(members.size());
+    for(value_type &member : members) {
+        size_t hash = 0;
+        size_t position = shape.locate(member.first, hash);
+        if(position != shape.size())
+            this->values[position] = std::move(member.second);
+        else {
+            shape.append(std::move(member.first), hash);
+            this->values.push_back(std::move(member.second));
+        }
+    }
+}
+
+JKSNObject &JKSNObject::operator=(const JKSNObject &that) {
+    if(this != &that) {
+        this->values = that.values;
+        if(that.keys)
+            that.keys->acquire();
+        releaseShape(this->keys);
+        this->keys = that.keys;
+    }
+    return *this;
+}
+
+JKSNObject &JKSNObject::operator=(JKSNObject &&that) noexcept {
+    if(this != &that) {
+        this->values = std::move(that.values);
+        releaseShape(this->keys);
+        this->keys = that.keys;
+        that.keys = nullptr;
+    }
+    return *this;
+}
+
+std::pair<JKSNObject::iterator, bool> JKSNObject::insert(value_type &&member) {
+    size_t hash = 0;
+    size_t position = this->keys ? this->keys->data.locate(member.first, hash) : 0;
+    if(position != this->values.size())
+        return std::make_pair(this->begin() + std::ptrdiff_t(position), false);
+    this->ownShape().append(std::move(member.first), hash);
+    this->values.push_back(std::move(member.second));
+    return std::make_pair(this->begin() + std::ptrdiff_t(position), true);
+}
+
+JKSNObject::iterator JKSNObject::erase(const_iterator position) {
+    std::ptrdiff_t offset = position - this->cbegin();
+    this->ownShape().erase(size_t(offset));
+    this->values.erase(this->values.begin() + offset);
+    return this->begin() + offset;
+}
+
+size_t JKSNObject::erase(const JKSNValue &key) {
+    size_t position = this->shape().find(key);
+    if(position == this->values.size())
+        return 0;
+    this->erase(this->cbegin() + std::ptrdiff_t(position));
+    return 1;
+}
+
+JKSNShape &JKSNObject::ownShape() {
+    JKSNAllocator<JKSNValue> allocator = this->values.get_allocator();
+    if(!this->keys)
+        this->keys = newShape(allocator);
+    else if(this->keys->isShared() || this->keys->data.keys.get_allocator() != allocator) {
+        SharedShape *shape = newShape(allocator);
+        /* Assigned rather than constructed, as the arena is only known to newShape */
+        shape->data.assign(this->keys->data);
+        releaseShape(this->keys);
+        this->keys = shape;
+    }
+    return this->keys->data;
+}
+
+void JKSNObject::materializeKeys() {
+    if(!this->keys)
+        return;
+    bool borrowed = this->keys->data.inArena();
+    for(const JKSNValue &key : this->keys->data.keys)
+        borrowed = borrowed || key.isBorrowed() || key.isContainer();
+    if(!borrowed)
+        return;
+    /* A key keeps its hash when its bytes are copied, so the index stays valid */
+    SharedShape *shape = new SharedShape(this->keys->data, JKSNAllocator<JKSNValue>());
+    for(JKSNValue &key : shape->data.keys)
+        key.materialize();
+    releaseShape(this->keys);
+    this->keys = shape;
+}
+
+JKSNObject::SharedShape *JKSNObject::newShape(const JKSNAllocator<JKSNValue> &allocator) {
+    if(!allocator.arena)
+        return new SharedShape();
+    return new(allocator.arena->allocate(sizeof (SharedShape), alignof(SharedShape))) SharedShape(allocator);
+}
+
+JKSNNumberArray::JKSNNumberArray(jksn_data_type type) :
+    type(type) {
+    if(type != JKSN_INT && type != JKSN_FLOAT && type != JKSN_DOUBLE)
+        throw JKSNTypeError();
+}
+
+JKSNNumberArray &JKSNNumberArray::operator=(JKSNNumberArray &&that) noexcept {
+    if(this != &that) {
+        this->type = that.type;
+        this->ints = std::move(that.ints);
+        this->floats = std::move(that.floats);
+        this->doubles = std::move(that.doubles);
+        delete this->elements.exchange(nullptr);
     }
     return *this;
 }
 
+JKSNNumberArray::~JKSNNumberArray() {
+    delete this->elements.load();
+}
+
+void JKSNNumberArray::reserve(size_t size) {
+    switch(this->type) {
+    case JKSN_INT:
+        this->ints.reserve(size);
+        break;
+    case JKSN_FLOAT:
+        this->floats.reserve(size);
+        break;
+    default:
+        this->doubles.reserve(size);
+    }
+}
+
+void JKSNNumberArray::push_back(const JKSNValue &value) {
+    if(value.getType() != this->type)
+        throw JKSNTypeError();
+    switch(this->type) {
+    case JKSN_INT:
+        this->ints.push_back(value.toInt());
+        break;
+    case JKSN_FLOAT:
+        this->floats.push_back(value.toFloat());
+        break;
+    default:
+        this->doubles.push_back(value.toDouble());
+    }
+}
+
+JKSNValue JKSNNumberArray::operator[](size_t index) const {
+    switch(this->type) {
+    case JKSN_INT:
+        return JKSNValue(this->ints[index]);
+    case JKSN_FLOAT:
+        return JKSNValue(this->floats[index]);
+    default:
+        return JKSNValue(this->doubles[index]);
+    }
+}
+
+JKSNValue JKSNNumberArray::at(size_t index) const {
+    if(index >= this->size())
+        throw std::out_of_range("JKSN array index out of range");
+    return (*this)[index];
+}
+
+JKSNValue JKSNNumberArray::const_iterator::operator*() const {
+    return (*this->array)[this->index];
+}
+
+JKSNValue JKSNNumberArray::const_iterator::operator[](difference_type offset) const {
+    return *(*this + offset);
+}
+
 }
@@ -21,17 +21,28 @@
 #ifndef _JKSN_HPP_INCLUDED
 #define _JKSN_HPP_INCLUDED
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <functional>
 #include <initializer_list>
 #include <istream>
+#include <iterator>
 #include <map>
+#include <memory>
+#include <new>
 #include <ostream>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <utility>
 #include <vector>
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+#define JKSN_HAVE_COROUTINES 1
+#include <coroutine>
+#include <exception>
+#endif
 
 namespace JKSN {
 
@@ -57,6 +68,10 @@ public:
     JKSNTypeError(const char *what) : JKSNDecodeError(what) {}
     JKSNTypeError() : JKSNDecodeError("invalid JKSN data type") {}
 };
+class JKSNLimitError : public JKSNDecodeError {
+public:
+    JKSNLimitError(const char *what) : JKSNDecodeError(what) {}
+};
 
 typedef enum {
     JKSN_UNDEFINED,
@@ -73,9 +88,307 @@ typedef enum {
     JKSN_UNSPECIFIED
 } jksn_data_type;
 
+typedef enum {
+    JKSN_TOKEN_NONE,
+    JKSN_TOKEN_START_ARRAY,
+    JKSN_TOKEN_START_OBJECT,
+    JKSN_TOKEN_START_SWAPPED_ARRAY,
+    JKSN_TOKEN_COLUMN,
+    JKSN_TOKEN_KEY,
+    JKSN_TOKEN_SCALAR,
+    JKSN_TOKEN_STRING_CHUNK,
+    JKSN_TOKEN_END
+} jksn_token_type;
+
 class Unspecified {
 };
 
+class JKSNArena {
+    /* Note: Hands out memory from a few large chunks and frees all of it at once
+       when destroyed. Nothing allocated from it is freed or destroyed before. */
+public:
+    /* The first chunk holds at least initial bytes, and each further one doubles */
+    explicit JKSNArena(size_t initial = 0x10000) :
+        next_chunk(initial) {
+    }
+    JKSNArena(const JKSNArena &) = delete;
+    JKSNArena &operator=(const JKSNArena &) = delete;
+    ~JKSNArena();
+    void *allocate(size_t size, size_t align) {
+        uintptr_t result = (uintptr_t(this->current) + (align-1)) & ~uintptr_t(align-1);
+        if(this->current && result <= uintptr_t(this->end) && size <= uintptr_t(this->end) - result) {
+            this->current = reinterpret_cast<char *>(result + size);
+            return reinterpret_cast<void *>(result);
+        }
+        return this->grow(size, align);
+    }
+    /* Bytes taken from the system so far */
+    size_t capacity() const {
+        return this->reserved;
+    }
+private:
+    void *grow(size_t size, size_t align);
+    static const size_t max_chunk = 0x4000000;
+    char *current = nullptr;
+    char *end = nullptr;
+    size_t next_chunk;
+    size_t reserved = 0;
+    struct Chunk {
+        void *data;
+        size_t size;
+        bool mapped;
+    };
+    std::vector<Chunk> chunks;
+};
+
+/* Allocates from an arena if it has one, or else from the heap. Copies of a
+   container go to the heap, as with std::pmr::polymorphic_allocator, while a
+   container that is moved keeps its arena. */
+template<typename T>
+class JKSNAllocator {
+public:
+    typedef T value_type;
+    JKSNAllocator() = default;
+    JKSNAllocator(JKSNArena *arena) :
+        arena(arena) {
+    }
+    template<typename U>
+    JKSNAllocator(const JKSNAllocator<U> &that) :
+        arena(that.arena) {
+    }
+    T *allocate(size_t count) {
+        if(!this->arena)
+            return std::allocator<T>().allocate(count);
+        else if(count > ~size_t(0) / sizeof (T))
+            throw std::bad_alloc();
+        else
+            return static_cast<T *>(this->arena->allocate(count * sizeof (T), alignof(T)));
+    }
+    void deallocate(T *ptr, size_t count) {
+        if(!this->arena)
+            std::allocator<T>().deallocate(ptr, count);
+    }
+    JKSNAllocator select_on_container_copy_construction() const {
+        return JKSNAllocator();
+    }
+    template<typename U>
+    bool operator==(const JKSNAllocator<U> &that) const {
+        return this->arena == that.arena;
+    }
+    template<typename U>
+    bool operator!=(const JKSNAllocator<U> &that) const {
+        return this->arena != that.arena;
+    }
+    JKSNArena *arena = nullptr;
+};
+
+class JKSNValue;
+class JKSNObject;
+class JKSNNumberArray;
+typedef std::vector<JKSNValue, JKSNAllocator<JKSNValue> > JKSNArray;
+
+/* A container that copies of a JKSNValue share until one of them changes it */
+template<typename T>
+struct JKSNShared {
+    template<typename... Args>
+    explicit JKSNShared(Args &&...args) :
+        data(std::forward<Args>(args)...) {
+    }
+    void acquire() const {
+        this->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    /* Returns true if the caller held the last reference */
+    bool release() const {
+        return this->refs.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+    bool isShared() const {
+        return this->refs.load(std::memory_order_acquire) != 1;
+    }
+    mutable std::atomic<size_t> refs{1};
+    T data;
+};
+
+/* The bytes of an object key that identical keys from one decoder share, and their hash */
+struct JKSNKeyData {
+    JKSNKeyData(std::string &&bytes, size_t hash) :
+        bytes(std::move(bytes)),
+        hash(hash) {
+    }
+    const std::string bytes;
+    const size_t hash;
+};
+
+class JKSNNumberArray {
+    /* Note: The elements of an array whose numbers all have one type, int, float
+       or double, kept in a plain vector of that type, at a half or a quarter of
+       the size of a JKSNArray. A JKSNValue holds one in place of its JKSNArray,
+       gives out elements by value through operator[] and its iterators, and
+       builds a JKSNArray of them only for the const accessors of JKSNValue that
+       return one by reference, keeping it alongside the numbers from then on.
+       Read a packed array through JKSNValue::toNumbers() to keep it small. */
+public:
+    /* type is JKSN_INT, JKSN_FLOAT or JKSN_DOUBLE */
+    explicit JKSNNumberArray(jksn_data_type type = JKSN_INT);
+    explicit JKSNNumberArray(std::vector<intmax_t> &&data) :
+        type(JKSN_INT),
+        ints(std::move(data)) {
+    }
+    explicit JKSNNumberArray(std::vector<float> &&data) :
+        type(JKSN_FLOAT),
+        floats(std::move(data)) {
+    }
+    explicit JKSNNumberArray(std::vector<double> &&data) :
+        type(JKSN_DOUBLE),
+        doubles(std::move(data)) {
+    }
+    /* Neither copies nor moves bring along the JKSNArray built from the elements */
+    JKSNNumberArray(const JKSNNumberArray &that) :
+        type(that.type),
+        ints(that.ints),
+        floats(that.floats),
+        doubles(that.doubles) {
+    }
+    JKSNNumberArray(JKSNNumberArray &&that) noexcept :
+        type(that.type),
+        ints(std::move(that.ints)),
+        floats(std::move(that.floats)),
+        doubles(std::move(that.doubles)) {
+    }
+    JKSNNumberArray &operator=(const JKSNNumberArray &that) {
+        return *this = JKSNNumberArray(that);
+    }
+    JKSNNumberArray &operator=(JKSNNumberArray &&that) noexcept;
+    ~JKSNNumberArray();
+
+    jksn_data_type elementType() const {
+        return this->type;
+    }
+    size_t size() const {
+        switch(this->type) {
+        case JKSN_INT:
+            return this->ints.size();
+        case JKSN_FLOAT:
+            return this->floats.size();
+        default:
+            return this->doubles.size();
+        }
+    }
+    bool empty() const {
+        return this->size() == 0;
+    }
+    void reserve(size_t size);
+    /* Throws JKSNTypeError unless the value is a number of the element type */
+    void push_back(const JKSNValue &value);
+    JKSNValue operator[](size_t index) const;
+    JKSNValue at(size_t index) const;
+    /* Gives out the elements by value, as operator[] does */
+    class const_iterator {
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef JKSNValue value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef JKSNValue reference;
+        typedef void pointer;
+        const_iterator() = default;
+        const_iterator(const JKSNNumberArray *array, size_t index) :
+            array(array),
+            index(index) {
+        }
+        reference operator*() const;
+        reference operator[](difference_type offset) const;
+        const_iterator &operator++() {
+            ++this->index;
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator result = *this;
+            ++*this;
+            return result;
+        }
+        const_iterator &operator--() {
+            --this->index;
+            return *this;
+        }
+        const_iterator operator--(int) {
+            const_iterator result = *this;
+            --*this;
+            return result;
+        }
+        const_iterator &operator+=(difference_type offset) {
+            this->index += size_t(offset);
+            return *this;
+        }
+        const_iterator &operator-=(difference_type offset) {
+            return *this += -offset;
+        }
+        const_iterator operator+(difference_type offset) const {
+            return const_iterator(*this) += offset;
+        }
+        const_iterator operator-(difference_type offset) const {
+            return const_iterator(*this) += -offset;
+        }
+        difference_type operator-(const const_iterator &that) const {
+            return difference_type(this->index) - difference_type(that.index);
+        }
+        bool operator==(const const_iterator &that) const {
+            return this->index == that.index;
+        }
+        bool operator!=(const const_iterator &that) const {
+            return this->index != that.index;
+        }
+        bool operator<(const const_iterator &that) const {
+            return this->index < that.index;
+        }
+        bool operator>(const const_iterator &that) const {
+            return this->index > that.index;
+        }
+        bool operator<=(const const_iterator &that) const {
+            return this->index <= that.index;
+        }
+        bool operator>=(const const_iterator &that) const {
+            return this->index >= that.index;
+        }
+    private:
+        const JKSNNumberArray *array = nullptr;
+        size_t index = 0;
+    };
+    typedef const_iterator iterator;
+    const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+    const_iterator end() const {
+        return const_iterator(this, this->size());
+    }
+    /* The elements themselves, for loops over one type. Each throws
+       JKSNTypeError unless it is the element type. */
+    const std::vector<intmax_t> &toInts() const {
+        if(this->type != JKSN_INT)
+            throw JKSNTypeError();
+        return this->ints;
+    }
+    const std::vector<float> &toFloats() const {
+        if(this->type != JKSN_FLOAT)
+            throw JKSNTypeError();
+        return this->floats;
+    }
+    const std::vector<double> &toDoubles() const {
+        if(this->type != JKSN_DOUBLE)
+            throw JKSNTypeError();
+        return this->doubles;
+    }
+private:
+    jksn_data_type type;
+    /* Only the vector of the element type is used */
+    std::vector<intmax_t> ints;
+    std::vector<float> floats;
+    std::vector<double> doubles;
+    /* Built from the elements the first time a JKSNArray of them is asked for,
+       by whichever thread gets there first */
+    mutable std::atomic<JKSNArray *> elements{nullptr};
+    friend class JKSNValue;
+    friend class JKSNDecoderPrivate;
+};
+
 class JKSNValue {
 public:
     JKSNValue() :
@@ -87,80 +400,97 @@ public:
             throw std::invalid_argument("invalid JKSN value");
     }
     JKSNValue(bool data) :
-        data_type(JKSN_BOOL),
-        data_bool(data) {
+        data_bool(data),
+        data_type(JKSN_BOOL) {
     }
     JKSNValue(intmax_t data) :
-        data_type(JKSN_INT),
-        data_int(data) {
+        data_int(data),
+        data_type(JKSN_INT) {
     }
     JKSNValue(uintmax_t data) :
-        data_type(JKSN_INT),
-        data_int(static_cast<intmax_t>(data)) {
+        data_int(static_cast<intmax_t>(data)),
+        data_type(JKSN_INT) {
         if(this->data_int < 0)
             throw std::overflow_error("JKSN value too large");
     }
     JKSNValue(int data) :
-        data_type(JKSN_INT),
-        data_int(data) {
+        data_int(data),
+        data_type(JKSN_INT) {
     }
     JKSNValue(unsigned data) :
-        data_type(JKSN_INT),
-        data_int(static_cast<intmax_t>(data)) {
+        data_int(static_cast<intmax_t>(data)),
+        data_type(JKSN_INT) {
         if(this->data_int < 0)
             throw std::overflow_error("JKSN value too large");
     }
     JKSNValue(float data) :
-        data_type(JKSN_FLOAT),
-        data_float(data) {
+        data_float(data),
+        data_type(JKSN_FLOAT) {
     }
     JKSNValue(double data) :
-        data_type(JKSN_DOUBLE),
-        data_double(data) {
+        data_double(data),
+        data_type(JKSN_DOUBLE) {
     }
     JKSNValue(long double data) :
-        data_type(JKSN_LONG_DOUBLE),
-        data_long_double(data) {
+        data_long_double(new long double(data)),
+        data_type(JKSN_LONG_DOUBLE) {
     }
     JKSNValue(const std::string &data, bool is_blob = false) :
-        data_type(is_blob ? JKSN_BLOB : JKSN_STRING),
-        data_string(new std::string(data)) {
+        data_type(is_blob ? JKSN_BLOB : JKSN_STRING) {
+        this->initString(data.data(), data.size());
     }
     JKSNValue(std::string &&data, bool is_blob = false) :
-        data_type(is_blob ? JKSN_BLOB : JKSN_STRING),
-        data_string(new std::string(std::move(data))) {
+        data_type(is_blob ? JKSN_BLOB : JKSN_STRING) {
+        this->initString(std::move(data));
     }
     JKSNValue(const char *data, bool is_blob = false) :
-        data_type(is_blob ? JKSN_BLOB : JKSN_STRING),
-        data_string(new std::string(data)) {
+        data_type(is_blob ? JKSN_BLOB : JKSN_STRING) {
+        this->initString(data, std::strlen(data));
+    }
+    JKSNValue(const JKSNArray &data) :
+        data_array(new SharedArray(data)),
+        data_type(JKSN_ARRAY) {
+    }
+    JKSNValue(JKSNArray &&data) :
+        data_array(new SharedArray(std::move(data))),
+        data_type(JKSN_ARRAY) {
     }
     JKSNValue(const std::vector<JKSNValue> &data) :
-        data_type(JKSN_ARRAY),
-        data_array(new std::vector<JKSNValue>(data)) {
+        data_array(new SharedArray(data.begin(), data.end())),
+        data_type(JKSN_ARRAY) {
     }
+    /* The elements are moved, but into a buffer of their own */
     JKSNValue(std::vector<JKSNValue> &&data) :
-        data_type(JKSN_ARRAY),
-        data_array(new std::vector<JKSNValue>(std::move(data))) {
+        data_array(new SharedArray(std::make_move_iterator(data.begin()), std::make_move_iterator(data.end()))),
+        data_type(JKSN_ARRAY) {
     }
     JKSNValue(std::initializer_list<JKSNValue> data) :
-        data_type(JKSN_ARRAY),
-        data_array(new std::vector<JKSNValue>(data)) {
-    }
-    JKSNValue(const std::map<JKSNValue, JKSNValue> &data) :
-        data_type(JKSN_OBJECT),
-        data_object(new std::map<JKSNValue, JKSNValue>(data)) {
-    }
-    JKSNValue(std::map<JKSNValue, JKSNValue> &&data) :
-        data_type(JKSN_OBJECT),
-        data_object(new std::map<JKSNValue, JKSNValue>(std::move(data))) {
-    }
+        data_array(new SharedArray(data)),
+        data_type(JKSN_ARRAY) {
+    }
+    JKSNValue(const JKSNNumberArray &data) :
+        data_numbers(new SharedNumbers(data)),
+        data_storage(STORAGE_PACKED),
+        data_type(JKSN_ARRAY) {
+    }
+    JKSNValue(JKSNNumberArray &&data) :
+        data_numbers(new SharedNumbers(std::move(data))),
+        data_storage(STORAGE_PACKED),
+        data_type(JKSN_ARRAY) {
+    }
+    JKSNValue(const JKSNObject &data);
+    JKSNValue(JKSNObject &&data);
+    /* Members are kept in the order of the keys */
+    JKSNValue(const std::map<JKSNValue, JKSNValue> &data);
+    /* The values are moved, but the keys of a std::map can only be copied */
+    JKSNValue(std::map<JKSNValue, JKSNValue> &&data);
     JKSNValue(const Unspecified &) :
         data_type(JKSN_UNSPECIFIED) {
     }
     JKSNValue(const JKSNValue &that) {
         this->operator=(that);
     }
-    JKSNValue(JKSNValue &&that) {
+    JKSNValue(JKSNValue &&that) noexcept {
         this->operator=(std::move(that));
     }
     static JKSNValue fromUndefined() {
@@ -217,6 +547,34 @@ public:
     static JKSNValue fromBlob(const char *data) {
         return JKSNValue(data, true);
     }
+    static JKSNValue fromBytes(const char *data, size_t size, bool is_blob = false) {
+        JKSNValue result;
+        result.data_type = is_blob ? JKSN_BLOB : JKSN_STRING;
+        result.initString(data, size);
+        return result;
+    }
+    /* Refers to the bytes instead of copying them, so they must outlive the value
+       and all of its copies, unless materialize is called */
+    static JKSNValue fromBorrowed(const char *data, size_t size, bool is_blob = false) {
+        JKSNValue result;
+        result.data_type = is_blob ? JKSN_BLOB : JKSN_STRING;
+        /* Sizes beyond what a value holds are copied instead */
+        if(size >> 48 != 0) {
+            result.initString(data, size);
+            return result;
+        }
+        result.data_storage = STORAGE_BORROWED;
+        result.data_ref = data;
+        result.data_size = uint32_t(size);
+        result.data_size_high = uint16_t(size >> 32);
+        return result;
+    }
+    static JKSNValue fromVector(const JKSNArray &data) {
+        return JKSNValue(data);
+    }
+    static JKSNValue fromVector(JKSNArray &&data) {
+        return JKSNValue(std::move(data));
+    }
     static JKSNValue fromVector(const std::vector<JKSNValue> &data) {
         return JKSNValue(data);
     }
@@ -226,15 +584,22 @@ public:
     static JKSNValue fromVector(std::initializer_list<JKSNValue> data) {
         return JKSNValue(data);
     }
-    static JKSNValue fromMap(const std::map<JKSNValue, JKSNValue> &data) {
+    static JKSNValue fromNumbers(const JKSNNumberArray &data) {
         return JKSNValue(data);
     }
-    static JKSNValue fromMap(std::map<JKSNValue, JKSNValue> &&data) {
+    static JKSNValue fromNumbers(JKSNNumberArray &&data) {
         return JKSNValue(std::move(data));
     }
-    static JKSNValue fromMap(std::initializer_list<std::pair<const JKSNValue, JKSNValue> > data) {
+    static JKSNValue fromMap(const std::map<JKSNValue, JKSNValue> &data) {
         return JKSNValue(data);
     }
+    static JKSNValue fromMap(std::map<JKSNValue, JKSNValue> &&data) {
+        return JKSNValue(std::move(data));
+    }
+    static JKSNValue fromMap(const JKSNObject &data);
+    static JKSNValue fromMap(JKSNObject &&data);
+    /* Members are kept in the order they are listed */
+    static JKSNValue fromMap(std::initializer_list<std::pair<const JKSNValue, JKSNValue> > data);
     static JKSNValue fromUnspecified(const Unspecified &data) {
         return JKSNValue(data);
     }
@@ -245,22 +610,32 @@ public:
     ~JKSNValue() {
         switch(this->getType()) {
         case JKSN_STRING:
-            delete this->data_string;
+        case JKSN_BLOB:
+            if(this->data_storage == STORAGE_HEAP)
+                delete this->data_string;
+            else if(this->data_storage == STORAGE_INTERNED && this->data_key->release())
+                delete this->data_key;
             break;
-        case JKSN_ARRAY:
-            delete this->data_array;
+        case JKSN_LONG_DOUBLE:
+            if(this->data_storage == STORAGE_HEAP)
+                delete this->data_long_double;
             break;
+        case JKSN_ARRAY:
         case JKSN_OBJECT:
-            delete this->data_object;
+            if(this->data_storage == STORAGE_HEAP)
+                this->releaseContainer();
+            else if(this->data_storage == STORAGE_PACKED && this->data_numbers->release())
+                delete this->data_numbers;
             break;
         default:
             break;
         };
         this->data_type = JKSN_UNDEFINED;
+        this->data_storage = STORAGE_HEAP;
     }
 
     jksn_data_type getType() const {
-        return this->data_type;
+        return jksn_data_type(this->data_type);
     }
     bool isUndefined() const {
         return this->getType() == JKSN_UNDEFINED;
@@ -314,6 +689,30 @@ public:
     bool isUnspecified() const {
         return this->getType() == JKSN_UNSPECIFIED;
     }
+    /* Whether this value refers to bytes, or to an array or object in the arena
+       of a JKSNDocument, that it does not own */
+    bool isBorrowed() const {
+        return this->data_storage == STORAGE_BORROWED;
+    }
+    /* Whether this string shares its bytes with the identical object keys the
+       same decoder has produced */
+    bool isInterned() const {
+        return this->data_storage == STORAGE_INTERNED;
+    }
+    /* Whether this array keeps its elements in a JKSNNumberArray */
+    bool isPacked() const {
+        return this->data_storage == STORAGE_PACKED;
+    }
+    /* Packs an array of at least one number, whose elements are all int, all
+       float or all double, into a JKSNNumberArray, as the decoder does with
+       those of at least pack_threshold elements. The decoder leaves the columns
+       of swapped arrays and the arrays of a document unpacked. Returns whether
+       it is packed. */
+    bool pack();
+    static const size_t pack_threshold = 8;
+    /* Copies every borrowed part of this value, so that it no longer depends on
+       the buffer it was decoded from or the document it was decoded into */
+    JKSNValue &materialize();
 
     std::nullptr_t toNullptr() const {
         if(this->isNull())
@@ -343,30 +742,64 @@ public:
     std::string toBlob() const {
         return this->toString();
     };
-    const std::vector<JKSNValue> &toVector() const {
-        if(this->isArray())
-            return *this->data_array;
-        else
+    /* Access the bytes of a string or blob without copying them */
+    const char *stringData() const {
+        if(!this->isStringOrBlob())
             throw JKSNTypeError();
+        switch(this->data_storage) {
+        case STORAGE_HEAP:
+            return this->data_string->data();
+        case STORAGE_BORROWED:
+            return this->data_ref;
+        case STORAGE_INTERNED:
+            return this->data_key->data.bytes.data();
+        default:
+            return this->inlineData();
+        }
     }
-    std::vector<JKSNValue> &toVector() {
-        if(this->isArray())
-            return *this->data_array;
-        else
+    size_t stringSize() const {
+        if(!this->isStringOrBlob())
             throw JKSNTypeError();
+        switch(this->data_storage) {
+        case STORAGE_HEAP:
+            return this->data_string->size();
+        case STORAGE_BORROWED:
+            return size_t(this->data_size) | size_t(this->data_size_high) << 16 << 16;
+        case STORAGE_INTERNED:
+            return this->data_key->data.bytes.size();
+        default:
+            return size_t(this->data_storage - STORAGE_INLINE);
+        }
     }
-    const std::map<JKSNValue, JKSNValue> &toMap() const {
-        if(this->isObject())
-            return *this->data_object;
-        else
+    /* A packed array builds the JKSNArray the first time, and keeps it for its
+       other callers and the copies that share it, so that it takes the memory
+       of both from then on. toNumbers() reads one without building it. */
+    const JKSNArray &toVector() const {
+        if(!this->isArray())
+            throw JKSNTypeError();
+        else if(this->data_storage == STORAGE_PACKED)
+            return this->packedElements();
+        return this->data_array->data;
+    }
+    /* Copies of an array or object share it until it is reached through a
+       non-const accessor, which clones it for this value alone, as it does with
+       one borrowed from a document or kept packed. A reference taken before
+       this value is copied must not be written through after. */
+    JKSNArray &toVector() {
+        if(!this->isArray())
             throw JKSNTypeError();
+        else if(this->data_storage == STORAGE_BORROWED || this->data_storage == STORAGE_PACKED || this->data_array->isShared())
+            this->unshare();
+        return this->data_array->data;
     }
-    std::map<JKSNValue, JKSNValue> &toMap() {
-        if(this->isObject())
-            return *this->data_object;
+    const JKSNNumberArray &toNumbers() const {
+        if(this->isPacked())
+            return this->data_numbers->data;
         else
             throw JKSNTypeError();
     }
+    const JKSNObject &toMap() const;
+    JKSNObject &toMap();
     Unspecified toUnspecified() const {
         if(this->isUnspecified())
             return Unspecified();
@@ -398,142 +831,44 @@ public:
     explicit operator std::string() const {
         return this->toString();
     }
-    explicit operator const std::vector<JKSNValue> &() const {
+    explicit operator const JKSNArray &() const {
         return this->toVector();
     }
-    explicit operator std::vector<JKSNValue> &() {
+    explicit operator JKSNArray &() {
         return this->toVector();
     }
     explicit operator std::vector<JKSNValue>() const {
-        return this->toVector();
-    }
-    explicit operator const std::map<JKSNValue, JKSNValue> &() const {
-        return this->toMap();
+        if(this->isPacked())
+            return std::vector<JKSNValue>(this->toNumbers().begin(), this->toNumbers().end());
+        return std::vector<JKSNValue>(this->toVector().begin(), this->toVector().end());
     }
-    explicit operator std::map<JKSNValue, JKSNValue> &() {
+    explicit operator const JKSNObject &() const {
         return this->toMap();
     }
-    explicit operator std::map<JKSNValue, JKSNValue>() const {
+    explicit operator JKSNObject &() {
         return this->toMap();
     }
+    explicit operator std::map<JKSNValue, JKSNValue>() const;
     explicit operator Unspecified() const {
         return this->toUnspecified();
     }
 
-    JKSNValue &at(const JKSNValue &index) {
-        switch(this->getType()) {
-        case JKSN_ARRAY:
-            if(index.isInt())
-                return this->toVector().at(index.toUInt());
-            else
-                throw JKSNTypeError();
-        case JKSN_OBJECT:
-            return this->toMap().at(index);
-        default:
-            throw JKSNTypeError();
-        }
-    }
-    const JKSNValue &at(const JKSNValue &index) const {
-        switch(this->getType()) {
-        case JKSN_ARRAY:
-            if(index.isInt())
-                return this->toVector().at(index.toUInt());
-            else
-                throw JKSNTypeError();
-        case JKSN_OBJECT:
-            return this->toMap().at(index);
-        default:
-            throw JKSNTypeError();
-        }
-    }
-    JKSNValue &at(size_t index) {
-        switch(this->getType()) {
-        case JKSN_ARRAY:
-            return this->toVector().at(index);
-        case JKSN_OBJECT:
-            return this->toMap().at(JKSNValue(index));
-        default:
-            throw JKSNTypeError();
-        }
-    }
-    const JKSNValue &at(size_t index) const {
-        switch(this->getType()) {
-        case JKSN_ARRAY:
-            return this->toVector().at(index);
-        case JKSN_OBJECT:
-            return this->toMap().at(JKSNValue(index));
-        default:
-            throw JKSNTypeError();
-        }
-    }
-    JKSNValue &at(const std::string &index) {
-        if(this->isObject())
-            return this->toMap().at(JKSNValue(index));
-        else
-            throw JKSNTypeError();
-    }
-    const JKSNValue &at(const std::string &index) const {
-        if(this->isObject())
-            return this->toMap().at(JKSNValue(index));
-        else
-            throw JKSNTypeError();
-    }
-    JKSNValue &at(const char *index) {
-        if(this->isObject())
-            return this->toMap().at(JKSNValue(index));
-        else
-            throw JKSNTypeError();
-    }
-    const JKSNValue &at(const char *index) const {
-        if(this->isObject())
-            return this->toMap().at(JKSNValue(index));
-        else
-            throw JKSNTypeError();
-    }
-    JKSNValue &operator[](const JKSNValue &index) {
-        switch(this->getType()) {
-        case JKSN_ARRAY:
-            if(index.isInt())
-                return this->toVector()[index.toUInt()];
-            else
-                throw JKSNTypeError();
-        case JKSN_OBJECT:
-            return this->toMap()[index];
-        default:
-            throw JKSNTypeError();
-        }
-    }
-    JKSNValue &operator[](size_t index) {
-        switch(this->getType()) {
-        case JKSN_ARRAY:
-            return this->toVector()[index];
-        case JKSN_OBJECT:
-            return this->toMap()[JKSNValue(index)];
-        default:
-            throw JKSNTypeError();
-        }
-    }
-    JKSNValue &operator[](const std::string &index) {
-        if(this->isObject())
-            return this->toMap().at(JKSNValue(index));
-        else
-            throw JKSNTypeError();
-    }
-    JKSNValue &operator[](std::string &&index) {
-        if(this->isObject())
-            return this->toMap().at(JKSNValue(std::move(index)));
-        else
-            throw JKSNTypeError();
-    }
-    JKSNValue &operator[](const char *index) {
-        if(this->isObject())
-            return this->toMap().at(JKSNValue(index));
-        else
-            throw JKSNTypeError();
-    }
+    JKSNValue &at(const JKSNValue &index);
+    const JKSNValue &at(const JKSNValue &index) const;
+    JKSNValue &at(size_t index);
+    const JKSNValue &at(size_t index) const;
+    JKSNValue &at(const std::string &index);
+    const JKSNValue &at(const std::string &index) const;
+    JKSNValue &at(const char *index);
+    const JKSNValue &at(const char *index) const;
+    JKSNValue &operator[](const JKSNValue &index);
+    JKSNValue &operator[](size_t index);
+    JKSNValue &operator[](const std::string &index);
+    JKSNValue &operator[](std::string &&index);
+    JKSNValue &operator[](const char *index);
 
     JKSNValue &operator=(const JKSNValue &that);
-    JKSNValue &operator=(JKSNValue &&that);
+    JKSNValue &operator=(JKSNValue &&that) noexcept;
     bool operator==(const JKSNValue &that) const;
     bool operator!=(const JKSNValue &that) const {
         return !(*this == that);
@@ -550,22 +885,568 @@ public:
     }
 
 private:
-    jksn_data_type data_type = JKSN_UNDEFINED;
+    /* Sixteen bytes: the payload, the size of a borrowed string, then the storage
+       and the type. Short strings take up the fourteen bytes before the storage.
+       Arrays, objects and long doubles in an arena are STORAGE_BORROWED too. */
     union {
         const void *data_padding = nullptr;
         bool data_bool;
         intmax_t data_int;
         float data_float;
         double data_double;
-        long double data_long_double;
+        /* Rare enough to be kept out of line */
+        long double *data_long_double;
         std::string *data_string;
-        std::vector<JKSNValue> *data_array;
-        std::map<JKSNValue, JKSNValue> *data_object;
+        const char *data_ref;
+        JKSNShared<JKSNArray> *data_array;
+        JKSNShared<JKSNObject> *data_object;
+        JKSNShared<JKSNKeyData> *data_key;
+        JKSNShared<JKSNNumberArray> *data_numbers;
+    };
+    uint32_t data_size = 0;
+    uint16_t data_size_high = 0;
+    /* Where the bytes of a string or blob are kept, or STORAGE_INLINE plus the size */
+    enum : uint8_t {
+        STORAGE_HEAP,
+        STORAGE_BORROWED,
+        STORAGE_INTERNED,
+        /* An array held as a JKSNNumberArray on the heap */
+        STORAGE_PACKED,
+        STORAGE_INLINE
     };
+    static const size_t inline_capacity = 14;
+    uint8_t data_storage = STORAGE_HEAP;
+    uint8_t data_type = JKSN_UNDEFINED;
 
+    char *inlineData() {
+        return reinterpret_cast<char *>(this);
+    }
+    const char *inlineData() const {
+        return reinterpret_cast<const char *>(this);
+    }
     template<typename T> T toNumber() const;
+    typedef JKSNShared<JKSNArray> SharedArray;
+    typedef JKSNShared<JKSNObject> SharedObject;
+    typedef JKSNShared<JKSNKeyData> SharedKey;
+    typedef JKSNShared<JKSNNumberArray> SharedNumbers;
+    const JKSNArray &packedElements() const;
+    bool hasChildren() const;
+    void unshare();
+    /* For the decoder, which fills in arrays and objects before anything else
+       refers to them, and keeps what it builds for a document in its arena */
+    JKSNArray &ownVector() {
+        return this->data_array->data;
+    }
+    JKSNObject &ownMap();
+    static JKSNValue fromArena(JKSNArray &&data, JKSNArena &arena);
+    static JKSNValue fromArena(JKSNObject &&data, JKSNArena &arena);
+    void moveToArena(JKSNArena &arena);
+    friend class JKSNDecoderPrivate;
+    friend class JKSNKeyTable;
+    friend class JKSNShape;
+    void releaseContainer();
+    void copyRepresentation(const JKSNValue &that);
+    void initString(const char *data, size_t size) {
+        if(size <= inline_capacity) {
+            std::memcpy(this->inlineData(), data, size);
+            this->data_storage = uint8_t(STORAGE_INLINE + size);
+        } else
+            this->data_string = new std::string(data, size);
+    }
+    void initString(std::string &&data) {
+        /* A long string hands its buffer over instead of being copied */
+        if(data.size() <= inline_capacity)
+            this->initString(data.data(), data.size());
+        else
+            this->data_string = new std::string(std::move(data));
+    }
+};
+
+class JKSNShape {
+    /* Note: The keys of an object in the order they were inserted or decoded, and
+       a hash index of them once there are more than index_threshold. Objects with
+       the same keys in the same order, as the rows of a table usually have, share
+       one shape, which is copied before it is changed. */
+public:
+    static const size_t index_threshold = 16;
+    explicit JKSNShape(const JKSNAllocator<JKSNValue> &allocator = JKSNAllocator<JKSNValue>()) :
+        keys(allocator),
+        index(allocator) {
+    }
+    JKSNShape(const JKSNShape &that, const JKSNAllocator<JKSNValue> &allocator) :
+        keys(that.keys.begin(), that.keys.end(), allocator),
+        index(that.index.begin(), that.index.end(), allocator) {
+    }
+    size_t size() const {
+        return this->keys.size();
+    }
+    const JKSNValue &key(size_t position) const {
+        return this->keys[position];
+    }
+    /* Returns size() if the key is not there */
+    size_t find(const JKSNValue &key) const {
+        size_t hash;
+        return this->locate(key, hash);
+    }
+private:
+    JKSNArray keys;
+    /* Open addressing table of key positions plus one, empty below index_threshold */
+    std::vector<size_t, JKSNAllocator<size_t> > index;
+    /* Also returns the hash of the key through hash if the shape is indexed */
+    size_t locate(const JKSNValue &key, size_t &hash) const;
+    /* Takes a key that locate did not find, and the hash it returned */
+    void append(JKSNValue &&key, size_t hash);
+    /* Copies the keys and index of that, for an object that cannot share it */
+    void assign(const JKSNShape &that);
+    void erase(size_t position);
+    void rebuildIndex();
+    void indexKey(size_t position, size_t hash);
+    bool inArena() const {
+        return this->keys.get_allocator().arena != nullptr;
+    }
+    static size_t tableSize(size_t size);
+    static size_t hashKey(const JKSNValue &key);
+    friend class JKSNObject;
+    friend class JKSNShapeTable;
 };
 
+class JKSNObject {
+    /* Note: The keys of an object are kept in its JKSNShape, and its values in a
+       contiguous vector beside them. Iterators point to a pair of references, to a
+       key that cannot be changed and to its value, and bind to a value_type only
+       by copying the member. */
+public:
+    typedef std::pair<JKSNValue, JKSNValue> value_type;
+    typedef std::vector<value_type, JKSNAllocator<value_type> > container_type;
+    template<typename Value>
+    struct basic_reference {
+        const JKSNValue &first;
+        Value &second;
+        operator value_type() const {
+            return value_type(this->first, this->second);
+        }
+    };
+    typedef basic_reference<JKSNValue> reference;
+    typedef basic_reference<const JKSNValue> const_reference;
+    template<typename Value>
+    class basic_iterator {
+    public:
+        typedef std::random_access_iterator_tag iterator_category;
+        typedef JKSNObject::value_type value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef basic_reference<Value> reference;
+        struct pointer {
+            reference member;
+            const reference *operator->() const {
+                return &this->member;
+            }
+        };
+        basic_iterator() = default;
+        template<typename Other, typename = typename std::enable_if<std::is_convertible<Other *, Value *>::value>::type>
+        basic_iterator(const basic_iterator<Other> &that) :
+            key(that.key),
+            value(that.value) {
+        }
+        reference operator*() const {
+            return reference{*this->key, *this->value};
+        }
+        pointer operator->() const {
+            return pointer{**this};
+        }
+        reference operator[](difference_type offset) const {
+            return *(*this + offset);
+        }
+        basic_iterator &operator++() {
+            ++this->key;
+            ++this->value;
+            return *this;
+        }
+        basic_iterator operator++(int) {
+            basic_iterator result = *this;
+            ++*this;
+            return result;
+        }
+        basic_iterator &operator--() {
+            --this->key;
+            --this->value;
+            return *this;
+        }
+        basic_iterator operator--(int) {
+            basic_iterator result = *this;
+            --*this;
+            return result;
+        }
+        basic_iterator &operator+=(difference_type offset) {
+            this->key += offset;
+            this->value += offset;
+            return *this;
+        }
+        basic_iterator &operator-=(difference_type offset) {
+            return *this += -offset;
+        }
+        basic_iterator operator+(difference_type offset) const {
+            return basic_iterator(*this) += offset;
+        }
+        basic_iterator operator-(difference_type offset) const {
+            return basic_iterator(*this) += -offset;
+        }
+        difference_type operator-(const basic_iterator &that) const {
+            return this->value - that.value;
+        }
+        bool operator==(const basic_iterator &that) const {
+            return this->value == that.value;
+        }
+        bool operator!=(const basic_iterator &that) const {
+            return this->value != that.value;
+        }
+        bool operator<(const basic_iterator &that) const {
+            return this->value < that.value;
+        }
+        bool operator>(const basic_iterator &that) const {
+            return that.value < this->value;
+        }
+        bool operator<=(const basic_iterator &that) const {
+            return !(that.value < this->value);
+        }
+        bool operator>=(const basic_iterator &that) const {
+            return !(this->value < that.value);
+        }
+    private:
+        basic_iterator(const JKSNValue *key, Value *value) :
+            key(key),
+            value(value) {
+        }
+        const JKSNValue *key = nullptr;
+        Value *value = nullptr;
+        template<typename> friend class basic_iterator;
+        friend class JKSNObject;
+    };
+    typedef basic_iterator<JKSNValue> iterator;
+    typedef basic_iterator<const JKSNValue> const_iterator;
+    typedef size_t size_type;
+    static const size_t index_threshold = JKSNShape::index_threshold;
+    JKSNObject() = default;
+    explicit JKSNObject(const JKSNAllocator<value_type> &allocator) :
+        values(allocator) {
+    }
+    /* Takes a sequence of members in one go, and their allocator. A key that
+       appears again replaces the value, but keeps the place, of its first appearance. */
+    explicit JKSNObject(container_type &&members);
+    template<typename InputIt>
+    JKSNObject(InputIt first, InputIt last) {
+        for(; first != last; ++first)
+            this->insert(value_type(first->first, first->second));
+    }
+    JKSNObject(std::initializer_list<std::pair<const JKSNValue, JKSNValue> > data) :
+        JKSNObject(data.begin(), data.end()) {
+    }
+    /* A copy shares the shape, and its values go to the heap */
+    JKSNObject(const JKSNObject &that) :
+        keys(that.keys),
+        values(that.values) {
+        if(this->keys)
+            this->keys->acquire();
+    }
+    JKSNObject(JKSNObject &&that) noexcept :
+        keys(that.keys),
+        values(std::move(that.values)) {
+        that.keys = nullptr;
+    }
+    JKSNObject &operator=(const JKSNObject &that);
+    JKSNObject &operator=(JKSNObject &&that) noexcept;
+    ~JKSNObject() {
+        releaseShape(this->keys);
+    }
+
+    size_t size() const {
+        return this->values.size();
+    }
+    bool empty() const {
+        return this->values.empty();
+    }
+    void reserve(size_t size) {
+        this->values.reserve(size);
+    }
+    void clear() {
+        releaseShape(this->keys);
+        this->keys = nullptr;
+        this->values.clear();
+    }
+    /* Shared with the other objects that have the same keys in the same order */
+    const JKSNShape &shape() const {
+        static const JKSNShape empty;
+        return this->keys ? this->keys->data : empty;
+    }
+    iterator begin() {
+        return iterator(this->keys ? this->keys->data.keys.data() : nullptr, this->values.data());
+    }
+    iterator end() {
+        return this->begin() + std::ptrdiff_t(this->values.size());
+    }
+    const_iterator begin() const {
+        return const_iterator(this->keys ? this->keys->data.keys.data() : nullptr, this->values.data());
+    }
+    const_iterator end() const {
+        return this->begin() + std::ptrdiff_t(this->values.size());
+    }
+    const_iterator cbegin() const {
+        return this->begin();
+    }
+    const_iterator cend() const {
+        return this->end();
+    }
+
+    iterator find(const JKSNValue &key) {
+        return this->begin() + std::ptrdiff_t(this->shape().find(key));
+    }
+    const_iterator find(const JKSNValue &key) const {
+        return this->begin() + std::ptrdiff_t(this->shape().find(key));
+    }
+    size_t count(const JKSNValue &key) const {
+        return this->shape().find(key) != this->values.size() ? 1 : 0;
+    }
+    JKSNValue &at(const JKSNValue &key) {
+        size_t position = this->shape().find(key);
+        if(position == this->values.size())
+            throw std::out_of_range("JKSN object has no such key");
+        return this->values[position];
+    }
+    const JKSNValue &at(const JKSNValue &key) const {
+        size_t position = this->shape().find(key);
+        if(position == this->values.size())
+            throw std::out_of_range("JKSN object has no such key");
+        return this->values[position];
+    }
+    JKSNValue &operator[](const JKSNValue &key) {
+        return this->insert(value_type(key, JKSNValue())).first->second;
+    }
+    JKSNValue &operator[](JKSNValue &&key) {
+        return this->insert(value_type(std::move(key), JKSNValue())).first->second;
+    }
+    /* Leaves the object unchanged if the key is already there */
+    std::pair<iterator, bool> insert(value_type &&member);
+    std::pair<iterator, bool> insert(const value_type &member) {
+        return this->insert(value_type(member));
+    }
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(Args &&...args) {
+        return this->insert(value_type(std::forward<Args>(args)...));
+    }
+    /* Later members move up to close the gap */
+    iterator erase(const_iterator position);
+    iterator erase(iterator position) {
+        return this->erase(const_iterator(position));
+    }
+    size_t erase(const JKSNValue &key);
+private:
+    typedef JKSNShared<JKSNShape> SharedShape;
+    SharedShape *keys = nullptr;
+    JKSNArray values;
+    /* The shape of this object alone, copied to its allocator if it was shared */
+    JKSNShape &ownShape();
+    /* Replaces a shape in an arena, or one with borrowed keys, with a copy on the heap */
+    void materializeKeys();
+    static SharedShape *newShape(const JKSNAllocator<JKSNValue> &allocator);
+    static void releaseShape(SharedShape *shape) {
+        /* Shapes in an arena are freed with it */
+        if(shape && shape->release() && !shape->data.inArena())
+            delete shape;
+    }
+    friend class JKSNValue;
+    friend class JKSNDecoderPrivate;
+    friend class JKSNShapeTable;
+};
+
+inline JKSNValue::JKSNValue(const JKSNObject &data) :
+    data_object(new SharedObject(data)),
+    data_type(JKSN_OBJECT) {
+}
+
+inline JKSNValue::JKSNValue(JKSNObject &&data) :
+    data_object(new SharedObject(std::move(data))),
+    data_type(JKSN_OBJECT) {
+}
+
+inline JKSNValue::JKSNValue(const std::map<JKSNValue, JKSNValue> &data) :
+    data_object(new SharedObject(data.begin(), data.end())),
+    data_type(JKSN_OBJECT) {
+}
+
+inline JKSNValue::JKSNValue(std::map<JKSNValue, JKSNValue> &&data) :
+    JKSNValue(JKSNObject()) {
+    JKSNObject &members = this->data_object->data;
+    members.reserve(data.size());
+    for(auto &member : data)
+        members.insert(JKSNObject::value_type(member.first, std::move(member.second)));
+}
+
+inline JKSNValue JKSNValue::fromMap(const JKSNObject &data) {
+    return JKSNValue(data);
+}
+
+inline JKSNValue JKSNValue::fromMap(JKSNObject &&data) {
+    return JKSNValue(std::move(data));
+}
+
+inline JKSNValue JKSNValue::fromMap(std::initializer_list<std::pair<const JKSNValue, JKSNValue> > data) {
+    return JKSNValue(JKSNObject(data));
+}
+
+inline JKSNValue::operator std::map<JKSNValue, JKSNValue>() const {
+    std::map<JKSNValue, JKSNValue> result;
+    for(const auto &member : this->toMap())
+        result.emplace(member.first, member.second);
+    return result;
+}
+
+inline const JKSNObject &JKSNValue::toMap() const {
+    if(this->isObject())
+        return this->data_object->data;
+    else
+        throw JKSNTypeError();
+}
+
+inline JKSNObject &JKSNValue::toMap() {
+    if(!this->isObject())
+        throw JKSNTypeError();
+    else if(this->data_storage == STORAGE_BORROWED || this->data_object->isShared())
+        this->unshare();
+    return this->data_object->data;
+}
+
+inline JKSNObject &JKSNValue::ownMap() {
+    return this->data_object->data;
+}
+
+inline bool JKSNValue::hasChildren() const {
+    /* Packed numbers are freed with their array */
+    return (this->isArray() && !this->isPacked() && !this->data_array->data.empty()) || (this->isObject() && !this->data_object->data.empty());
+}
+
+inline JKSNValue &JKSNValue::at(const JKSNValue &index) {
+    switch(this->getType()) {
+    case JKSN_ARRAY:
+        if(index.isInt())
+            return this->toVector().at(index.toUInt());
+        else
+            throw JKSNTypeError();
+    case JKSN_OBJECT:
+        return this->toMap().at(index);
+    default:
+        throw JKSNTypeError();
+    }
+}
+
+inline const JKSNValue &JKSNValue::at(const JKSNValue &index) const {
+    switch(this->getType()) {
+    case JKSN_ARRAY:
+        if(index.isInt())
+            return this->toVector().at(index.toUInt());
+        else
+            throw JKSNTypeError();
+    case JKSN_OBJECT:
+        return this->toMap().at(index);
+    default:
+        throw JKSNTypeError();
+    }
+}
+
+inline JKSNValue &JKSNValue::at(size_t index) {
+    switch(this->getType()) {
+    case JKSN_ARRAY:
+        return this->toVector().at(index);
+    case JKSN_OBJECT:
+        return this->toMap().at(JKSNValue(index));
+    default:
+        throw JKSNTypeError();
+    }
+}
+
+inline const JKSNValue &JKSNValue::at(size_t index) const {
+    switch(this->getType()) {
+    case JKSN_ARRAY:
+        return this->toVector().at(index);
+    case JKSN_OBJECT:
+        return this->toMap().at(JKSNValue(index));
+    default:
+        throw JKSNTypeError();
+    }
+}
+
+inline JKSNValue &JKSNValue::at(const std::string &index) {
+    if(this->isObject())
+        return this->toMap().at(JKSNValue(index));
+    else
+        throw JKSNTypeError();
+}
+
+inline const JKSNValue &JKSNValue::at(const std::string &index) const {
+    if(this->isObject())
+        return this->toMap().at(JKSNValue(index));
+    else
+        throw JKSNTypeError();
+}
+
+inline JKSNValue &JKSNValue::at(const char *index) {
+    if(this->isObject())
+        return this->toMap().at(JKSNValue(index));
+    else
+        throw JKSNTypeError();
+}
+
+inline const JKSNValue &JKSNValue::at(const char *index) const {
+    if(this->isObject())
+        return this->toMap().at(JKSNValue(index));
+    else
+        throw JKSNTypeError();
+}
+
+inline JKSNValue &JKSNValue::operator[](const JKSNValue &index) {
+    switch(this->getType()) {
+    case JKSN_ARRAY:
+        if(index.isInt())
+            return this->toVector()[index.toUInt()];
+        else
+            throw JKSNTypeError();
+    case JKSN_OBJECT:
+        return this->toMap()[index];
+    default:
+        throw JKSNTypeError();
+    }
+}
+
+inline JKSNValue &JKSNValue::operator[](size_t index) {
+    switch(this->getType()) {
+    case JKSN_ARRAY:
+        return this->toVector()[index];
+    case JKSN_OBJECT:
+        return this->toMap()[JKSNValue(index)];
+    default:
+        throw JKSNTypeError();
+    }
+}
+
+inline JKSNValue &JKSNValue::operator[](const std::string &index) {
+    if(this->isObject())
+        return this->toMap().at(JKSNValue(index));
+    else
+        throw JKSNTypeError();
+}
+
+inline JKSNValue &JKSNValue::operator[](std::string &&index) {
+    if(this->isObject())
+        return this->toMap().at(JKSNValue(std::move(index)));
+    else
+        throw JKSNTypeError();
+}
+
+inline JKSNValue &JKSNValue::operator[](const char *index) {
+    if(this->isObject())
+        return this->toMap().at(JKSNValue(index));
+    else
+        throw JKSNTypeError();
+}
+
 class JKSNEncoder {
     /* Note: With a certain JKSN encoder, the hashtable is preserved during each dump */
 public:
@@ -577,10 +1458,87 @@ public:
     ~JKSNEncoder();
     std::ostream &dump(const JKSNValue &obj, std::ostream &result, bool header = true);
     std::string dump(const JKSNValue &obj, bool header = true);
+    /* Writes into a memory mapped file which is sized before encoding starts */
+    void dumpFile(const JKSNValue &obj, const std::string &path, bool header = true);
 private:
     class JKSNEncoderPrivate *p = nullptr;
 };
 
+class JKSNProjection {
+    /* Note: A set of paths written like JSON pointers, such as "/user/id",
+       where a "*" component matches any array index or object key.
+       A projection may be reused across any number of parses. */
+public:
+    JKSNProjection() = default;
+    JKSNProjection(std::initializer_list<std::string> paths);
+    JKSNProjection(const std::vector<std::string> &paths);
+    JKSNProjection &add(const std::string &path);
+private:
+    static const size_t npos = ~size_t(0);
+    struct Node {
+        std::map<std::string, size_t> keys;
+        std::map<size_t, size_t> indices;
+        size_t wildcard = npos;
+        bool selected = false;
+    };
+    std::vector<std::string> paths;
+    std::vector<Node> nodes = std::vector<Node>(1);
+    size_t child(size_t node, const std::string &token);
+    void merge(size_t target, size_t source);
+    void distribute(size_t node);
+    bool isSelected(size_t node) const {
+        return node != npos && this->nodes[node].selected;
+    }
+    size_t findKey(size_t node, const JKSNValue &key) const;
+    size_t findIndex(size_t node, size_t index) const;
+    friend class JKSNDecoderPrivate;
+};
+
+class JKSNDocument {
+    /* Note: Owns the encoded bytes, so that UTF-8 strings and blobs decoded from
+       them are borrowed instead of copied, and an arena that holds every array,
+       object and other decoded value that could not be borrowed. The document is
+       freed all at once, without visiting its values. Copies of a document share
+       the bytes and the arena. Values copied out of it borrow from it all the
+       same, so they must not outlive it unless they are materialized. */
+public:
+    JKSNDocument() = default;
+    const JKSNValue &get() const {
+        return this->root;
+    }
+    JKSNValue &get() {
+        return this->root;
+    }
+    /* Detaches the value from the document, copying whatever it borrows */
+    JKSNValue release() {
+        this->root.materialize();
+        this->storage = nullptr;
+        this->arena = nullptr;
+        return std::move(this->root);
+    }
+private:
+    std::shared_ptr<const void> storage;
+    std::shared_ptr<JKSNArena> arena;
+    /* Declared last, so that it is destroyed before what it borrows from */
+    JKSNValue root;
+    friend class JKSNDecoder;
+};
+
+struct JKSNLimits {
+    /* Note: Bounds on what one parse may build out of untrusted input, enforced by
+       JKSNDecoder and by push decoders constructed from it. parseParallel checks
+       them while it indexes the document, and charges the index to max_bytes.
+       Every limit is unbounded by default. */
+    /* Values nested in one another, counting pragmas and trailing checksums */
+    size_t max_depth = ~size_t(0);
+    /* Elements of an array, members of an object or columns of a swapped array */
+    size_t max_length = ~size_t(0);
+    /* Encoded bytes of one string or blob */
+    size_t max_string = ~size_t(0);
+    /* Approximate bytes of values and string contents built by one parse */
+    size_t max_bytes = ~size_t(0);
+};
+
 class JKSNDecoder {
     /* Note: With a certain JKSN decoder, the hashtable is preserved during each parse */
 public:
@@ -592,8 +1550,193 @@ public:
     ~JKSNDecoder();
     JKSNValue parse(std::istream &fp, bool header = true);
     JKSNValue parse(const std::string &str, bool header = true);
+    /* Decodes one value from a contiguous buffer without copying it into a stream.
+       The number of bytes used is stored into *consumed if it is not null,
+       so that successive values can be parsed out of the same buffer. */
+    JKSNValue parse(const char *buf, size_t size, size_t *consumed, bool header = true);
+    /* Maps the file into memory and decodes it through the contiguous-buffer path */
+    JKSNValue parseFile(const std::string &path, bool header = true);
+    /* Decodes only the values selected by the projection, which are put into
+       the same places. Other object members are left out, and other array
+       elements are left undefined, so that indices stay meaningful. */
+    JKSNValue parse(std::istream &fp, const JKSNProjection &projection, bool header = true);
+    JKSNValue parse(const std::string &str, const JKSNProjection &projection, bool header = true);
+    JKSNValue parse(const char *buf, size_t size, size_t *consumed, const JKSNProjection &projection, bool header = true);
+    JKSNValue parseFile(const std::string &path, const JKSNProjection &projection, bool header = true);
+    /* Scans the buffer once, resolving every hash reference and delta integer,
+       then builds the values on several threads. The result and the hashtable
+       left behind are the same as those of parse. 0 threads means one per core. */
+    JKSNValue parseParallel(const char *buf, size_t size, size_t *consumed, unsigned threads = 0, bool header = true);
+    JKSNValue parseFileParallel(const std::string &path, unsigned threads = 0, bool header = true);
+    /* Decodes into a document that takes over the buffer, or maps the file */
+    JKSNDocument parseDocument(std::string &&buf, bool header = true);
+    JKSNDocument parseDocumentFile(const std::string &path, bool header = true);
+    /* Exceeding a limit throws JKSNLimitError. Lengths read from the stream are
+       checked before anything is allocated for them. */
+    void setLimits(const JKSNLimits &limits);
+    const JKSNLimits &getLimits() const;
 private:
     class JKSNDecoderPrivate *p = nullptr;
+    friend class JKSNReader;
+    friend class JKSNPushDecoder;
+};
+
+class JKSNView {
+    /* Note: A read-only view of encoded JKSN bytes, which are indexed lazily as far
+       as the accessed values require. The buffer must outlive every view into it. */
+public:
+    JKSNView() = default;
+    JKSNView(const char *buf, size_t size, bool header = true);
+    static JKSNView fromFile(const std::string &path, bool header = true);
+    /* Opens a document together with a tape saved from it by saveTape, so that
+       no scanning is needed. The tape buffer must be aligned to 8 bytes. */
+    JKSNView(const char *buf, size_t size, const char *tape, size_t tape_size, bool header = true);
+    static JKSNView fromFileWithTape(const std::string &path, const std::string &tape_path, bool header = true);
+    /* Scans the whole document into the tape, after which array elements are found
+       in constant time and object members by binary search */
+    void buildTape() const;
+    /* Writes the tape in the byte order of this machine */
+    void saveTape(const std::string &path) const;
+
+    jksn_data_type getType() const;
+    bool isUndefined() const {
+        return this->getType() == JKSN_UNDEFINED;
+    }
+    bool isNull() const {
+        return this->getType() == JKSN_NULL;
+    }
+    bool isBool() const {
+        return this->getType() == JKSN_BOOL;
+    }
+    bool isInt() const {
+        return this->getType() == JKSN_INT;
+    }
+    bool isNumber() const {
+        jksn_data_type type = this->getType();
+        return type == JKSN_INT || type == JKSN_FLOAT || type == JKSN_DOUBLE || type == JKSN_LONG_DOUBLE;
+    }
+    bool isString() const {
+        return this->getType() == JKSN_STRING;
+    }
+    bool isBlob() const {
+        return this->getType() == JKSN_BLOB;
+    }
+    bool isArray() const {
+        return this->getType() == JKSN_ARRAY;
+    }
+    bool isObject() const {
+        return this->getType() == JKSN_OBJECT;
+    }
+    bool isUnspecified() const {
+        return this->getType() == JKSN_UNSPECIFIED;
+    }
+
+    /* Number of array elements or object members */
+    size_t size() const;
+    bool empty() const {
+        return this->size() == 0;
+    }
+    JKSNView at(size_t index) const;
+    JKSNView at(const std::string &key) const;
+    JKSNView at(const char *key) const {
+        return this->at(std::string(key));
+    }
+    JKSNView operator[](size_t index) const {
+        return this->at(index);
+    }
+    JKSNView operator[](const std::string &key) const {
+        return this->at(key);
+    }
+    JKSNView operator[](const char *key) const {
+        return this->at(std::string(key));
+    }
+    bool has(const std::string &key) const;
+    /* Object members in stream order */
+    JKSNView keyAt(size_t index) const;
+    JKSNView valueAt(size_t index) const;
+
+    bool toBool() const;
+    intmax_t toInt() const;
+    double toDouble() const;
+    std::string toString() const;
+    /* Decodes the whole subtree under this view */
+    JKSNValue toValue() const;
+private:
+    std::shared_ptr<class JKSNViewIndex> index;
+    size_t node = 0;
+    size_t row = ~size_t(0);
+    JKSNView(const std::shared_ptr<class JKSNViewIndex> &index, size_t node, size_t row = ~size_t(0)) :
+        index(index),
+        node(node),
+        row(row) {
+    }
+    size_t findMember(const std::string &key) const;
+};
+
+class JKSNReader {
+    /* Note: A pull parser that yields one token at a time, holding no more than the
+       open containers and the hashtable in memory. Constructed from a decoder, it reads
+       with and updates the hashtable and the last integer of that decoder. */
+public:
+    JKSNReader(std::istream &fp, bool header = true);
+    JKSNReader(const char *buf, size_t size, bool header = true);
+    JKSNReader(JKSNDecoder &decoder, std::istream &fp, bool header = true);
+    JKSNReader(JKSNDecoder &decoder, const char *buf, size_t size, bool header = true);
+    JKSNReader(const JKSNReader &that) = delete;
+    JKSNReader(JKSNReader &&that);
+    JKSNReader &operator=(const JKSNReader &that) = delete;
+    JKSNReader &operator=(JKSNReader &&that);
+    ~JKSNReader();
+
+    /* Moves to the next token, returns false once the whole value has been read */
+    bool next();
+    jksn_token_type getToken() const;
+    /* Type of the value the current token belongs to */
+    jksn_data_type getType() const;
+    /* Element count of an array, member count of an object or column count of a
+       swapped array; ~size_t(0) for lengthless arrays */
+    size_t size() const;
+    /* Number of containers enclosing the current token */
+    size_t depth() const;
+    /* The decoded value of a scalar, key or column name */
+    const JKSNValue &getValue() const;
+    /* A piece of a string, converted to UTF-8, or of a blob */
+    const std::string &getChunk() const;
+    bool isLastChunk() const;
+    /* Steps over the rest of the container or string started by the current token,
+       leaving the reader at its end */
+    void skip();
+private:
+    class JKSNReaderPrivate *p = nullptr;
+};
+
+class JKSNPushDecoder {
+    /* Note: Decodes values out of bytes that arrive in arbitrary pieces, such as from a
+       non-blocking socket, without reparsing what was already received. Constructed from
+       a decoder, it shares the hashtable and the last integer of that decoder.
+       After a decode error the stream cannot be resumed. */
+public:
+    JKSNPushDecoder(bool header = true);
+    JKSNPushDecoder(JKSNDecoder &decoder, bool header = true);
+    JKSNPushDecoder(const JKSNPushDecoder &that) = delete;
+    JKSNPushDecoder(JKSNPushDecoder &&that);
+    JKSNPushDecoder &operator=(const JKSNPushDecoder &that) = delete;
+    JKSNPushDecoder &operator=(JKSNPushDecoder &&that);
+    ~JKSNPushDecoder();
+
+    /* Decodes as far as the received bytes allow, and returns the number of
+       complete values waiting to be popped */
+    size_t feed(const char *buf, size_t size);
+    size_t feed(const std::string &buf) {
+        return this->feed(buf.data(), buf.size());
+    }
+    size_t available() const;
+    /* Takes the oldest complete value */
+    JKSNValue pop();
+    /* Whether part of a value has been received, e.g. to detect truncation at the end of the stream */
+    bool pending() const;
+private:
+    class JKSNPushDecoderPrivate *p = nullptr;
 };
 
 inline std::ostream &dump(const JKSNValue &obj, std::ostream &result, bool header = true) {
@@ -602,12 +1745,264 @@ inline std::ostream &dump(const JKSNValue &obj, std::ostream &result, bool heade
 inline std::string dump(const JKSNValue &obj, bool header = true) {
     return JKSNEncoder().dump(obj, header);
 }
+inline void dumpFile(const JKSNValue &obj, const std::string &path, bool header = true) {
+    JKSNEncoder().dumpFile(obj, path, header);
+}
 inline JKSNValue parse(std::istream &fp, bool header = true) {
     return JKSNDecoder().parse(fp, header);
 }
 inline JKSNValue parse(const std::string &str, bool header = true) {
     return JKSNDecoder().parse(str, header);
 }
+inline JKSNValue parse(const char *buf, size_t size, size_t *consumed, bool header = true) {
+    return JKSNDecoder().parse(buf, size, consumed, header);
+}
+inline JKSNValue parseFile(const std::string &path, bool header = true) {
+    return JKSNDecoder().parseFile(path, header);
+}
+inline JKSNDocument parseDocument(std::string &&buf, bool header = true) {
+    return JKSNDecoder().parseDocument(std::move(buf), header);
+}
+inline JKSNDocument parseDocumentFile(const std::string &path, bool header = true) {
+    return JKSNDecoder().parseDocumentFile(path, header);
+}
+inline JKSNValue parseParallel(const char *buf, size_t size, size_t *consumed, unsigned threads = 0, bool header = true) {
+    return JKSNDecoder().parseParallel(buf, size, consumed, threads, header);
+}
+inline JKSNValue parseFileParallel(const std::string &path, unsigned threads = 0, bool header = true) {
+    return JKSNDecoder().parseFileParallel(path, threads, header);
+}
+inline JKSNValue parse(std::istream &fp, const JKSNProjection &projection, bool header = true) {
+    return JKSNDecoder().parse(fp, projection, header);
+}
+inline JKSNValue parse(const std::string &str, const JKSNProjection &projection, bool header = true) {
+    return JKSNDecoder().parse(str, projection, header);
+}
+inline JKSNValue parse(const char *buf, size_t size, size_t *consumed, const JKSNProjection &projection, bool header = true) {
+    return JKSNDecoder().parse(buf, size, consumed, projection, header);
+}
+inline JKSNValue parseFile(const std::string &path, const JKSNProjection &projection, bool header = true) {
+    return JKSNDecoder().parseFile(path, projection, header);
+}
+
+#ifdef JKSN_HAVE_COROUTINES
+
+class JKSNTask {
+    /* Note: A coroutine that starts when awaited, and resumes its awaiter on completion */
+public:
+    struct promise_type {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr error;
+        JKSNTask get_return_object() {
+            return JKSNTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+        struct FinalAwaiter {
+            bool await_ready() noexcept {
+                return false;
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                std::coroutine_handle<> continuation = handle.promise().continuation;
+                return continuation ? continuation : std::noop_coroutine();
+            }
+            void await_resume() noexcept {
+            }
+        };
+        FinalAwaiter final_suspend() noexcept {
+            return {};
+        }
+        void return_void() {
+        }
+        void unhandled_exception() {
+            this->error = std::current_exception();
+        }
+    };
+    JKSNTask(const JKSNTask &that) = delete;
+    JKSNTask(JKSNTask &&that) :
+        handle(that.handle) {
+        that.handle = nullptr;
+    }
+    JKSNTask &operator=(const JKSNTask &that) = delete;
+    JKSNTask &operator=(JKSNTask &&that) {
+        if(this != &that) {
+            if(this->handle)
+                this->handle.destroy();
+            this->handle = that.handle;
+            that.handle = nullptr;
+        }
+        return *this;
+    }
+    ~JKSNTask() {
+        if(this->handle)
+            this->handle.destroy();
+    }
+    /* Starts a task that nobody awaits, such as the outermost one of an event loop */
+    void start() {
+        this->handle.resume();
+    }
+    bool done() const {
+        return !this->handle || this->handle.done();
+    }
+    /* Rethrows what the finished task threw */
+    void result() const {
+        if(this->handle && this->handle.promise().error)
+            std::rethrow_exception(this->handle.promise().error);
+    }
+    bool await_ready() const noexcept {
+        return this->done();
+    }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        this->handle.promise().continuation = awaiting;
+        return this->handle;
+    }
+    void await_resume() const {
+        this->result();
+    }
+private:
+    explicit JKSNTask(std::coroutine_handle<promise_type> handle) :
+        handle(handle) {
+    }
+    std::coroutine_handle<promise_type> handle;
+};
+
+class JKSNValueStream {
+    /* Note: An asynchronous generator of values. `co_await stream.next()` suspends
+       until the next value is decoded, and returns false at the end of the stream. */
+public:
+    struct promise_type {
+        JKSNValue value;
+        std::coroutine_handle<> consumer;
+        std::exception_ptr error;
+        JKSNValueStream get_return_object() {
+            return JKSNValueStream(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept {
+            return {};
+        }
+        struct YieldAwaiter {
+            bool await_ready() noexcept {
+                return false;
+            }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+                return handle.promise().consumer;
+            }
+            void await_resume() noexcept {
+            }
+        };
+        YieldAwaiter yield_value(JKSNValue &&value) {
+            this->value = std::move(value);
+            return {};
+        }
+        YieldAwaiter final_suspend() noexcept {
+            return {};
+        }
+        void return_void() {
+        }
+        void unhandled_exception() {
+            this->error = std::current_exception();
+        }
+    };
+    struct NextAwaiter {
+        std::coroutine_handle<promise_type> handle;
+        bool await_ready() noexcept {
+            return this->handle.done();
+        }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> consumer) noexcept {
+            this->handle.promise().consumer = consumer;
+            return this->handle;
+        }
+        bool await_resume() {
+            if(this->handle.promise().error)
+                std::rethrow_exception(this->handle.promise().error);
+            return !this->handle.done();
+        }
+    };
+    JKSNValueStream(const JKSNValueStream &that) = delete;
+    JKSNValueStream(JKSNValueStream &&that) :
+        handle(that.handle) {
+        that.handle = nullptr;
+    }
+    JKSNValueStream &operator=(const JKSNValueStream &that) = delete;
+    JKSNValueStream &operator=(JKSNValueStream &&that) {
+        if(this != &that) {
+            if(this->handle)
+                this->handle.destroy();
+            this->handle = that.handle;
+            that.handle = nullptr;
+        }
+        return *this;
+    }
+    ~JKSNValueStream() {
+        if(this->handle)
+            this->handle.destroy();
+    }
+    NextAwaiter next() {
+        return NextAwaiter{this->handle};
+    }
+    /* The value decoded by the last next() */
+    JKSNValue &value() {
+        return this->handle.promise().value;
+    }
+private:
+    explicit JKSNValueStream(std::coroutine_handle<promise_type> handle) :
+        handle(handle) {
+    }
+    std::coroutine_handle<promise_type> handle;
+};
+
+/* Decodes a continuous stream of values from source, which is called as
+   `co_await source(char *buf, size_t size)` to receive at most size bytes,
+   and returns 0 at the end of the stream. The hashtable and the last integer
+   are carried from value to value, as with JKSNDecoder. */
+template<typename Source>
+JKSNValueStream values(Source source, bool header = true) {
+    JKSNPushDecoder decoder(header);
+    std::string buf(65536, '\0');
+    for(;;) {
+        while(decoder.available() != 0)
+            co_yield decoder.pop();
+        size_t size = co_await source(&buf[0], buf.size());
+        if(size == 0)
+            break;
+        decoder.feed(buf.data(), size);
+    }
+    if(decoder.pending())
+        throw JKSNDecodeError("JKSN stream may be truncated or corrupted");
+}
+
+template<typename Sink>
+class JKSNAsyncWriter {
+    /* Note: Encodes values into a continuous stream, sent through sink, which is called as
+       `co_await sink(const char *buf, size_t size)` and returns the number of bytes written.
+       Values are encoded when write is called, so that writes must be awaited in that order. */
+public:
+    JKSNAsyncWriter(Sink sink, bool header = true) :
+        sink(std::move(sink)),
+        header(header) {
+    }
+    JKSNTask write(const JKSNValue &value) {
+        std::string data = this->encoder.dump(value, this->header);
+        this->header = false;
+        return send(this->sink, std::move(data));
+    }
+private:
+    static JKSNTask send(Sink &sink, std::string data) {
+        size_t sent = 0;
+        while(sent != data.size()) {
+            size_t size = co_await sink(data.data()+sent, data.size()-sent);
+            if(size == 0)
+                throw JKSNError("cannot write JKSN stream");
+            sent += size;
+        }
+    }
+    Sink sink;
+    JKSNEncoder encoder;
+    bool header;
+};
+
+#endif
 
 }
 
@@ -644,11 +2039,16 @@ struct hash<JKSN::JKSNValue> {
             result = hash<string>()(value.toString());
             break;
         case JKSN::JKSN_ARRAY:
-            for(const JKSN::JKSNValue &i : value.toVector())
-                result ^= (*this)(i);
+            if(value.isPacked())
+                for(size_t i = 0; i < value.toNumbers().size(); ++i)
+                    result ^= (*this)(value.toNumbers()[i]);
+            else
+                for(const JKSN::JKSNValue &i : value.toVector())
+                    result ^= (*this)(i);
             break;
         case JKSN::JKSN_OBJECT:
-            for(const pair<JKSN::JKSNValue, JKSN::JKSNValue> &i : value.toMap()) {
+            /* Members are hashed through the iterator's proxies, not copied into pairs */
+            for(const auto &i : value.toMap()) {
                 result ^= (*this)(i.first);
                 result ^= (*this)(i.second);
             }
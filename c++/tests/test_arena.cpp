@@ -0,0 +1,58 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "jksn.hpp"
+
+int main() {
+    std::vector<JKSN::JKSNValue> rows;
+    for(int i = 0; i < 3; ++i)
+        rows.push_back(JKSN::JKSNValue::fromMap({{"id", i}, {"city", "北京市朝阳区建国门外大街"}, {"weight", 0.1L + i}}));
+    std::string encoded = JKSN::dump(JKSN::JKSNValue::fromMap({
+        {"rows", JKSN::JKSNValue(rows)},
+        {"empty", JKSN::JKSNValue(std::vector<JKSN::JKSNValue>())},
+        {"title", "A title long enough to be borrowed"}
+    }));
+
+    JKSN::JKSNValue released;
+    {
+        JKSN::JKSNDocument document = JKSN::parseDocument(std::string(encoded));
+        const JKSN::JKSNValue &root = document.get();
+        /* Containers and values that cannot borrow from the buffer are kept in the arena */
+        const JKSN::JKSNValue &row = root.at("rows").at(size_t(1));
+        std::cout << root.isBorrowed() << root.at("rows").isBorrowed() << row.isBorrowed()
+                  << row.at("city").isBorrowed() << row.at("weight").isBorrowed() << root.at("empty").isBorrowed() << " "
+                  << row.at("city").toString() << " " << row.at("weight").toLongDouble() << std::endl;
+
+        /* Changing a copy clones the path to the change onto the heap, and leaves
+           the rest in the arena. The copy must not outlive the document. */
+        {
+            JKSN::JKSNValue copy = document.get();
+            copy["rows"][2]["id"] = 42;
+            copy["empty"].toVector().push_back("item");
+            std::cout << copy.isBorrowed() << copy["rows"].isBorrowed() << copy["rows"][2].isBorrowed()
+                      << static_cast<const JKSN::JKSNValue &>(copy).at("rows").at(size_t(0)).isBorrowed() << " "
+                      << copy["rows"][2]["id"].toInt() << " " << root.at("rows").at(size_t(2)).at("id").toInt() << " "
+                      << copy["empty"].toVector().size() << " " << root.at("empty").toVector().size() << std::endl;
+        }
+
+        released = document.release();
+    }
+    /* A released value outlives its document */
+    std::cout << released.isBorrowed() << released["rows"][size_t(0)].isBorrowed() << released["rows"][size_t(0)]["weight"].isBorrowed() << " "
+              << released["rows"][size_t(0)]["city"].toString() << " " << released["title"].toString() << " "
+              << (released == JKSN::parse(encoded)) << std::endl;
+
+    /* Keys that cannot borrow from the buffer are kept in the arena as well,
+       also when a repeated key makes the object build its own shape */
+    {
+        std::string key = JKSN::dump(JKSN::JKSNValue(1.5L), false);
+        JKSN::JKSNDocument keyed = JKSN::parseDocument(JKSN::dump(JKSN::JKSNValue::fromMap({{JKSN::JKSNValue(1.5L), 1}, {"a", 2}})));
+        JKSN::JKSNDocument repeated = JKSN::parseDocument("jk!\x92" + key + "\x11" + key + "\x12");
+        const JKSN::JKSNObject &keyed_members = keyed.get().toMap();
+        const JKSN::JKSNObject &repeated_members = repeated.get().toMap();
+        std::cout << keyed_members.begin()->first.isBorrowed() << repeated_members.begin()->first.isBorrowed() << " "
+                  << keyed_members.at(JKSN::JKSNValue(1.5L)).toInt() << " " << repeated_members.size() << " "
+                  << repeated_members.at(JKSN::JKSNValue(1.5L)).toInt() << std::endl;
+    }
+    return 0;
+}
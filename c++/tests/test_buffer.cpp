@@ -0,0 +1,22 @@
+#include <iostream>
+#include <string>
+#include "jksn.hpp"
+
+int main() {
+    JKSN::JKSNEncoder encoder;
+    std::string stream = encoder.dump(JKSN::JKSNValue({
+        "element", 100, 101, 99
+    }));
+    stream += encoder.dump(JKSN::JKSNValue({
+        "element", 102
+    }), false);
+    JKSN::JKSNDecoder decoder;
+    size_t offset = 0;
+    while(offset < stream.size()) {
+        size_t consumed;
+        JKSN::JKSNValue value = decoder.parse(stream.data()+offset, stream.size()-offset, &consumed, offset == 0);
+        std::cout << value.toString() << std::endl;
+        offset += consumed;
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <coroutine>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include "jksn.hpp"
+
+/* A stand-in for an event loop, resuming whatever waits for I/O */
+static std::deque<std::coroutine_handle<>> ready;
+
+struct Later {
+    size_t result;
+    bool await_ready() {
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<> handle) {
+        ready.push_back(handle);
+    }
+    size_t await_resume() {
+        return result;
+    }
+};
+
+static std::string wire;
+
+static JKSN::JKSNTask produce() {
+    /* The sink accepts at most 4 bytes at a time */
+    JKSN::JKSNAsyncWriter writer([](const char *buf, size_t size) {
+        size = std::min(size, size_t(4));
+        wire.append(buf, size);
+        return Later{size};
+    });
+    JKSN::JKSNValue value = JKSN::JKSNValue::fromMap({{"name", "Jason"}, {"id", 1000}});
+    co_await writer.write(value);
+    value["id"] = 1001;
+    co_await writer.write(value);
+}
+
+static JKSN::JKSNTask consume() {
+    /* The source delivers at most 3 bytes at a time */
+    size_t pos = 0;
+    JKSN::JKSNValueStream stream = JKSN::values([&pos](char *buf, size_t size) {
+        size = std::min({size, size_t(3), wire.size()-pos});
+        std::memcpy(buf, wire.data()+pos, size);
+        pos += size;
+        return Later{size};
+    });
+    while(co_await stream.next())
+        std::cout << stream.value()["name"].toString() << " " << stream.value()["id"].toInt() << std::endl;
+}
+
+static void run(JKSN::JKSNTask &task) {
+    task.start();
+    while(!ready.empty()) {
+        std::coroutine_handle<> handle = ready.front();
+        ready.pop_front();
+        handle.resume();
+    }
+    task.result();
+}
+
+int main() {
+    JKSN::JKSNTask writing = produce();
+    run(writing);
+    JKSN::JKSNTask reading = consume();
+    run(reading);
+    std::cout << wire.size() << std::endl;
+    return 0;
+}
@@ -0,0 +1,56 @@
+#include <iostream>
+#include <sstream>
+#include <utility>
+#include <vector>
+#include "jksn.hpp"
+
+int main() {
+    /* Far deeper than the call stack could take one frame per level */
+    const size_t depth = 1000000;
+    JKSN::JKSNValue value("Jason");
+    for(size_t i = 0; i < depth; ++i) {
+        std::vector<JKSN::JKSNValue> items;
+        items.push_back(std::move(value));
+        value = JKSN::JKSNValue(std::move(items));
+    }
+    std::string encoded = JKSN::dump(value);
+    JKSN::JKSNValue copy = value;
+    JKSN::JKSNValue decoded = JKSN::parse(encoded);
+    std::istringstream stream(encoded);
+    JKSN::JKSNValue streamed = JKSN::parse(stream);
+    std::cout << encoded.size() << " " << (JKSN::dump(copy) == encoded) << std::endl;
+
+    size_t levels = 0;
+    for(const JKSN::JKSNValue *item = &decoded; item->isArray(); item = &item->toVector().front())
+        ++levels;
+    for(const JKSN::JKSNValue *item = &streamed; item->isArray(); item = &item->toVector().front())
+        ++levels;
+    std::cout << levels << std::endl;
+
+    /* Views and the parallel decoder go through an index of the document */
+    JKSN::JKSNValue viewed = JKSN::JKSNView(encoded.data(), encoded.size()).toValue();
+    JKSN::JKSNValue parallel = JKSN::parseParallel(encoded.data(), encoded.size(), nullptr, 4);
+    levels = 0;
+    for(const JKSN::JKSNValue *item = &viewed; item->isArray(); item = &item->toVector().front())
+        ++levels;
+    for(const JKSN::JKSNValue *item = &parallel; item->isArray(); item = &item->toVector().front())
+        ++levels;
+    std::cout << levels << std::endl;
+
+    /* Every 0xff skips the value after it, which starts with the next 0xff */
+    std::string skipped = std::string(depth, '\xff') + std::string(depth, '\x01') + "\x11";
+    std::cout << JKSN::parse(skipped).toInt() << " " << JKSN::JKSNView(skipped.data(), skipped.size()).toValue().toInt() << std::endl;
+
+    /* A row-col swapped array whose only column is another one, down to [1] */
+    std::string swapped;
+    for(size_t i = 0; i < depth; ++i)
+        swapped += "\xa1\x41" "a";
+    swapped += "\x81\x11";
+    JKSN::JKSNView rows(swapped.data(), swapped.size());
+    JKSN::JKSNValue row = rows.toValue();
+    levels = 0;
+    for(const JKSN::JKSNValue *item = &row.toVector().front(); item->isObject(); item = &item->toMap().at("a"))
+        ++levels;
+    std::cout << rows.size() << " " << levels << std::endl;
+    return 0;
+}
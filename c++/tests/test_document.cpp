@@ -0,0 +1,22 @@
+#include <iostream>
+#include "jksn.hpp"
+
+int main() {
+    std::string encoded = JKSN::dump(JKSN::JKSNValue::fromMap({
+        {"name", "Jason"},
+        {"avatar", JKSN::JKSNValue::fromBlob("\x89PNG\r\n\x1a\n")},
+        {"friends", {"Jackson", "Jason"}}
+    }));
+    JKSN::JKSNDocument document = JKSN::parseDocument(std::move(encoded));
+    JKSN::JKSNValue &value = document.get();
+    std::cout << value["avatar"].isBorrowed() << " "
+              << value["friends"][1].isBorrowed() << " "
+              << value["avatar"].stringSize() << " "
+              << value["friends"][1].toString() << " "
+              << (value["friends"][1] == value["name"]) << std::endl;
+    JKSN::JKSNValue released = document.release();
+    std::cout << released["friends"][1].isBorrowed() << " "
+              << released["avatar"].isBorrowed() << " "
+              << released["name"].toString() << std::endl;
+    return 0;
+}
@@ -0,0 +1,20 @@
+#include <cstdio>
+#include <iostream>
+#include "jksn.hpp"
+
+int main(int argc, char *argv[]) {
+    const char *path = argc > 1 ? argv[1] : "test_file.jksn";
+    JKSN::JKSNValue value = {
+        "element", "元素", 100, 101, 99, 1.5,
+        JKSN::JKSNValue::fromMap({
+            {"name", "Jason"},
+            {"email", "jason@example.com"}
+        })
+    };
+    JKSN::dumpFile(value, path);
+    JKSN::JKSNValue result = JKSN::parseFile(path);
+    std::remove(path);
+    std::cout << (result == value ? "ok" : "mismatch") << std::endl;
+    JKSN::dump(result, std::cout);
+    return 0;
+}
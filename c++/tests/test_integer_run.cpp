@@ -0,0 +1,40 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "jksn.hpp"
+
+int main() {
+    /* Long runs of one-byte integers and deltas, broken up by wider ones */
+    std::vector<JKSN::JKSNValue> items;
+    intmax_t value = 5;
+    for(size_t i = 0; i < 1000; ++i) {
+        value += i % 100 == 99 ? 1000 : intmax_t(i * 7 % 11) - 5;
+        items.push_back(JKSN::JKSNValue(i % 37 == 0 ? intmax_t(i % 11) : value));
+    }
+    JKSN::JKSNValue array(items);
+    std::string encoded = JKSN::dump(JKSN::JKSNValue({array, 3, array}));
+    JKSN::JKSNValue decoded = JKSN::parse(encoded);
+    std::istringstream stream(encoded);
+    JKSN::JKSNValue streamed = JKSN::parse(stream);
+    std::cout << (decoded == streamed) << " " << (decoded.toVector().front() == array) << " " << (decoded.toVector().back() == array) << std::endl;
+
+    /* A lengthless array of deltas, ended by an unspecified value */
+    std::string lengthless("jk!\xc8\x13\xd1\xd1\xda\xd5\x11\xd2\xa0", 12);
+    std::cout << JKSN::parse(lengthless).toString() << std::endl;
+
+    /* Runs stop at the length of their array */
+    std::cout << JKSN::parse(std::string("jk!\x82\x83\x11\xd1\xd1\xd1", 9)).toVector().size() << std::endl;
+
+    JKSN::JKSNDecoder decoder;
+    JKSN::JKSNLimits limits;
+    limits.max_length = 4;
+    decoder.setLimits(limits);
+    try {
+        decoder.parse(lengthless);
+        std::cout << "ok" << std::endl;
+    } catch(JKSN::JKSNLimitError &) {
+        std::cout << "limit" << std::endl;
+    }
+    return 0;
+}
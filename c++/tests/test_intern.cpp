@@ -0,0 +1,47 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "jksn.hpp"
+
+static const JKSN::JKSNValue &keyOf(const JKSN::JKSNValue &object, const std::string &key) {
+    return object.toMap().find(key)->first;
+}
+
+int main() {
+    const std::string key = "a key too long to be kept inline";
+    std::vector<JKSN::JKSNValue> rows;
+    for(int i = 0; i < 100; ++i)
+        rows.push_back(JKSN::JKSNValue::fromMap({{"id", i}, {key, i*2}}));
+    const std::string encoded = JKSN::dump(JKSN::JKSNValue(rows));
+
+    /* Every row of a table shares the bytes of a long key */
+    JKSN::JKSNValue table = JKSN::parse(encoded);
+    const JKSN::JKSNValue &first = keyOf(table.toVector()[0], key);
+    const JKSN::JKSNValue &last = keyOf(table.toVector()[99], key);
+    std::cout << first.isInterned() << last.isInterned() << keyOf(table.toVector()[0], "id").isInterned() << " "
+              << (first.stringData() == last.stringData()) << " " << table.toVector()[99].toMap().at(key).toInt() << std::endl;
+
+    /* So do the keys of sibling objects, and those of a decoder reused for another document */
+    JKSN::JKSNDecoder decoder;
+    JKSN::JKSNValue nested = decoder.parse(JKSN::dump(JKSN::JKSNValue::fromMap({
+        {"first", JKSN::JKSNValue::fromMap({{key, 1}})},
+        {"second", JKSN::JKSNValue::fromMap({{key, 2}})}
+    })));
+    JKSN::JKSNValue again = decoder.parse(encoded);
+    std::cout << (keyOf(nested["first"], key).stringData() == keyOf(nested["second"], key).stringData()) << " "
+              << (keyOf(nested["first"], key).stringData() == keyOf(again.toVector()[0], key).stringData()) << " "
+              << (keyOf(nested["first"], key).stringData() == first.stringData()) << std::endl;
+
+    /* Keys interned by different decoders, or not at all, still compare by their bytes */
+    JKSN::JKSNValue other = JKSN::parse(JKSN::dump(JKSN::JKSNValue::fromMap({{"a key too long to be kept INLINE", 3}})));
+    const JKSN::JKSNValue &similar = other.toMap().begin()->first;
+    std::cout << (first == keyOf(nested["first"], key)) << (first == JKSN::JKSNValue(key)) << (first == similar) << (first < similar) << " "
+              << nested["second"].toMap().count(first) << other.toMap().count(first) << std::endl;
+
+    /* Interned keys outlive their decoder, and are not interned into a document */
+    JKSN::JKSNValue kept = first;
+    table = JKSN::JKSNValue();
+    JKSN::JKSNDocument document = JKSN::parseDocument(std::string(encoded));
+    std::cout << kept.toString() << " " << keyOf(document.get().toVector()[0], key).isInterned() << std::endl;
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include <iostream>
+#include <sstream>
+#include "jksn.hpp"
+
+static const char *attempt(JKSN::JKSNDecoder &decoder, const std::string &encoded) {
+    try {
+        decoder.parse(encoded);
+        std::istringstream stream(encoded);
+        decoder.parse(stream);
+        return "ok";
+    } catch(JKSN::JKSNLimitError &) {
+        return "limit";
+    } catch(JKSN::JKSNDecodeError &) {
+        return "corrupted";
+    }
+}
+
+static const char *attemptParallel(JKSN::JKSNDecoder &decoder, const std::string &encoded) {
+    try {
+        decoder.parseParallel(encoded.data(), encoded.size(), nullptr, 2);
+        return "ok";
+    } catch(JKSN::JKSNLimitError &) {
+        return "limit";
+    } catch(JKSN::JKSNDecodeError &) {
+        return "corrupted";
+    }
+}
+
+int main() {
+    JKSN::JKSNDecoder decoder;
+    /* Lengths of four billion with nothing behind them allocate nothing, nor
+       does a swapped array claiming 2^44 columns for each of its rows */
+    std::cout << attempt(decoder, "jk!\x8f\x80\x80\x80\x80\x10") << " "
+              << attempt(decoder, "jk!\x4f\x80\x80\x80\x80\x10") << " "
+              << attempt(decoder, std::string("jk!\xaf\x84\x80\x80\x80\x80\x80\x00\x41" "a\x81\x11", 15)) << std::endl;
+
+    JKSN::JKSNLimits limits;
+    limits.max_depth = 3;
+    limits.max_length = 4;
+    limits.max_string = 5;
+    limits.max_bytes = 128;
+    decoder.setLimits(limits);
+    const std::string cases[] = {
+        JKSN::dump(JKSN::JKSNValue({JKSN::JKSNValue({"Jason"})})),
+        JKSN::dump(JKSN::JKSNValue({JKSN::JKSNValue({JKSN::JKSNValue({1})})})),
+        JKSN::dump(JKSN::JKSNValue({1, 2, 3, 4, 5})),
+        JKSN::dump(JKSN::JKSNValue("Jackson")),
+        JKSN::dump(JKSN::JKSNValue::fromMap({{"a", "Jason"}, {"b", "Jason"}, {"c", "Jason"}, {"d", "Jason"}}))
+    };
+    for(const std::string &encoded : cases)
+        std::cout << (&encoded == cases ? "" : " ") << attempt(decoder, encoded);
+    std::cout << std::endl;
+    /* The parallel decoder checks the same limits while it indexes the document */
+    for(const std::string &encoded : cases)
+        std::cout << (&encoded == cases ? "" : " ") << attemptParallel(decoder, encoded);
+    std::cout << std::endl;
+    /* Values skipped over by a pragma are nested as well */
+    const std::string pragmas("jk!\xff\xff\xff\x01\x01\x01\x11");
+    std::cout << attempt(decoder, pragmas) << " " << attemptParallel(decoder, pragmas) << std::endl;
+
+    limits = JKSN::JKSNLimits();
+    limits.max_string = 5;
+    decoder.setLimits(limits);
+    /* The push decoder refuses the length without waiting for the string */
+    JKSN::JKSNPushDecoder push(decoder);
+    try {
+        push.feed(JKSN::dump(JKSN::JKSNValue("Jackson")).substr(0, 5));
+        std::cout << "ok" << std::endl;
+    } catch(JKSN::JKSNLimitError &) {
+        std::cout << "limit" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,16 @@
+#include <iostream>
+#include <utility>
+#include "jksn.hpp"
+
+int main() {
+    /* Long doubles are kept out of line, and must survive copies, moves and reassignment */
+    JKSN::JKSNValue value(1.25L);
+    JKSN::JKSNValue copy = value;
+    JKSN::JKSNValue moved = std::move(copy);
+    copy = moved;
+    copy = JKSN::JKSNValue("Jason");
+    copy = value;
+    JKSN::JKSNValue decoded = JKSN::parse(JKSN::dump(JKSN::JKSNValue({value, moved, copy})));
+    std::cout << (sizeof (JKSN::JKSNValue) <= 16) << " " << decoded.toString() << " " << (decoded.toVector()[2] == value) << std::endl;
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+#include "jksn.hpp"
+
+static void printHex(const std::string &data) {
+    for(char byte : data)
+        std::printf("%02x", unsigned(uint8_t(byte)));
+    std::printf("\n");
+}
+
+int main() {
+    /* Arrays of numbers of one type are written in one pass, with each integer
+       a delta from the one before when that is shorter */
+    std::vector<JKSN::JKSNValue> small = {1000, 1003, 1130, 1000, 70000, 70002, -70000, -69990};
+    JKSN::JKSNValue packed(small);
+    packed.pack();
+    printHex(JKSN::dump(JKSN::JKSNValue(small), false));
+    std::cout << (JKSN::dump(packed) == JKSN::dump(JKSN::JKSNValue(small))) << std::endl;
+
+    /* Across chunks, and near the sizes and limits where the encoding changes */
+    const intmax_t edges[] = {
+        0x7f, 0x100, 0x7fff, 0x8000, 0x1fffff, 0x200000, 0x7fffffff, 0x80000000LL,
+        intmax_t(1) << 62, (intmax_t(1) << 62) - 1
+    };
+    std::vector<JKSN::JKSNValue> ints;
+    for(size_t i = 0; i < 1000; ++i) {
+        intmax_t edge = edges[i / 7 % 10] + intmax_t(i % 7) - 3;
+        ints.push_back(JKSN::JKSNValue(i % 3 == 0 ? -edge : edge));
+    }
+    JKSN::JKSNValue packed_ints(ints);
+    packed_ints.pack();
+    JKSN::JKSNValue decoded = JKSN::parse(JKSN::dump(packed_ints));
+    std::cout << (decoded == JKSN::JKSNValue(ints)) << (JKSN::dump(packed_ints) == JKSN::dump(JKSN::JKSNValue(ints))) << " "
+              << decoded.toNumbers().toInts()[999] << std::endl;
+
+    /* Floats and doubles, with numbers that are not finite among them */
+    std::vector<double> doubles;
+    std::vector<float> floats;
+    for(size_t i = 0; i < 37; ++i) {
+        double number = i % 11 == 5 ? std::numeric_limits<double>::quiet_NaN() :
+                        i % 11 == 8 ? -std::numeric_limits<double>::infinity() : double(i) * -0.75;
+        doubles.push_back(number);
+        floats.push_back(float(number));
+    }
+    JKSN::JKSNValue decoded_doubles = JKSN::parse(JKSN::dump(JKSN::JKSNNumberArray(std::vector<double>(doubles))));
+    JKSN::JKSNValue decoded_floats = JKSN::parse(JKSN::dump(JKSN::JKSNNumberArray(std::vector<float>(floats))));
+    bool same = true;
+    for(size_t i = 0; i < doubles.size(); ++i) {
+        double decoded_double = decoded_doubles.toVector()[i].toDouble();
+        float decoded_float = decoded_floats.toVector()[i].toFloat();
+        same = same && (std::isnan(doubles[i]) ? std::isnan(decoded_double) : decoded_double == doubles[i]) &&
+               (std::isnan(floats[i]) ? std::isnan(decoded_float) : decoded_float == floats[i]);
+    }
+    std::cout << same << " " << decoded_doubles.toVector()[36].toDouble() << " " << decoded_floats.toVector()[8].toFloat() << std::endl;
+
+    /* Columns of a swapped table are written the same way */
+    std::vector<JKSN::JKSNValue> rows;
+    for(size_t i = 0; i < 20; ++i)
+        rows.push_back(JKSN::JKSNValue::fromMap({{"t", 1500000000 + intmax_t(i)*15}, {"v", double(i) / 4}}));
+    std::string table = JKSN::dump(JKSN::JKSNValue(rows));
+    std::cout << table.size() << " " << (JKSN::parse(table) == JKSN::JKSNValue(rows)) << std::endl;
+    return 0;
+}
@@ -0,0 +1,39 @@
+#include <iostream>
+#include <map>
+#include <string>
+#include "jksn.hpp"
+
+int main() {
+    /* Members come back in the order they were written */
+    JKSN::JKSNValue value = JKSN::JKSNValue::fromMap({{"zebra", 1}, {"apple", 2}, {"mango", 3}});
+    JKSN::JKSNValue decoded = JKSN::parse(JKSN::dump(value));
+    for(const JKSN::JKSNObject::value_type &item : decoded.toMap())
+        std::cout << item.first.toString() << "=" << item.second.toInt() << " ";
+    std::cout << std::endl;
+
+    /* A repeated key keeps its first place and its last value */
+    std::string repeated("jk!\x93\x41" "a" "\x11\x41" "b" "\x12\x41" "a" "\x13", 13);
+    JKSN::JKSNValue deduplicated = JKSN::parse(repeated);
+    std::cout << deduplicated.toMap().size() << " " << deduplicated.toMap().begin()->first.toString() << "=" << deduplicated["a"].toInt() << std::endl;
+
+    /* Objects are equal whatever the order of their members */
+    JKSN::JKSNValue reordered = JKSN::JKSNValue::fromMap({{"mango", 3}, {"zebra", 1}, {"apple", 2}});
+    std::cout << (reordered == value) << (reordered < value) << (value < reordered) << std::endl;
+
+    /* Large objects are looked up through their index, also after erasing */
+    JKSN::JKSNValue large = JKSN::JKSNValue::fromMap({});
+    for(int i = 0; i < 1000; ++i)
+        large.toMap()[std::to_string(i)] = i;
+    large.toMap()[1.0] = "one";
+    large.toMap().erase("500");
+    JKSN::JKSNValue copy = JKSN::parse(JKSN::dump(large));
+    std::cout << copy.toMap().size() << " " << copy["999"].toInt() << " " << copy.toMap().count("500") << " " << copy.toMap().at(1).toString() << " " << (copy == large) << std::endl;
+
+    /* A std::map still converts both ways, with its members in key order */
+    std::map<JKSN::JKSNValue, JKSN::JKSNValue> sorted{{"zebra", 1}, {"apple", std::string(40, 'a')}};
+    JKSN::JKSNValue moved = JKSN::JKSNValue::fromMap(std::move(sorted));
+    std::map<JKSN::JKSNValue, JKSN::JKSNValue> back = static_cast<std::map<JKSN::JKSNValue, JKSN::JKSNValue> >(moved);
+    std::cout << moved.toMap().begin()->first.toString() << " " << moved["apple"].toString().size() << " "
+              << (JKSN::JKSNValue(back) == moved) << std::endl;
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "jksn.hpp"
+
+int main() {
+    std::vector<JKSN::JKSNValue> ints, floats, doubles, mixed;
+    for(int i = 0; i < 100; ++i) {
+        ints.push_back(JKSN::JKSNValue(1000000 + i*3));
+        floats.push_back(JKSN::JKSNValue(float(i) / 4));
+        doubles.push_back(JKSN::JKSNValue(double(i) * 1.5));
+        mixed.push_back(i % 2 == 0 ? JKSN::JKSNValue(i) : JKSN::JKSNValue(double(i)));
+    }
+    const JKSN::JKSNValue series = JKSN::JKSNValue::fromMap({
+        {"ints", ints}, {"floats", floats}, {"doubles", doubles}, {"mixed", mixed}, {"short", {1, 2, 3}}
+    });
+
+    /* Arrays of numbers of one type are decoded packed, and others are not */
+    const JKSN::JKSNValue decoded = JKSN::parse(JKSN::dump(series));
+    const JKSN::JKSNValue &packed = decoded.toMap().at("doubles");
+    std::cout << decoded.toMap().at("ints").isPacked() << decoded.toMap().at("floats").isPacked() << packed.isPacked()
+              << decoded.toMap().at("mixed").isPacked() << decoded.toMap().at("short").isPacked() << " "
+              << decoded.toMap().at("ints").toNumbers().toInts()[99] << " " << packed.toNumbers()[3].toDouble() << " "
+              << packed.toNumbers().at(4).isDouble() << " " << (decoded == series) << std::endl;
+
+    /* Runs of small integers, with or without a length, pack as they are read,
+       until an element of another type, and so do arrays pushed a byte at a time */
+    const JKSN::JKSNValue run = JKSN::parse(std::string("jk!\xc8\x11\x12\x13\xd1\xd1\xd1\xd1\xd1\x19\xa0", 14));
+    const JKSN::JKSNValue broken = JKSN::parse(std::string("jk!\x8a\x11\x12\x13\x14\x15\x16\x17\x18\x19\x41" "a", 15));
+    JKSN::JKSNPushDecoder pusher;
+    for(char byte : JKSN::dump(JKSN::JKSNValue(doubles)))
+        pusher.feed(std::string(1, byte));
+    const JKSN::JKSNValue pushed = pusher.pop();
+    std::cout << run.isPacked() << broken.isPacked() << pushed.isPacked() << " " << run.toString() << " "
+              << broken.toString() << " " << (pushed == JKSN::JKSNValue(doubles)) << std::endl;
+
+    /* Element access by reference builds the elements once, for every copy */
+    JKSN::JKSNValue copy = packed;
+    const JKSN::JKSNValue &shared = copy;
+    std::cout << packed.at(size_t(10)).toDouble() << " " << (&shared.toVector() == &packed.toVector()) << " "
+              << packed.toVector().size() << " " << packed.toString().substr(0, 11) << std::endl;
+
+    /* Changing a copy unpacks it alone */
+    copy[size_t(0)] = "first";
+    copy.toVector().push_back(nullptr);
+    std::cout << copy.isPacked() << packed.isPacked() << " " << copy.toVector().size() << " "
+              << copy[size_t(0)].toString() << " " << packed.toNumbers()[0].toDouble() << " " << (copy == packed) << std::endl;
+
+    /* Values pack and compare with their unpacked equals */
+    JKSN::JKSNValue built(ints);
+    JKSN::JKSNValue empty = JKSN::JKSNValue(JKSN::JKSNArray());
+    std::cout << built.pack() << JKSN::JKSNValue(mixed).pack() << empty.pack() << " "
+              << (built == JKSN::JKSNValue(ints)) << (JKSN::JKSNValue(ints) == built) << (built < JKSN::JKSNValue(doubles)) << " "
+              << (std::hash<JKSN::JKSNValue>()(built) == std::hash<JKSN::JKSNValue>()(JKSN::JKSNValue(ints))) << " "
+              << (JKSN::dump(built) == JKSN::dump(JKSN::JKSNValue(ints))) << std::endl;
+
+    /* Numbers can be packed without going through values */
+    JKSN::JKSNValue samples = JKSN::JKSNNumberArray(std::vector<float>{0.5f, 1.5f, -2.0f});
+    std::cout << samples.toNumbers().elementType() << " " << samples.toString() << " "
+              << JKSN::parse(JKSN::dump(samples)).toVector()[2].toFloat() << " ";
+    try {
+        JKSN::JKSNNumberArray numbers(JKSN::JKSN_INT);
+        numbers.push_back(JKSN::JKSNValue(1.0));
+    } catch(const JKSN::JKSNTypeError &) {
+        std::cout << "JKSNTypeError";
+    }
+    std::cout << std::endl;
+
+    /* The numbers read by value, one at a time or all together */
+    const JKSN::JKSNValue read = JKSN::parse(JKSN::dump(JKSN::JKSNValue(floats)));
+    float sum = 0;
+    for(JKSN::JKSNValue element : read.toNumbers())
+        sum += element.toFloat();
+    std::vector<JKSN::JKSNValue> elements = static_cast<std::vector<JKSN::JKSNValue> >(read);
+    std::cout << sum << " " << (read.toNumbers().end() - read.toNumbers().begin()) << " " << read.toNumbers().begin()[7].toFloat() << " "
+              << elements.size() << " " << elements[99].toFloat() << " " << read.isPacked() << std::endl;
+
+    /* Threads that ask for the elements at once agree on them */
+    const JKSN::JKSNValue fresh = JKSN::parse(JKSN::dump(JKSN::JKSNValue(ints)));
+    std::vector<const JKSN::JKSNArray *> seen(8);
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < seen.size(); ++t)
+        threads.push_back(std::thread([&fresh, &seen, t]() {
+            seen[t] = &fresh.toVector();
+        }));
+    for(std::thread &thread : threads)
+        thread.join();
+    bool same = true;
+    for(const JKSN::JKSNArray *elements : seen)
+        same = same && elements == seen[0];
+    std::cout << same << " " << (*seen[0])[99].toInt() << std::endl;
+    return 0;
+}
@@ -0,0 +1,22 @@
+#include <iostream>
+#include "jksn.hpp"
+
+int main() {
+    JKSN::JKSNValue rows = JKSN::JKSNValue::fromVector({});
+    for(int i = 0; i < 5000; ++i)
+        rows.toVector().push_back(JKSN::JKSNValue::fromMap({{"id", 1000+i}, {"name", i % 2 ? "odd" : "even"}, {"tags", {i, "x"}}}));
+    JKSN::JKSNEncoder encoder;
+    std::string encoded = encoder.dump(rows);
+    encoded += encoder.dump(rows, false);
+    JKSN::JKSNDecoder sequential;
+    JKSN::JKSNDecoder parallel;
+    size_t consumed, consumed_parallel;
+    bool same = true;
+    for(size_t offset = 0; offset < encoded.size(); offset += consumed) {
+        JKSN::JKSNValue expected = sequential.parse(encoded.data()+offset, encoded.size()-offset, &consumed, offset == 0);
+        JKSN::JKSNValue result = parallel.parseParallel(encoded.data()+offset, encoded.size()-offset, &consumed_parallel, 4, offset == 0);
+        same = same && consumed == consumed_parallel && result == expected;
+    }
+    std::cout << same << " " << JKSN::parseParallel(encoded.data(), encoded.size(), &consumed)[4999]["id"].toInt() << std::endl;
+    return 0;
+}
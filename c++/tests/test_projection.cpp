@@ -0,0 +1,23 @@
+#include <iostream>
+#include <string>
+#include "jksn.hpp"
+
+int main() {
+    JKSN::JKSNProjection projection({"/user/id", "/items/*/price"});
+    JKSN::JKSNDecoder decoder;
+    for(int i = 0; i < 2; ++i) {
+        std::string message = JKSN::dump(JKSN::JKSNValue::fromMap({
+            {"user", JKSN::JKSNValue::fromMap({{"id", 42+i}, {"name", "Alice"}})},
+            {"items", JKSN::JKSNValue({
+                JKSN::JKSNValue::fromMap({{"name", "apple"}, {"price", 3}}),
+                JKSN::JKSNValue::fromMap({{"name", "pear"}, {"price", 5+i}})
+            })},
+            {"comment", "not forwarded"}
+        }));
+        JKSN::JKSNValue value = decoder.parse(message, projection);
+        std::cout << value["user"].toMap().size() << " " << value["user"]["id"].toInt() << " "
+                  << value["items"][1].toMap().size() << " " << value["items"][1]["price"].toInt() << " "
+                  << value.toMap().count("comment") << std::endl;
+    }
+    return 0;
+}
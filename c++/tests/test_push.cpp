@@ -0,0 +1,23 @@
+#include <iostream>
+#include "jksn.hpp"
+
+int main() {
+    JKSN::JKSNEncoder encoder;
+    std::string encoded = encoder.dump(JKSN::JKSNValue::fromMap({{"name", "Jason"}, {"id", 1000}}));
+    encoded += encoder.dump(JKSN::JKSNValue::fromMap({{"name", "Jason"}, {"id", 1001}}));
+    encoded += encoder.dump(JKSN::JKSNValue({"Jason", JKSN::JKSNValue::fromBlob("\x89PNG\r\n\x1a\n")}));
+    /* Arrives three bytes at a time, as from a socket */
+    JKSN::JKSNPushDecoder decoder;
+    for(size_t i = 0; i < encoded.size(); i += 3) {
+        decoder.feed(encoded.substr(i, 3));
+        while(decoder.available() != 0) {
+            JKSN::JKSNValue value = decoder.pop();
+            if(value.isObject())
+                std::cout << value["name"].toString() << " " << value["id"].toInt() << std::endl;
+            else
+                std::cout << value.toVector().front().toString() << " " << value[1].stringSize() << std::endl;
+        }
+    }
+    std::cout << decoder.pending() << std::endl;
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "jksn.hpp"
+
+int main() {
+    std::istringstream stream(JKSN::dump(JKSN::JKSNValue({
+        JKSN::JKSNValue::fromMap({
+            {"name", "Jason"},
+            {"email", "jason@example.com"},
+            {"phone", "777-777-7777"}
+        }),
+        JKSN::JKSNValue::fromMap({
+            {"name", "Jackson"},
+            {"age", 17},
+            {"email", "jackson@example.com"},
+            {"phone", "888-888-8888"}
+        })
+    })));
+    JKSN::JKSNReader reader(stream);
+    while(reader.next()) {
+        std::cout << std::string(reader.depth()*2, ' ');
+        switch(reader.getToken()) {
+        case JKSN::JKSN_TOKEN_START_ARRAY:
+            std::cout << "[ " << reader.size() << std::endl;
+            break;
+        case JKSN::JKSN_TOKEN_START_OBJECT:
+            std::cout << "{ " << reader.size() << std::endl;
+            break;
+        case JKSN::JKSN_TOKEN_START_SWAPPED_ARRAY:
+            std::cout << "swapped " << reader.size() << std::endl;
+            break;
+        case JKSN::JKSN_TOKEN_COLUMN:
+            std::cout << "column " << reader.getValue().toString() << std::endl;
+            if(reader.getValue().toString() == "email") {
+                reader.next();
+                reader.skip();
+            }
+            break;
+        case JKSN::JKSN_TOKEN_KEY:
+            std::cout << "key " << reader.getValue().toString() << std::endl;
+            break;
+        case JKSN::JKSN_TOKEN_SCALAR:
+            if(reader.getValue().isUnspecified())
+                std::cout << "-" << std::endl;
+            else
+                std::cout << reader.getValue().toString() << std::endl;
+            break;
+        case JKSN::JKSN_TOKEN_STRING_CHUNK:
+            std::cout << '"' << reader.getChunk() << '"' << std::endl;
+            break;
+        case JKSN::JKSN_TOKEN_END:
+            std::cout << "end" << std::endl;
+            break;
+        default:
+            break;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+#include "jksn.hpp"
+
+static size_t countShapes(const JKSN::JKSNValue &table) {
+    std::set<const JKSN::JKSNShape *> shapes;
+    for(const JKSN::JKSNValue &row : table.toVector())
+        shapes.insert(&row.toMap().shape());
+    return shapes.size();
+}
+
+int main() {
+    /* Rows with the same keys in the same order share one shape, and so do rows
+       that miss the same columns */
+    std::vector<JKSN::JKSNValue> rows;
+    for(int i = 0; i < 100; ++i) {
+        rows.push_back(JKSN::JKSNValue::fromMap({{"id", i}, {"name", "row" + std::to_string(i)}}));
+        if(i % 10 == 0)
+            rows.back().toMap()["note"] = "tenth";
+    }
+    const JKSN::JKSNValue table = JKSN::parse(JKSN::dump(JKSN::JKSNValue(rows)));
+    const JKSN::JKSNObject &first = table.toVector()[0].toMap();
+    std::cout << countShapes(JKSN::JKSNValue(rows)) << " " << countShapes(table) << " "
+              << first.shape().size() << table.toVector()[1].toMap().shape().size() << " "
+              << table.toVector()[99].toMap().at("name").toString() << " " << (table == JKSN::JKSNValue(rows)) << std::endl;
+
+    /* So do objects that are not in an array */
+    JKSN::JKSNValue nested = JKSN::parse(JKSN::dump(JKSN::JKSNValue::fromMap({
+        {"home", JKSN::JKSNValue::fromMap({{"x", 1}, {"y", 2}})},
+        {"work", JKSN::JKSNValue::fromMap({{"x", 3}, {"y", 4}})},
+        {"away", JKSN::JKSNValue::fromMap({{"y", 5}, {"x", 6}})}
+    })));
+    std::cout << (&nested["home"].toMap().shape() == &nested["work"].toMap().shape())
+              << (&nested["home"].toMap().shape() == &nested["away"].toMap().shape()) << std::endl;
+
+    /* Changing the keys of a row gives it a shape of its own, and changing a value does not */
+    JKSN::JKSNValue copy = table;
+    copy[size_t(1)].toMap()["extra"] = true;
+    copy[size_t(2)]["id"] = -2;
+    copy[size_t(3)].toMap().erase("id");
+    const JKSN::JKSNArray &changed = static_cast<const JKSN::JKSNValue &>(copy).toVector();
+    std::cout << (&changed[1].toMap().shape() == &changed[4].toMap().shape())
+              << (&changed[2].toMap().shape() == &changed[4].toMap().shape())
+              << (&changed[3].toMap().shape() == &changed[4].toMap().shape()) << " "
+              << changed[1].toMap().size() << changed[3].toMap().size() << table.toVector()[1].toMap().size() << " "
+              << changed[3].toMap().begin()->first.toString() << " " << countShapes(table) << std::endl;
+
+    /* Iterators pair each key with its value */
+    JKSN::JKSNObject object = first;
+    JKSN::JKSNObject::iterator it = object.begin() + 1;
+    it->second = "renamed";
+    std::cout << it->first.toString() << "=" << (*it).second.toString() << " " << (it - object.begin()) << " "
+              << object.begin()[2].first.toString() << " " << first.at("name").toString() << " ";
+    it = object.erase(object.cbegin());
+    for(const JKSN::JKSNObject::value_type &member : object)
+        std::cout << member.first.toString() << "=" << member.second.toString() << " ";
+    std::cout << (it == object.begin()) << std::endl;
+
+    /* A repeated column keeps its first place and its last value, and a short one leaves gaps */
+    JKSN::JKSNValue repeated = JKSN::parse(std::string("jk!\xa2\x41" "a" "\x82\x11\x12\x41" "a" "\x81\x13", 13));
+    JKSN::JKSNValue ragged = JKSN::parse(std::string("jk!\xa3\x41" "a" "\x82\x11\x12\x41" "b" "\x81\x13\x41" "c" "\x82\xa0\x14", 18));
+    std::cout << repeated[size_t(0)]["a"].toInt() << repeated[size_t(1)]["a"].toInt() << repeated[size_t(0)].toMap().size() << " "
+              << ragged[size_t(0)].toMap().size() << ragged[size_t(1)].toMap().size() << " "
+              << ragged[size_t(1)]["c"].toInt() << ragged[size_t(1)].toMap().count("b") << std::endl;
+
+    /* Rows of a document share a shape in its arena, and keep their keys when released */
+    JKSN::JKSNValue released;
+    {
+        JKSN::JKSNDocument document = JKSN::parseDocument(JKSN::dump(JKSN::JKSNValue(rows)));
+        std::cout << countShapes(document.get()) << " ";
+        released = document.release();
+    }
+    std::cout << released[size_t(50)]["name"].toString() << " " << (released == table) << std::endl;
+    return 0;
+}
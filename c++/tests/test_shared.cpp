@@ -0,0 +1,52 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "jksn.hpp"
+
+int main() {
+    JKSN::JKSNValue config = JKSN::JKSNValue::fromMap({
+        {"name", "worker"},
+        {"limits", JKSN::JKSNValue::fromMap({{"threads", 4}, {"queue", 64}})},
+        {"hosts", {"alpha", "beta", "gamma"}}
+    });
+
+    /* Copies share their containers until one of them is changed */
+    JKSN::JKSNValue copy = config;
+    const JKSN::JKSNValue &shared = copy;
+    std::cout << (&shared.toMap() == &static_cast<const JKSN::JKSNValue &>(config).toMap()) << " ";
+    copy["limits"]["threads"] = 8;
+    copy["hosts"].toVector().push_back("delta");
+    std::cout << (&shared.toMap() == &static_cast<const JKSN::JKSNValue &>(config).toMap()) << " "
+              << config["limits"]["threads"].toInt() << " " << copy["limits"]["threads"].toInt() << " "
+              << config["hosts"].toVector().size() << " " << copy["hosts"].toVector().size() << std::endl;
+
+    /* A value assigned a part of itself keeps that part alive */
+    JKSN::JKSNValue nested = config;
+    nested = nested["limits"];
+    std::cout << nested["queue"].toInt() << " " << (config["limits"] == nested) << std::endl;
+
+    /* Many threads copy and read one document at once */
+    std::vector<JKSN::JKSNValue> rows;
+    for(int i = 0; i < 1000; ++i)
+        rows.push_back(JKSN::JKSNValue::fromMap({{"id", i}, {"tags", {"x", i}}}));
+    const JKSN::JKSNValue document(std::move(rows));
+    std::vector<long> sums(8);
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < sums.size(); ++t)
+        threads.push_back(std::thread([&document, &sums, t]() {
+            for(int round = 0; round < 20; ++round) {
+                JKSN::JKSNValue local = document;
+                local.toVector()[t].toMap()["id"] = -1;
+                for(const JKSN::JKSNValue &row : document.toVector())
+                    sums[t] += long(row.toMap().at("id").toInt() + row.toMap().at("tags").toVector().size());
+            }
+        }));
+    for(std::thread &thread : threads)
+        thread.join();
+    bool same = true;
+    for(long sum : sums)
+        same = same && sum == sums[0];
+    std::cout << sums[0] << " " << same << " " << document.toVector()[0].toMap().at("id").toInt() << std::endl;
+    return 0;
+}
@@ -0,0 +1,22 @@
+#include <iostream>
+#include <string>
+#include "jksn.hpp"
+
+int main() {
+    /* Around the size kept inside the value, copied, moved and used as keys */
+    JKSN::JKSNValue object = JKSN::JKSNValue::fromMap({});
+    for(size_t size = 0; size <= 40; ++size) {
+        JKSN::JKSNValue value(std::string(size, char('a' + size % 26)));
+        JKSN::JKSNValue copy = value;
+        JKSN::JKSNValue moved = std::move(copy);
+        object.toMap()[moved] = JKSN::JKSNValue(size);
+    }
+    JKSN::JKSNDocument document = JKSN::parseDocument(JKSN::dump(object));
+    JKSN::JKSNValue released = document.release();
+    size_t matches = 0;
+    for(const JKSN::JKSNObject::value_type &item : released.toMap())
+        if(item.first.stringSize() == item.second.toUInt() && !item.first.isBorrowed())
+            ++matches;
+    std::cout << matches << " " << (released == object) << " " << (JKSN::JKSNValue("ab") < JKSN::JKSNValue("abc")) << std::endl;
+    return 0;
+}
@@ -0,0 +1,24 @@
+#include <cstdio>
+#include <iostream>
+#include "jksn.hpp"
+
+int main(int argc, char *argv[]) {
+    const char *path = argc > 1 ? argv[1] : "test_tape.jksn";
+    const std::string tape_path = std::string(path) + ".tape";
+    JKSN::dumpFile(JKSN::JKSNValue({
+        JKSN::JKSNValue::fromMap({{"name", "Jason"}, {"email", "jason@example.com"}}),
+        JKSN::JKSNValue::fromMap({{"name", "Jackson"}, {"age", 17}, {"email", "jackson@example.com"}}),
+        JKSN::JKSNValue::fromMap({{"键", "值"}, {"list", {1, 2, 3}}})
+    }), path);
+    JKSN::JKSNView::fromFile(path).saveTape(tape_path);
+    JKSN::JKSNView view = JKSN::JKSNView::fromFileWithTape(path, tape_path);
+    std::cout << view.size() << " "
+              << view[1]["name"].toString() << " "
+              << view[1]["age"].toInt() << " "
+              << view[2]["键"].toString() << " "
+              << view[2]["list"][2].toInt() << " "
+              << view[2].has("age") << std::endl;
+    std::remove(path);
+    std::remove(tape_path.c_str());
+    return 0;
+}
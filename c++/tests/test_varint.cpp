@@ -0,0 +1,30 @@
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include "jksn.hpp"
+
+int main() {
+    /* Every varint length, both at the end of the buffer and followed by more bytes */
+    size_t mismatches = 0;
+    for(int bits = 1; bits < 63; ++bits)
+        for(intmax_t number : {intmax_t(1) << bits, (intmax_t(1) << bits) - 1, -(intmax_t(1) << bits), INTMAX_MAX, INTMAX_MIN+1}) {
+            std::string encoded = JKSN::dump(JKSN::JKSNValue({number, std::string(70000, 'x'), number}));
+            JKSN::JKSNValue tail = JKSN::parse(encoded);
+            std::istringstream stream(encoded);
+            JKSN::JKSNValue streamed = JKSN::parse(stream);
+            JKSN::JKSNValue single = JKSN::parse(JKSN::dump(number));
+            if(tail.toVector().back().toInt() != number || tail.toVector().front().toInt() != number ||
+               streamed.toVector().back().toInt() != number || single.toInt() != number)
+                ++mismatches;
+        }
+    std::cout << mismatches << std::endl;
+
+    /* Ten bytes of varint do not fit in 64 bits */
+    try {
+        JKSN::parse(std::string("jk!\x1f\xff\xff\xff\xff\xff\xff\xff\xff\xff\x7f", 14));
+        std::cout << "ok" << std::endl;
+    } catch(JKSN::JKSNDecodeError &) {
+        std::cout << "overflow" << std::endl;
+    }
+    return 0;
+}
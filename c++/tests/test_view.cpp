@@ -0,0 +1,26 @@
+#include <iostream>
+#include <string>
+#include "jksn.hpp"
+
+int main() {
+    std::string stream = JKSN::dump(JKSN::JKSNValue({
+        JKSN::JKSNValue::fromMap({{"name", "Alice"}, {"age", 25}}),
+        JKSN::JKSNValue::fromMap({{"name", "Bob"}, {"age", 30}, {"tags", {"admin", "dev"}}})
+    }));
+    JKSN::JKSNView view(stream.data(), stream.size());
+    for(size_t i = 0; i < view.size(); ++i) {
+        std::cout << view[i]["name"].toString() << " " << view[i]["age"].toInt();
+        if(view[i].has("tags"))
+            std::cout << " " << view[i]["tags"].toValue().toString();
+        std::cout << std::endl;
+    }
+
+    /* A length read from the stream is not reserved for before its elements are found */
+    const std::string hostile("\x8f\x88\x80\x80\x80\x80\x00\x11", 8);
+    try {
+        JKSN::JKSNView(hostile.data(), hostile.size()).toValue();
+    } catch(const JKSN::JKSNDecodeError &) {
+        std::cout << "JKSNDecodeError" << std::endl;
+    }
+    return 0;
+}